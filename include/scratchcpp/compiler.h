@@ -42,10 +42,15 @@ class LIBSCRATCHCPP_EXPORT Compiler
         void end();
 
         const std::vector<unsigned int> &bytecode() const;
+        const std::vector<Block *> &bytecodeBlocks() const;
+        size_t maxRegisterCount() const;
 
         IEngine *engine() const;
         Target *target() const;
 
+        bool optimizationsEnabled() const;
+        void setOptimizationsEnabled(bool enabled);
+
         const std::vector<InputValue *> &constInputValues() const;
         std::vector<Value> constValues() const;
 
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "spimpl.h"
+
+namespace libscratchcpp
+{
+
+class Script;
+class Value;
+class Variable;
+class List;
+class DisassemblerPrivate;
+
+/*! \brief The Disassembler class converts bytecode to a readable list of instructions. */
+class LIBSCRATCHCPP_EXPORT Disassembler
+{
+    public:
+        Disassembler(const std::vector<unsigned int> &bytecode);
+        Disassembler(Script *script);
+        Disassembler(const Disassembler &) = delete;
+
+        const std::vector<unsigned int> &bytecode() const;
+
+        void setConstValues(const std::vector<Value> &values);
+        void setVariables(const std::vector<Variable *> &variables);
+        void setLists(const std::vector<List *> &lists);
+
+        std::vector<unsigned int> opcodes() const;
+        size_t instructionCount() const;
+        size_t instructionCount(unsigned int opcode) const;
+
+        std::string toString() const;
+
+        static std::string opcodeName(unsigned int opcode);
+
+    private:
+        spimpl::unique_impl_ptr<DisassemblerPrivate> impl;
+};
+
+} // namespace libscratchcpp
@@ -44,6 +44,16 @@ using BlockFunc = unsigned int (*)(VirtualMachine *vm);
  */
 using BlockComp = void (*)(Compiler *);
 
+/*!
+ * \typedef NativeScript
+ *
+ * NativeScript is a function pointer for scripts exported to C++ (see ScriptExporter).
+ * The function continues the script after the given bytecode position and stores the position where it stopped.
+ * It returns false if the rest of the script must run in the bytecode interpreter.
+ * The state of the virtual machine is accessed through NativeScriptApi.
+ */
+using NativeScript = bool (*)(VirtualMachine *vm, unsigned int **pos);
+
 } // namespace libscratchcpp
 
 #endif // LIBSCRATCHCPP_GLOBAL_H
@@ -6,6 +6,8 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <istream>
+#include <ostream>
 
 #include "global.h"
 
@@ -22,6 +24,8 @@ class Variable;
 class List;
 class Script;
 class ITimer;
+class Profiler;
+class Tracer;
 
 /*!
  * \brief The IEngine interface provides an API for running Scratch projects.
@@ -43,6 +47,32 @@ class LIBSCRATCHCPP_EXPORT IEngine
          */
         virtual void compile() = 0;
 
+        /*!
+         * Writes the compiled scripts (bytecode, constant values, variable, list and procedure tables and hat scripts)
+         * to the given stream. The key identifies the project (for example a hash of project.json).
+         * Returns false if the scripts can't be saved (for example if they weren't compiled by compile()).
+         * \see loadBytecodeCache()
+         */
+        virtual bool saveBytecodeCache(std::ostream &stream, const std::string &key) const = 0;
+
+        /*!
+         * Loads the compiled scripts from a cache written by saveBytecodeCache(), which is faster than compile().
+         * Returns false if the cache was written for a different project (or key), by a different version of the library,
+         * with different compiler optimizations or if it's invalid. The scripts must be compiled using compile() in this case.
+         * \note The cache can only be used with the same block sections, which must be registered in the same order.
+         */
+        virtual bool loadBytecodeCache(std::istream &stream, const std::string &key) = 0;
+
+        /*! Returns true if bytecode optimizations are enabled (this is the default). */
+        virtual bool compilerOptimizationsEnabled() const = 0;
+
+        /*!
+         * Sets whether bytecode optimizations are enabled.
+         * \note This only affects scripts compiled after calling this method.
+         * \see Compiler::setOptimizationsEnabled()
+         */
+        virtual void setCompilerOptimizationsEnabled(bool enabled) = 0;
+
         /*!
          * Calls all "when green flag clicked" blocks.
          * \note Nothing will happen until the event loop is started.
@@ -112,6 +142,15 @@ class LIBSCRATCHCPP_EXPORT IEngine
         /*! Sets whether turbo mode is enabled. */
         virtual void setTurboModeEnabled(bool turboMode) = 0;
 
+        /*!
+         * Returns the maximum time (in milliseconds) a script running without screen refresh can run
+         * before it yields to the other scripts. 0 means there isn't any limit.
+         */
+        virtual int warpTime() const = 0;
+
+        /*! Sets the maximum time (in milliseconds) a script running without screen refresh can run before it yields. */
+        virtual void setWarpTime(int time) = 0;
+
         /*! Returns true if the given key is pressed. */
         virtual bool keyPressed(const std::string &name) const = 0;
 
@@ -181,6 +220,26 @@ class LIBSCRATCHCPP_EXPORT IEngine
         /*! Returns the timer of the project. */
         virtual ITimer *timer() const = 0;
 
+        /*!
+         * Returns the profiler of the project, which records the instructions and block functions executed
+         * by the scripts started after enabling it (it's disabled by default). The recorded data is removed by clear().
+         */
+        virtual Profiler *profiler() const = 0;
+
+        /*!
+         * Returns the tracer of the project, which records the timeline of frames (running scripts, redraws, sleeping,
+         * broadcasts and clone creation) when it's enabled (it's disabled by default).
+         */
+        virtual Tracer *tracer() const = 0;
+
+        /*!
+         * Returns a report of the compiled bytecode with the size, the number of instructions, the number of procedure
+         * (custom block) calls and the instruction mix of each script. This is useful for finding scripts
+         * which are worth optimizing.
+         * \see Disassembler
+         */
+        virtual std::string bytecodeReport() const = 0;
+
         /*!
          * Registers the given block section.
          * \see <a href="blockSections.html">Block sections</a>
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <cstddef>
+
+#include "global.h"
+
+namespace libscratchcpp
+{
+
+class VirtualMachine;
+class Value;
+class List;
+
+/*! \brief The NativeScriptApi class provides access to the state of the virtual machine for scripts exported to C++ (see ScriptExporter). */
+class LIBSCRATCHCPP_EXPORT NativeScriptApi
+{
+    public:
+        enum class ExecResult
+        {
+            Continue, /*!< The script continues after the function. */
+            Yield,    /*!< The script stops and continues at the returned position next time. */
+            Jump      /*!< The script continues at the returned position in the bytecode interpreter. */
+        };
+
+        /*!
+         * The version of the API and of the layout of Value and List.\n
+         * It must be increased whenever the generated code would be incompatible with the library.
+         */
+        static constexpr unsigned int version = 2;
+
+        NativeScriptApi() = delete;
+
+        static bool isCompatible(unsigned int version, size_t valueSize, size_t listSize);
+
+        static Value *reg(VirtualMachine *vm, unsigned int index, unsigned int count);
+        static void push(VirtualMachine *vm, const Value &v);
+        static void pop(VirtualMachine *vm, unsigned int count);
+
+        static void halt(VirtualMachine *vm);
+        static void setCheckpoint(VirtualMachine *vm, unsigned int *pos);
+
+        static void beginLoop(VirtualMachine *vm, bool isRepeatLoop, unsigned int *start, size_t index, size_t max);
+        static size_t loopIndex(VirtualMachine *vm);
+        static void popLoop(VirtualMachine *vm);
+        static bool endLoop(VirtualMachine *vm, unsigned int *pos, unsigned int **yieldPos);
+
+        static ExecResult exec(VirtualMachine *vm, unsigned int function, unsigned int *pos, unsigned int **nextPos);
+
+        static void initProcedure(VirtualMachine *vm);
+        static void addArg(VirtualMachine *vm);
+        static const Value &arg(VirtualMachine *vm, unsigned int index);
+        static const Value &inlineArg(VirtualMachine *vm, unsigned int offset);
+        static void freeInlineArgs(VirtualMachine *vm, unsigned int count);
+
+        static void breakFrame(VirtualMachine *vm);
+        static void warp(VirtualMachine *vm);
+
+        static size_t listIndex(const Value *index, List *list);
+        static void deleteListItem(List *list, const Value *index);
+        static void insertListItem(List *list, const Value *item, const Value *index);
+        static void replaceListItem(List *list, const Value *index, const Value *item);
+
+        static void randomNumber(Value *v1, const Value *v2);
+        static void roundNumber(Value *v);
+        static void absNumber(Value *v);
+        static void floorNumber(Value *v);
+        static void ceilNumber(Value *v);
+        static void sqrtNumber(Value *v);
+        static void sinNumber(Value *v);
+        static void cosNumber(Value *v);
+        static void tanNumber(Value *v);
+        static void asinNumber(Value *v);
+        static void acosNumber(Value *v);
+        static void atanNumber(Value *v);
+};
+
+} // namespace libscratchcpp
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include "global.h"
+#include "spimpl.h"
+
+namespace libscratchcpp
+{
+
+class Block;
+class ProfilerPrivate;
+
+/*! \brief The Profiler class counts the executions and the time of VM instructions and block functions and samples the running blocks. */
+class LIBSCRATCHCPP_EXPORT Profiler
+{
+    public:
+        Profiler();
+        Profiler(const Profiler &) = delete;
+
+        bool enabled() const;
+        void setEnabled(bool enabled);
+
+        bool samplingEnabled() const;
+        void setSamplingEnabled(bool enabled);
+
+        unsigned int sampleInterval() const;
+        void setSampleInterval(unsigned int interval);
+
+        void reset();
+
+        unsigned long long opcodeCount(unsigned int opcode) const;
+        std::chrono::nanoseconds opcodeTime(unsigned int opcode) const;
+
+        const std::vector<BlockFunc> &functions() const;
+        unsigned long long functionCount(BlockFunc function) const;
+        std::chrono::nanoseconds functionTime(BlockFunc function) const;
+
+        std::chrono::nanoseconds totalTime() const;
+
+        std::string foldedStacks() const;
+
+        void addOpcode(unsigned int opcode, std::chrono::nanoseconds time);
+        void addFunction(BlockFunc function, std::chrono::nanoseconds time);
+        void addSample(const std::vector<Block *> &stack, std::chrono::nanoseconds time);
+
+    private:
+        spimpl::unique_impl_ptr<ProfilerPrivate> impl;
+};
+
+} // namespace libscratchcpp
@@ -32,6 +32,9 @@ class LIBSCRATCHCPP_EXPORT Project
         const std::string &fileName() const;
         void setFileName(const std::string &newFileName);
 
+        const std::string &cacheFileName() const;
+        void setCacheFileName(const std::string &fileName);
+
         ScratchVersion scratchVersion() const;
         void setScratchVersion(const ScratchVersion &version);
 
@@ -17,6 +17,7 @@ class Value;
 class VirtualMachine;
 class Variable;
 class List;
+class Block;
 class ScriptPrivate;
 
 /*! \brief The Script class represents a compiled Scratch script. */
@@ -32,10 +33,26 @@ class LIBSCRATCHCPP_EXPORT Script
         const std::vector<unsigned int> &bytecodeVector() const;
         void setBytecode(const std::vector<unsigned int> &code);
 
+        const std::vector<Block *> &bytecodeBlocks() const;
+        void setBytecodeBlocks(const std::vector<Block *> &blocks);
+        Block *blockAt(const unsigned int *pos) const;
+
+        NativeScript nativeScript() const;
+        void setNativeScript(NativeScript script);
+
+        size_t maxRegisterCount() const;
+        void setMaxRegisterCount(size_t count);
+
+        const std::vector<unsigned int *> &procedures() const;
         void setProcedures(const std::vector<unsigned int *> &procedures);
+        const std::vector<Script *> &procedureScripts() const;
+        void setProcedureScripts(const std::vector<Script *> &scripts);
         void setFunctions(const std::vector<BlockFunc> &functions);
+        const std::vector<Value> &constValues() const;
         void setConstValues(const std::vector<Value> &values);
+        const std::vector<Variable *> &variables() const;
         void setVariables(const std::vector<Variable *> &variables);
+        const std::vector<List *> &lists() const;
         void setLists(const std::vector<List *> &lists);
 
         std::shared_ptr<VirtualMachine> start();
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <string>
+
+#include "global.h"
+#include "spimpl.h"
+
+namespace libscratchcpp
+{
+
+class IEngine;
+class ScriptExporterPrivate;
+
+/*! \brief The ScriptExporter class converts compiled scripts to C++ source code. */
+class LIBSCRATCHCPP_EXPORT ScriptExporter
+{
+    public:
+        ScriptExporter(IEngine *engine);
+        ScriptExporter(const ScriptExporter &) = delete;
+
+        static const std::string registerFunctionName;
+
+        IEngine *engine() const;
+
+        std::string generate() const;
+
+    private:
+        spimpl::unique_impl_ptr<ScriptExporterPrivate> impl;
+};
+
+} // namespace libscratchcpp
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "global.h"
+#include "spimpl.h"
+
+namespace libscratchcpp
+{
+
+class TracerPrivate;
+
+/*! \brief The Tracer class records the timeline of engine frames and exports it in the Chrome trace format. */
+class LIBSCRATCHCPP_EXPORT Tracer
+{
+    public:
+        Tracer();
+        Tracer(const Tracer &) = delete;
+
+        bool enabled() const;
+        void setEnabled(bool enabled);
+
+        size_t capacity() const;
+        void setCapacity(size_t capacity);
+
+        size_t eventCount() const;
+        void clear();
+
+        std::string toJson() const;
+
+        void addEvent(const char *name, const std::string &detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    private:
+        spimpl::unique_impl_ptr<TracerPrivate> impl;
+};
+
+} // namespace libscratchcpp
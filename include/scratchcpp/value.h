@@ -6,6 +6,9 @@
 #include <variant>
 #include <algorithm>
 #include <limits>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
 #include <ctgmath>
 #include <utf8.h>
 
@@ -83,6 +86,7 @@ class LIBSCRATCHCPP_EXPORT Value
             m_type(Type::String)
         {
             new (&m_stringValue) std::string(stringValue);
+            m_asciiString = isAscii(stringValue);
             initString(stringValue);
         }
 
@@ -123,6 +127,9 @@ class LIBSCRATCHCPP_EXPORT Value
                     break;
                 case Type::String:
                     new (&m_stringValue) std::string(v.m_stringValue);
+                    m_numberCache = v.m_numberCache;
+                    m_stringNumber = v.m_stringNumber;
+                    m_asciiString = v.m_asciiString;
                     break;
                 default:
                     break;
@@ -180,7 +187,8 @@ class LIBSCRATCHCPP_EXPORT Value
                     case Type::Bool:
                         return m_boolValue;
                     case Type::String:
-                        return stringToLong(m_stringValue);
+                        // Strings which aren't numbers are converted to 0 (see stringNumber())
+                        return stringNumber() == 0 ? 0 : stringToLong(m_stringValue);
                     default:
                         return 0;
                 }
@@ -208,7 +216,7 @@ class LIBSCRATCHCPP_EXPORT Value
                     case Type::Bool:
                         return m_boolValue;
                     case Type::String:
-                        return stringToDouble(m_stringValue);
+                        return stringNumber();
                     default:
                         return 0;
                 }
@@ -270,6 +278,65 @@ class LIBSCRATCHCPP_EXPORT Value
         /*! Returns the UTF-16 representation of the value. */
         std::u16string toUtf16() const { return utf8::utf8to16(toString()); };
 
+        /*!
+         * Returns the number of UTF-16 code units of the string representation of the value (the length of the string in Scratch).\n
+         * This doesn't convert the string to UTF-16, so it's faster than toUtf16().size() (and constant for ASCII strings).
+         */
+        size_t utf16Size() const
+        {
+            if (m_type != Type::String)
+                return toString().size(); // numbers only contain ASCII characters
+            else if (m_asciiString)
+                return m_stringValue.size();
+            else
+                return utf16Size(m_stringValue);
+        }
+
+        /*!
+         * Returns the UTF-16 code unit at the given index of the string representation of the value (the "letter of" block) converted to UTF-8.\n
+         * Returns an empty string if the index is out of range or if the code unit is a half of a surrogate pair.\n
+         * This doesn't convert the string to UTF-16, so it's faster than toUtf16()[index] (and constant for ASCII strings).
+         */
+        std::string utf16At(size_t index) const
+        {
+            if (m_type != Type::String) {
+                std::string str = toString();
+                return index < str.size() ? std::string(1, str[index]) : "";
+            } else if (m_asciiString)
+                return index < m_stringValue.size() ? std::string(1, m_stringValue[index]) : "";
+            else
+                return utf16At(m_stringValue, index);
+        }
+
+        /*!
+         * Appends the string representation of the given value to the string representation of the value.\n
+         * The result is the same as assigning the joined strings, but strings are appended in place,
+         * so repeated appending (for example "set [var] to (join (var) (...))" in a loop) doesn't copy the string.
+         */
+        void append(const Value &v)
+        {
+            if (m_type != Type::String) {
+                *this = toString() + v.toString();
+                return;
+            }
+
+            // Numeric strings only contain these characters (or they're one of the special values, which are short),
+            // so the (long) result can't be a number if the first or the last character isn't one of them
+            static const std::string numberChars = " 0123456789.eE+-";
+            bool mayBeNumber = m_stringValue.empty() || (numberChars.find(m_stringValue.front()) != std::string::npos && numberChars.find(m_stringValue.back()) != std::string::npos);
+
+            if (v.m_type == Type::String) {
+                m_stringValue += v.m_stringValue;
+                m_asciiString = m_asciiString && v.m_asciiString;
+            } else
+                m_stringValue += v.toString(); // numbers only contain ASCII characters
+
+            m_numberCache = NumberCache::None;
+
+            if (mayBeNumber || m_stringValue.size() <= 9) // "-Infinity" has 9 characters
+                initString(m_stringValue);
+        }
+
         /*! Adds the given value to the value. */
         void add(const Value &v)
         {
@@ -429,6 +496,9 @@ class LIBSCRATCHCPP_EXPORT Value
                 m_type = Type::String;
             }
 
+            m_numberCache = NumberCache::None;
+            m_asciiString = isAscii(m_stringValue);
+
             initString(v);
             return *this;
         }
@@ -442,6 +512,9 @@ class LIBSCRATCHCPP_EXPORT Value
                 m_type = Type::String;
             }
 
+            m_numberCache = NumberCache::None;
+            m_asciiString = isAscii(m_stringValue);
+
             initString(v);
             return *this;
         }
@@ -475,6 +548,10 @@ class LIBSCRATCHCPP_EXPORT Value
                         m_stringValue = v.m_stringValue;
                     else
                         new (&m_stringValue) std::string(v.m_stringValue);
+
+                    m_numberCache = v.m_numberCache;
+                    m_stringNumber = v.m_stringNumber;
+                    m_asciiString = v.m_asciiString;
                     break;
 
                 default:
@@ -487,6 +564,7 @@ class LIBSCRATCHCPP_EXPORT Value
         }
 
     private:
+        // Scripts exported to C++ depend on the layout of the data members (increase NativeScriptApi::version when it changes)
         union
         {
                 long m_intValue;
@@ -550,7 +628,49 @@ class LIBSCRATCHCPP_EXPORT Value
 
         void initString(const char *str) { initString(std::string(str)); }
 
+        // Returns the number represented by the string (0 if it isn't a number), which is parsed only once
+        double stringNumber() const
+        {
+            if (m_numberCache == NumberCache::None)
+                parseString();
+
+            return m_stringNumber;
+        }
+
+        // Same as checkString(toString(), ...) for strings, but the string is parsed only once (the number is always stored in doubleValue)
+        int checkStringNumber(double *doubleValue) const
+        {
+            if (m_numberCache == NumberCache::None)
+                parseString();
+
+            *doubleValue = m_stringNumber;
+            return m_numberCache == NumberCache::Number ? 2 : 0;
+        }
+
+        void parseString() const
+        {
+            bool ok;
+            m_stringNumber = stringToDouble(m_stringValue, &ok);
+
+            // checkString() uses stringToLong() if there isn't a decimal point or an exponent (it fails if stringToDouble() fails)
+            if (ok && (m_stringValue.find_first_of(".eE") == std::string::npos))
+                stringToLong(m_stringValue, &ok);
+
+            m_numberCache = ok ? NumberCache::Number : NumberCache::NotNumber;
+        }
+
+        // The parsed number of strings (invalidated when a string is assigned)
+        enum class NumberCache : unsigned char
+        {
+            None,
+            NotNumber, // not a number according to checkString() (it may still be converted to a number, e.g. " 5")
+            Number
+        };
+
         Type m_type;
+        mutable NumberCache m_numberCache = NumberCache::None;
+        bool m_asciiString = false; // whether the string only contains ASCII characters (set when a string is assigned)
+        mutable double m_stringNumber = 0;
 
         friend bool operator==(const Value &v1, const Value &v2)
         {
@@ -564,7 +684,7 @@ class LIBSCRATCHCPP_EXPORT Value
                     case Type::Bool:
                         return v1.toBool() == v2.toBool();
                     case Type::String:
-                        return stringsEqual(v1.toUtf16(), v2.toUtf16());
+                        return stringsEqual(v1.m_stringValue, v2.m_stringValue);
                     default:
                         if ((static_cast<int>(v1.m_type) < 0) && (static_cast<int>(v2.m_type) < 0)) {
                             return v1.m_type == v2.m_type;
@@ -573,12 +693,12 @@ class LIBSCRATCHCPP_EXPORT Value
             } else {
                 if (v1.isString() || v2.isString()) {
                     if (static_cast<int>(v1.m_type) < 0 || static_cast<int>(v2.m_type) < 0)
-                        return stringsEqual(v1.toUtf16(), v2.toUtf16());
+                        return stringsEqual(v1.toString(), v2.toString());
 
                     long l1, l2;
                     double d1, d2;
-                    int type1 = checkString(v1.toString(), &l1, &d1);
-                    int type2 = checkString(v2.toString(), &l2, &d2);
+                    int type1 = v1.isString() ? v1.checkStringNumber(&d1) : checkString(v1.toString(), &l1, &d1);
+                    int type2 = v2.isString() ? v2.checkStringNumber(&d2) : checkString(v2.toString(), &l2, &d2);
 
                     if (type1 == 1)
                         d1 = l1;
@@ -593,7 +713,7 @@ class LIBSCRATCHCPP_EXPORT Value
                     else if (type1 > 0)
                         return doubleToString(d1) == v2.toString();
                     else
-                        return stringsEqual(v1.toUtf16(), v2.toUtf16());
+                        return stringsEqual(v1.toString(), v2.toString());
                 } else if (v1.isNumber() || v2.isNumber()) {
                     if (static_cast<int>(v1.m_type) < 0 || static_cast<int>(v2.m_type) < 0)
                         return false;
@@ -740,18 +860,103 @@ class LIBSCRATCHCPP_EXPORT Value
                 return fmod(v1.toDouble(), v2.toDouble());
         }
 
-        static bool stringsEqual(std::u16string s1, std::u16string s2)
+        // Case-insensitive comparison of UTF-8 strings (only ASCII letters are converted to lower case)
+        static bool stringsEqual(const std::string &s1, const std::string &s2)
         {
-            std::transform(s1.begin(), s1.end(), s1.begin(), ::tolower);
-            std::transform(s2.begin(), s2.end(), s2.begin(), ::tolower);
-            return (s1.compare(s2) == 0);
+            if (s1.size() != s2.size())
+                return false;
+
+            const char *p1 = s1.data();
+            const char *p2 = s2.data();
+            const char *end = p1 + s1.size();
+
+            // Compare 8 bytes at a time
+            for (; p1 + sizeof(uint64_t) <= end; p1 += sizeof(uint64_t), p2 += sizeof(uint64_t)) {
+                uint64_t w1, w2;
+                memcpy(&w1, p1, sizeof(w1));
+                memcpy(&w2, p2, sizeof(w2));
+
+                if ((w1 != w2) && (asciiToLower(w1) != asciiToLower(w2)))
+                    return false;
+            }
+
+            for (; p1 < end; p1++, p2++) {
+                if ((*p1 != *p2) && (asciiToLower(*p1) != asciiToLower(*p2)))
+                    return false;
+            }
+
+            return true;
         }
 
-        static bool stringsEqual(std::string s1, std::string s2)
+        static bool isAscii(const std::string &str)
         {
-            std::transform(s1.begin(), s1.end(), s1.begin(), ::tolower);
-            std::transform(s2.begin(), s2.end(), s2.begin(), ::tolower);
-            return (s1.compare(s2) == 0);
+            const char *p = str.data();
+            const char *end = p + str.size();
+
+            // Check 8 bytes at a time
+            for (; p + sizeof(uint64_t) <= end; p += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, p, sizeof(word));
+
+                if (word & 0x8080808080808080)
+                    return false;
+            }
+
+            for (; p < end; p++) {
+                if (*p & 0x80)
+                    return false;
+            }
+
+            return true;
+        }
+
+        // Length of the UTF-8 character starting with the given byte
+        static size_t utf8CharLength(unsigned char c) { return c < 0x80 ? 1 : (c >= 0xf0 ? 4 : (c >= 0xe0 ? 3 : 2)); }
+
+        // Same as utf8::utf8to16(str).size()
+        static size_t utf16Size(const std::string &str)
+        {
+            size_t ret = 0;
+
+            for (unsigned char c : str) {
+                if ((c & 0xc0) != 0x80)
+                    ret += (c >= 0xf0) ? 2 : 1; // 4-byte characters are surrogate pairs in UTF-16
+            }
+
+            return ret;
+        }
+
+        // Same as utf8::utf16to8(std::u16string({ utf8::utf8to16(str)[index] })), but returns an empty string for halves of surrogate pairs
+        static std::string utf16At(const std::string &str, size_t index)
+        {
+            size_t unit = 0;
+
+            for (size_t i = 0; i < str.size();) {
+                size_t length = utf8CharLength(str[i]);
+                size_t units = (length == 4) ? 2 : 1;
+
+                if (index < unit + units)
+                    return (units == 1) ? str.substr(i, length) : "";
+
+                unit += units;
+                i += length;
+            }
+
+            return "";
+        }
+
+        static char asciiToLower(char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+
+        // Converts the ASCII letters in the 8 bytes to lower case (bytes of multibyte UTF-8 characters have the highest bit set, so they don't change)
+        static uint64_t asciiToLower(uint64_t word)
+        {
+            constexpr uint64_t ones = 0x0101010101010101;
+            constexpr uint64_t highBits = 0x8080808080808080;
+            uint64_t lowBits = word & ~highBits;
+            uint64_t greaterThanZ = lowBits + (0x7f - 'Z') * ones; // the highest bit is set in bytes greater than 'Z'
+            uint64_t atLeastA = lowBits + (0x80 - 'A') * ones;     // the highest bit is set in bytes greater than or equal to 'A'
+            uint64_t upper = ~word & (atLeastA ^ greaterThanZ) & highBits;
+            return word | (upper >> 2); // 0x80 >> 2 == 'a' - 'A'
         }
 
         static double stringToDouble(const std::string &s, bool *ok = nullptr)
@@ -774,49 +979,35 @@ class LIBSCRATCHCPP_EXPORT Value
             }
 
             static const std::string digits = "0123456789.eE+-";
-            const std::string *stringPtr = &s;
-            bool customStr = false;
-
-            if (!s.empty() && ((s[0] == ' ') || (s.back() == ' '))) {
-                std::string *localPtr = new std::string(s);
-                stringPtr = localPtr;
-                customStr = true;
+            const char *begin = s.data();
+            const char *end = begin + s.size();
 
-                while (!localPtr->empty() && (localPtr->at(0) == ' '))
-                    localPtr->erase(0, 1);
+            // Ignore leading and trailing spaces
+            while ((begin < end) && (*begin == ' '))
+                begin++;
 
-                while (!localPtr->empty() && (localPtr->back() == ' '))
-                    localPtr->pop_back();
-            }
+            while ((end > begin) && (*(end - 1) == ' '))
+                end--;
 
-            for (char c : *stringPtr) {
-                if (digits.find(c) == std::string::npos) {
+            for (const char *c = begin; c < end; c++) {
+                if (digits.find(*c) == std::string::npos) {
                     return 0;
                 }
             }
 
-            try {
-                if (ok)
-                    *ok = true;
-
-                // Set locale to C to avoid conversion issues
-                std::string oldLocale = std::setlocale(LC_NUMERIC, nullptr);
-                std::setlocale(LC_NUMERIC, "C");
+            if (!skipPlusSign(begin, end))
+                return 0;
 
-                double ret = std::stod(*stringPtr);
+            // std::from_chars() doesn't depend on the locale
+            double ret = 0;
 
-                // Restore old locale
-                std::setlocale(LC_NUMERIC, oldLocale.c_str());
+            if (std::from_chars(begin, end, ret).ec != std::errc())
+                return 0;
 
-                if (customStr)
-                    delete stringPtr;
+            if (ok)
+                *ok = true;
 
-                return ret;
-            } catch (...) {
-                if (ok)
-                    *ok = false;
-                return 0;
-            }
+            return ret;
         }
 
         static long stringToLong(const std::string &s, bool *ok = nullptr)
@@ -846,37 +1037,52 @@ class LIBSCRATCHCPP_EXPORT Value
                 }
             }
 
-            try {
-                if (ok)
-                    *ok = true;
-                return std::stol(s);
-            } catch (...) {
-                if (ok)
-                    *ok = false;
+            const char *begin = s.data();
+            const char *end = begin + s.size();
+
+            if (!skipPlusSign(begin, end))
                 return 0;
+
+            long ret = 0;
+
+            if (std::from_chars(begin, end, ret).ec != std::errc())
+                return 0;
+
+            if (ok)
+                *ok = true;
+
+            return ret;
+        }
+
+        // std::from_chars() doesn't accept the plus sign like std::stod() (returns false if it's followed by another sign)
+        static bool skipPlusSign(const char *&begin, const char *end)
+        {
+            if ((begin < end) && (*begin == '+')) {
+                begin++;
+                return (begin == end) || ((*begin != '+') && (*begin != '-'));
             }
+
+            return true;
         }
 
         static std::string doubleToString(double v)
         {
-            std::stringstream stream;
-            stream << v;
-            std::string s = stream.str();
-            std::size_t index;
+            // Same as writing the number to a stream (precision 6), but without the leading zeros of the exponent (1e+06 -> 1e+6)
+            char buffer[32];
+            char *end = std::to_chars(buffer, buffer + sizeof(buffer), v, std::chars_format::general, 6).ptr;
+            char *exponent = std::find(buffer, end, 'e');
 
-            for (int i = 0; i < 2; i++) {
-                if (i == 0)
-                    index = s.find("e+");
-                else
-                    index = s.find("e-");
+            if (exponent < end - 2) {
+                char *digits = exponent + 2; // skip the sign
+                char *firstDigit = digits;
 
-                if (index != std::string::npos) {
-                    while ((s.size() >= index + 3) && (s[index + 2] == '0'))
-                        s.erase(index + 2, 1);
-                }
+                while ((firstDigit < end - 1) && (*firstDigit == '0'))
+                    firstDigit++;
+
+                end = std::copy(firstDigit, end, digits);
             }
 
-            return s;
+            return std::string(buffer, end);
         }
 };
 
@@ -23,15 +23,15 @@ enum Opcode
     OP_CONST,              /*!< Adds a constant value with the index in the argument to the next register. */
     OP_NULL,               /*!< Adds a null (zero) value to the next register. */
     OP_CHECKPOINT,         /*!< A checkpoint for the VirtualMachine::moveToLastCheckpoint() method. */
-    OP_IF,                 /*!< Jumps to the next instruction if the last register holds "true". If it's false, jumps to OP_ELSE or OP_ENDIF. */
-    OP_ELSE,               /*!< Jumps to OP_ENDIF. This instruction is typically reached when the if statement condition was "true". */
+    OP_IF,                 /*!< Jumps to the next instruction if the last register holds "true". If it's false, skips the number of words in the argument (jumps after OP_ELSE or OP_ENDIF). */
+    OP_ELSE,               /*!< Skips the number of words in the argument (jumps after OP_ENDIF). This instruction is typically reached when the if statement condition was "true". */
     OP_ENDIF,              /*!< Doesn't do anything, but is used by OP_IF and OP_ELSE. */
     OP_FOREVER_LOOP,       /*!< Runs a forever loop. */
-    OP_REPEAT_LOOP,        /*!< Runs a repeat loop with the number of periods stored in the last register. */
+    OP_REPEAT_LOOP,        /*!< Runs a repeat loop with the number of periods stored in the last register. If there are no periods, skips the number of words in the argument (jumps after OP_LOOP_END). */
     OP_REPEAT_LOOP_INDEX,  /*!< Returns the index of current repeat loop. */
     OP_REPEAT_LOOP_INDEX1, /*!< Returns the index of current repeat loop plus 1. */
-    OP_UNTIL_LOOP,         /*!< Evaluates the condition before OP_BEGIN_UNTIL_LOOP and runs a repeat until loop. */
-    OP_BEGIN_UNTIL_LOOP,   /*!< Used by OP_UNTIL_LOOP. */
+    OP_UNTIL_LOOP,         /*!< Evaluates the condition before OP_BEGIN_UNTIL_LOOP and runs a repeat until loop. If the condition is true, skips the number of words in the argument (jumps after OP_LOOP_END). */
+    OP_BEGIN_UNTIL_LOOP,   /*!< Ends the condition of OP_UNTIL_LOOP. If the condition in the last register is true, jumps after OP_LOOP_END. */
     OP_LOOP_END,           /*!< Ends the loop. */
     OP_PRINT,              /*!< Prints the value stored in the last register. */
     OP_ADD,                /*!< Adds the values stored in the last 2 registers and stores the result in the last registry, deleting the input registers. */
@@ -80,7 +80,24 @@ enum Opcode
     OP_ADD_ARG,        /*!< Adds a procedure (custom block) argument with the value from the last register. */
     OP_READ_ARG,       /*!< Reads the procedure (custom block) argument with the index in the argument and stores the value in the last register. */
     OP_BREAK_FRAME,    /*!< Breaks current frame at the end of the loop. */
-    OP_WARP            /*! Runs the script without screen refresh. */
+    OP_WARP,           /*! Runs the script without screen refresh. */
+    OP_CHANGE_VAR_CONST,  /*!< Increments (or decrements) the variable with the index in the first argument by the constant value with the index in the second argument. */
+    OP_IF_VAR_EQ_CONST,   /*!< Same as OP_IF, but the condition is whether the variable with the index in the first argument equals the constant value with the index in the second argument. The third argument is the jump offset. */
+    OP_LIST_GET_VAR_INDEX, /*!< Stores the value at the index (or item like "last" or "random") stored in the variable with the index in the second argument (of the list with the index in the first argument), in the next register. */
+    OP_READ_INLINE_ARG,    /*!< Reads the argument of an inlined procedure (custom block) with the offset from the top of the argument stack in the argument and stores the value in the next register. */
+    OP_FREE_INLINE_ARGS,   /*!< Removes the number of arguments in the argument from the top of the argument stack (used at the end of inlined procedures). */
+    OP_TAIL_CALL,          /*!< Same as OP_CALL_PROCEDURE, but the procedure replaces the current procedure (its arguments replace the current arguments and it returns to the caller of the current procedure). */
+    OP_ADD_NUM,            /*!< Same as OP_ADD, but both registers are known to contain numbers (integers or decimal numbers). */
+    OP_SUBTRACT_NUM,       /*!< Same as OP_SUBTRACT, but both registers are known to contain numbers. */
+    OP_MULTIPLY_NUM,       /*!< Same as OP_MULTIPLY, but both registers are known to contain numbers. */
+    OP_GREATER_THAN_NUM,   /*!< Same as OP_GREATER_THAN, but both registers are known to contain numbers. */
+    OP_LESS_THAN_NUM,      /*!< Same as OP_LESS_THAN, but both registers are known to contain numbers. */
+    OP_EQUALS_NUM,         /*!< Same as OP_EQUALS, but both registers are known to contain numbers. */
+    OP_EQUALS_VAR,         /*!< Same as OP_EQUALS, but the second operand is the variable with the index in the argument (it's read without copying it to a register). */
+    OP_GREATER_THAN_VAR,   /*!< Same as OP_GREATER_THAN, but the second operand is the variable with the index in the argument. */
+    OP_LESS_THAN_VAR,      /*!< Same as OP_LESS_THAN, but the second operand is the variable with the index in the argument. */
+    OP_STR_CONCAT_VAR,     /*!< Same as OP_STR_CONCAT, but the second operand is the variable with the index in the argument. */
+    OP_VAR_APPEND_STR      /*!< Appends the string stored in the last register to the variable with the index in the argument (the string isn't copied, used for "set [var] to (join (var) (...))"). */
 };
 
 }
@@ -89,11 +106,14 @@ class Target;
 class IEngine;
 class Script;
 class List;
+class Profiler;
 
 /*! \brief The VirtualMachine class is a virtual machine for compiled Scratch scripts. */
 class LIBSCRATCHCPP_EXPORT VirtualMachine
 {
     public:
+        friend class NativeScriptApi;
+
         VirtualMachine();
         VirtualMachine(Target *target, IEngine *engine, Script *script);
         VirtualMachine(const VirtualMachine &) = delete;
@@ -107,6 +127,7 @@ class LIBSCRATCHCPP_EXPORT VirtualMachine
         void setListsVector(const std::vector<List *> &lists);
 
         void setBytecode(unsigned int *code);
+        void setNativeScript(NativeScript script);
 
         unsigned int **procedures() const;
         const BlockFunc *functions() const;
@@ -115,6 +136,7 @@ class LIBSCRATCHCPP_EXPORT VirtualMachine
         List **lists() const;
 
         unsigned int *bytecode() const;
+        NativeScript nativeScript() const;
 
         size_t registerCount() const;
 
@@ -131,6 +153,18 @@ class LIBSCRATCHCPP_EXPORT VirtualMachine
         void reset();
         void moveToLastCheckpoint();
 
+        void precompile();
+        bool isPrecompiled() const;
+
+        unsigned int precompileThreshold() const;
+        void setPrecompileThreshold(unsigned int threshold);
+
+        int warpTime() const;
+        void setWarpTime(int time);
+
+        Profiler *profiler() const;
+        void setProfiler(Profiler *profiler);
+
         void stop(bool savePos = true, bool breakFrame = false, bool goBack = false);
 
         bool atEnd() const;
@@ -26,6 +26,9 @@ void Compiler::init()
         return;
 
     impl->bytecode.clear();
+    impl->bytecodeBlocks.clear();
+    impl->regCount = 0;
+    impl->maxRegCount = 0;
     impl->procedurePrototype = nullptr;
     impl->warp = false;
 
@@ -38,9 +41,9 @@ void Compiler::init()
 /*! Compiles the script. Use bytecode() to read the generated bytecode. */
 void Compiler::compile(std::shared_ptr<Block> topLevelBlock)
 {
+    impl->block = topLevelBlock; // the start instruction belongs to the top level block
     init();
 
-    impl->block = topLevelBlock;
     while (impl->block) {
         size_t substacks = impl->substackTree.size();
 
@@ -49,6 +52,9 @@ void Compiler::compile(std::shared_ptr<Block> topLevelBlock)
         else
             std::cout << "warning: unsupported block: " << impl->block->opcode() << std::endl;
 
+        // Stack blocks don't leave anything in the registers
+        impl->regCount = 0;
+
         if (substacks != impl->substackTree.size())
             continue;
 
@@ -71,6 +77,16 @@ void Compiler::end()
     // Add end instruction (halt)
     addInstruction(OP_HALT);
 
+    if (impl->optimizationsEnabled)
+        impl->optimize();
+
+    // Resolve the targets of if statements and loops
+    impl->resolveJumps(impl->bytecode);
+
+    // Tail calls are found by following the jumps
+    if (impl->optimizationsEnabled)
+        impl->optimizeTailCalls();
+
     impl->initialized = false;
 }
 
@@ -80,6 +96,24 @@ const std::vector<unsigned int> &Compiler::bytecode() const
     return impl->bytecode;
 }
 
+/*!
+ * Returns the block which generated each word of the bytecode (the vector has the same size as bytecode()).
+ * Instructions merged by the optimizations belong to the block of the first instruction.
+ */
+const std::vector<Block *> &Compiler::bytecodeBlocks() const
+{
+    return impl->bytecodeBlocks;
+}
+
+/*!
+ * Returns the maximum number of registers used by the bytecode.
+ * Functions called by vm::OP_EXEC are expected to add at most one return value.
+ */
+size_t Compiler::maxRegisterCount() const
+{
+    return impl->maxRegCount;
+}
+
 /*! Returns the Engine. */
 IEngine *Compiler::engine() const
 {
@@ -91,6 +125,18 @@ Target *Compiler::target() const
     return impl->target;
 }
 
+/*! Returns true if bytecode optimizations (such as superinstructions) are enabled. */
+bool Compiler::optimizationsEnabled() const
+{
+    return impl->optimizationsEnabled;
+}
+
+/*! Sets whether bytecode optimizations are enabled. This is useful for comparing the performance with and without optimizations. */
+void Compiler::setOptimizationsEnabled(bool enabled)
+{
+    impl->optimizationsEnabled = enabled;
+}
+
 /*! Returns the list of constant input values. */
 const std::vector<InputValue *> &Compiler::constInputValues() const
 {
@@ -101,14 +147,8 @@ const std::vector<InputValue *> &Compiler::constInputValues() const
 std::vector<Value> Compiler::constValues() const
 {
     std::vector<Value> ret;
-    for (auto value : impl->constValues) {
-        const auto &menuInfo = impl->constValueMenuInfo.at(value);
-
-        if (menuInfo.first)
-            ret.push_back(menuInfo.second);
-        else
-            ret.push_back(value->value());
-    }
+    for (unsigned int i = 0; i < impl->constValues.size(); i++)
+        ret.push_back(impl->constValue(i));
     return ret;
 }
 
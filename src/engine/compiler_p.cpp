@@ -1,8 +1,12 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <scratchcpp/block.h>
+#include <scratchcpp/blockprototype.h>
+#include <cmath>
+#include <unordered_set>
 
 #include "compiler_p.h"
+#include "virtualmachine_p.h"
 
 using namespace libscratchcpp;
 using namespace vm;
@@ -19,6 +23,421 @@ void CompilerPrivate::addInstruction(vm::Opcode opcode, std::initializer_list<un
     bytecode.push_back(opcode);
     for (auto arg : args)
         bytecode.push_back(arg);
+
+    // Track the number of used registers (optimizations can only reduce it)
+    int regEffect = VirtualMachinePrivate::instruction_reg_effect[opcode];
+
+    if (regEffect < 0 && regCount < static_cast<size_t>(-regEffect))
+        regCount = 0;
+    else
+        regCount += regEffect;
+
+    maxRegCount = std::max(maxRegCount, regCount);
+
+    // Reserve space for the jump offset (it's resolved in resolveJumps())
+    if (args.size() == 0) {
+        switch (opcode) {
+            case OP_IF:
+            case OP_ELSE:
+            case OP_REPEAT_LOOP:
+            case OP_UNTIL_LOOP:
+                bytecode.push_back(0);
+                break;
+            default:
+                break;
+        }
+    }
+
+    bytecodeBlocks.resize(bytecode.size(), block.get());
+}
+
+// Number of inputs of instructions which don't have side effects (their result only depends on the inputs)
+static const std::unordered_map<unsigned int, size_t> PURE_OPERATORS = {
+    { OP_ADD, 2 }, { OP_SUBTRACT, 2 }, { OP_MULTIPLY, 2 }, { OP_DIVIDE, 2 }, { OP_MOD, 2 }, { OP_ROUND, 1 }, { OP_ABS, 1 }, { OP_FLOOR, 1 }, { OP_CEIL, 1 },
+    { OP_SQRT, 1 }, { OP_SIN, 1 }, { OP_COS, 1 }, { OP_TAN, 1 }, { OP_ASIN, 1 }, { OP_ACOS, 1 }, { OP_ATAN, 1 }, { OP_GREATER_THAN, 2 }, { OP_LESS_THAN, 2 },
+    { OP_EQUALS, 2 }, { OP_AND, 2 }, { OP_OR, 2 }, { OP_NOT, 1 }, { OP_STR_CONCAT, 2 }, { OP_STR_AT, 2 }, { OP_STR_LENGTH, 1 }, { OP_STR_CONTAINS, 2 }
+};
+
+// Instructions which read the second operand directly from a variable
+static const std::unordered_map<unsigned int, Opcode> VAR_OPERATORS = {
+    { OP_EQUALS, OP_EQUALS_VAR }, { OP_GREATER_THAN, OP_GREATER_THAN_VAR }, { OP_LESS_THAN, OP_LESS_THAN_VAR }, { OP_STR_CONCAT, OP_STR_CONCAT_VAR }
+};
+
+// Instructions which only read registers, variables, lists or arguments (in addition to PURE_OPERATORS)
+static const std::unordered_set<unsigned int> READ_ONLY_INSTRUCTIONS = {
+    OP_CONST, OP_NULL, OP_READ_VAR, OP_READ_ARG, OP_READ_INLINE_ARG, OP_REPEAT_LOOP_INDEX, OP_REPEAT_LOOP_INDEX1, OP_LIST_GET_ITEM, OP_LIST_INDEX_OF, OP_LIST_LENGTH, OP_LIST_CONTAINS
+};
+
+// Instructions which are used instead of the operators if both inputs are known to be numbers
+static const std::unordered_map<unsigned int, Opcode> NUMBER_OPERATORS = {
+    { OP_ADD, OP_ADD_NUM }, { OP_SUBTRACT, OP_SUBTRACT_NUM }, { OP_MULTIPLY, OP_MULTIPLY_NUM }, { OP_GREATER_THAN, OP_GREATER_THAN_NUM }, { OP_LESS_THAN, OP_LESS_THAN_NUM }, { OP_EQUALS, OP_EQUALS_NUM }
+};
+
+void CompilerPrivate::optimize()
+{
+    foldConstants();
+
+    // Replace common instruction sequences with superinstructions
+    std::vector<size_t> instructions;
+    size_t i = 0;
+
+    while (i < bytecode.size()) {
+        instructions.push_back(i);
+        i += VirtualMachinePrivate::instruction_arg_count[bytecode[i]] + 1;
+    }
+
+    auto opcodeAt = [this, &instructions](size_t index) -> unsigned int { return index < instructions.size() ? bytecode[instructions[index]] : static_cast<unsigned int>(OP_HALT); };
+    auto argAt = [this, &instructions](size_t index, size_t arg) { return bytecode[instructions[index] + arg + 1]; };
+
+    std::vector<unsigned int> optimized;
+    std::vector<Block *> optimizedBlocks;
+    optimized.reserve(bytecode.size());
+    optimizedBlocks.reserve(bytecode.size());
+    i = 0;
+
+    // Returns the index of the OP_STR_CONCAT instruction if the OP_READ_VAR instruction with the given index starts
+    // "set [var] to (join (var) (...))" and the second operand can't change the variable (0 otherwise)
+    auto findAppend = [this, &instructions, &opcodeAt, &argAt](size_t index) -> size_t {
+        int regCount = 0; // the number of registers used by the second operand
+
+        for (size_t j = index + 1; j < instructions.size(); j++) {
+            unsigned int opcode = opcodeAt(j);
+
+            if (opcode == OP_STR_CONCAT && regCount == 1)
+                return (opcodeAt(j + 1) == OP_SET_VAR && argAt(j + 1, 0) == argAt(index, 0)) ? j : 0;
+
+            if ((PURE_OPERATORS.find(opcode) == PURE_OPERATORS.cend()) && (READ_ONLY_INSTRUCTIONS.find(opcode) == READ_ONLY_INSTRUCTIONS.cend()))
+                return 0;
+
+            // The operand can't read the register with the variable
+            if (regCount < static_cast<int>(VirtualMachinePrivate::instruction_input_count[opcode]))
+                return 0;
+
+            regCount += VirtualMachinePrivate::instruction_reg_effect[opcode];
+        }
+
+        return 0;
+    };
+
+    std::vector<bool> appends(instructions.size(), false); // OP_STR_CONCAT instructions which append to a variable
+
+    // Superinstructions belong to the block of their first instruction
+    auto add = [this, &instructions, &i, &optimized, &optimizedBlocks](std::initializer_list<unsigned int> words) {
+        optimized.insert(optimized.end(), words);
+        optimizedBlocks.resize(optimized.size(), bytecodeBlocks[instructions[i]]);
+    };
+
+    while (i < instructions.size()) {
+        // set [var] to (join (var) (...)) (the variable isn't read, the second operand is appended to it in place)
+        if (opcodeAt(i) == OP_READ_VAR) {
+            size_t concat = findAppend(i);
+
+            if (concat > 0) {
+                appends[concat] = true;
+                i++;
+                continue;
+            }
+        }
+
+        if (appends[i]) {
+            add({ OP_VAR_APPEND_STR, argAt(i + 1, 0) });
+            i += 2;
+            continue;
+        }
+
+        if (opcodeAt(i) == OP_READ_VAR && opcodeAt(i + 1) == OP_CONST) {
+            // set [var] to ((var) + (const))
+            if (opcodeAt(i + 2) == OP_ADD && opcodeAt(i + 3) == OP_SET_VAR && argAt(i, 0) == argAt(i + 3, 0)) {
+                add({ OP_CHANGE_VAR_CONST, argAt(i, 0), argAt(i + 1, 0) });
+                i += 4;
+                continue;
+            }
+
+            // if <(var) = (const)>
+            if (opcodeAt(i + 2) == OP_EQUALS && opcodeAt(i + 3) == OP_IF) {
+                add({ OP_IF_VAR_EQ_CONST, argAt(i, 0), argAt(i + 1, 0), 0 });
+                i += 4;
+                continue;
+            }
+
+            // (var) = (const) (the operands are swapped, so that the variable isn't copied)
+            if (opcodeAt(i + 2) == OP_EQUALS) {
+                add({ OP_CONST, argAt(i + 1, 0), OP_EQUALS_VAR, argAt(i, 0) });
+                i += 3;
+                continue;
+            }
+        }
+
+        // change [var] by (const)
+        if (opcodeAt(i) == OP_CONST && opcodeAt(i + 1) == OP_CHANGE_VAR) {
+            add({ OP_CHANGE_VAR_CONST, argAt(i + 1, 0), argAt(i, 0) });
+            i += 2;
+            continue;
+        }
+
+        // (...) = (var), (...) > (var), (...) < (var), join (...) (var)
+        if (opcodeAt(i) == OP_READ_VAR) {
+            auto it = VAR_OPERATORS.find(opcodeAt(i + 1));
+
+            if (it != VAR_OPERATORS.cend() && !(i + 1 < appends.size() && appends[i + 1])) {
+                add({ it->second, argAt(i, 0) });
+                i += 2;
+                continue;
+            }
+        }
+
+        // item (var) of [list]
+        if (opcodeAt(i) == OP_READ_VAR && opcodeAt(i + 1) == OP_LIST_GET_ITEM) {
+            add({ OP_LIST_GET_VAR_INDEX, argAt(i + 1, 0), argAt(i, 0) });
+            i += 2;
+            continue;
+        }
+
+        size_t pos = instructions[i];
+        size_t end = i + 1 < instructions.size() ? instructions[i + 1] : bytecode.size();
+        optimized.insert(optimized.end(), bytecode.begin() + pos, bytecode.begin() + end);
+        optimizedBlocks.insert(optimizedBlocks.end(), bytecodeBlocks.begin() + pos, bytecodeBlocks.begin() + end);
+        i++;
+    }
+
+    bytecode = optimized;
+    bytecodeBlocks = optimizedBlocks;
+    specializeTypes();
+}
+
+void CompilerPrivate::specializeTypes()
+{
+    // Track which registers contain numbers (integers or decimal numbers) and replace operators
+    // with number inputs with the OP_*_NUM instructions
+    std::vector<bool> numbers; // the last registers (the registers below them are unknown)
+    size_t i = 0;
+
+    while (i < bytecode.size()) {
+        unsigned int opcode = bytecode[i];
+        size_t inputCount = VirtualMachinePrivate::instruction_input_count[opcode];
+        int regEffect = VirtualMachinePrivate::instruction_reg_effect[opcode];
+        bool numberInputs = (inputCount > 0) && (numbers.size() >= inputCount) && std::all_of(numbers.end() - inputCount, numbers.end(), [](bool number) { return number; });
+        bool numberResult = false;
+        auto it = NUMBER_OPERATORS.find(opcode);
+
+        if (numberInputs && it != NUMBER_OPERATORS.cend()) {
+            bytecode[i] = it->second;
+
+            // Adding, subtracting or multiplying numbers always results in a number (comparisons result in booleans)
+            numberResult = (opcode == OP_ADD || opcode == OP_SUBTRACT || opcode == OP_MULTIPLY);
+        }
+
+        switch (opcode) {
+            case OP_CONST:
+                numberResult = (bytecode[i + 1] < constValues.size()) && constValue(bytecode[i + 1]).isNumber();
+                break;
+
+            case OP_REPEAT_LOOP_INDEX:
+            case OP_REPEAT_LOOP_INDEX1:
+            case OP_LIST_INDEX_OF:
+            case OP_LIST_LENGTH:
+            case OP_STR_LENGTH:
+                numberResult = true;
+                break;
+
+            default:
+                break;
+        }
+
+        if (opcode == OP_EXEC) {
+            // The number of registers used by functions is unknown
+            numbers.clear();
+        } else {
+            size_t readCount = std::max(static_cast<int>(inputCount), -regEffect);
+
+            if (numbers.size() < readCount)
+                numbers.clear();
+            else
+                numbers.resize(numbers.size() - readCount);
+
+            for (int j = 0; j < static_cast<int>(readCount) + regEffect; j++)
+                numbers.push_back(numberResult);
+        }
+
+        i += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+}
+
+void CompilerPrivate::foldConstants()
+{
+    // Evaluate operators with constant inputs at compile time
+    struct ConstInstruction
+    {
+            size_t pos;
+            Value value;
+            bool folded;
+    };
+
+    std::vector<unsigned int> folded;
+    std::vector<Block *> foldedBlocks;
+    folded.reserve(bytecode.size());
+    foldedBlocks.reserve(bytecode.size());
+    std::vector<ConstInstruction> constInstructions; // the OP_CONST instructions directly before the current instruction
+    size_t i = 0;
+
+    while (i < bytecode.size()) {
+        unsigned int opcode = bytecode[i];
+        size_t argCount = VirtualMachinePrivate::instruction_arg_count[opcode];
+        auto it = PURE_OPERATORS.find(opcode);
+
+        if (it != PURE_OPERATORS.cend() && constInstructions.size() >= it->second) {
+            // Replace the inputs and the operator with the result (it's added to the constant values later
+            // so that the results of nested operators don't end up there)
+            std::vector<Value> inputs;
+
+            for (auto input = constInstructions.end() - it->second; input != constInstructions.end(); input++)
+                inputs.push_back(input->value);
+
+            folded.resize((constInstructions.end() - it->second)->pos);
+            foldedBlocks.resize(folded.size());
+            constInstructions.resize(constInstructions.size() - it->second);
+            constInstructions.push_back({ folded.size(), evaluate(static_cast<Opcode>(opcode), inputs), true });
+            folded.insert(folded.end(), { OP_CONST, 0 });
+            foldedBlocks.resize(folded.size(), bytecodeBlocks[i]);
+        } else {
+            if (opcode == OP_CONST && bytecode[i + 1] < constValues.size())
+                constInstructions.push_back({ folded.size(), constValue(bytecode[i + 1]), false });
+            else {
+                for (const ConstInstruction &instruction : constInstructions) {
+                    if (instruction.folded)
+                        folded[instruction.pos + 1] = constIndex(instruction.value);
+                }
+
+                constInstructions.clear();
+            }
+
+            folded.insert(folded.end(), bytecode.begin() + i, bytecode.begin() + i + argCount + 1);
+            foldedBlocks.insert(foldedBlocks.end(), bytecodeBlocks.begin() + i, bytecodeBlocks.begin() + i + argCount + 1);
+        }
+
+        i += argCount + 1;
+    }
+
+    assert(constInstructions.empty());
+    bytecode = folded;
+    bytecodeBlocks = foldedBlocks;
+}
+
+Value CompilerPrivate::evaluate(Opcode opcode, const std::vector<Value> &inputs)
+{
+    // Run the operator in a temporary VM to get exactly the same result as at runtime
+    std::vector<unsigned int> code = { OP_START };
+
+    for (unsigned int i = 0; i < inputs.size(); i++)
+        code.insert(code.end(), { OP_CONST, i });
+
+    code.insert(code.end(), { opcode, OP_SET_VAR, 0, OP_HALT });
+
+    Value result;
+    Value *variables[] = { &result };
+    VirtualMachine vm;
+    vm.setBytecode(code.data());
+    vm.setConstValues(inputs.data());
+    vm.setVariables(variables);
+    vm.run();
+    assert(vm.registerCount() == 0);
+
+    return result;
+}
+
+void CompilerPrivate::resolveJumps(std::vector<unsigned int> &bytecode)
+{
+    // Positions of the instructions which start the current if statements and loops
+    std::vector<size_t> startTree;
+    size_t i = 0;
+
+    while (i < bytecode.size()) {
+        unsigned int opcode = bytecode[i];
+
+        switch (opcode) {
+            case OP_IF:
+            case OP_IF_VAR_EQ_CONST:
+            case OP_FOREVER_LOOP:
+            case OP_REPEAT_LOOP:
+            case OP_UNTIL_LOOP:
+                startTree.push_back(i);
+                break;
+
+            case OP_ELSE:
+                assert(!startTree.empty() && (bytecode[startTree.back()] == OP_IF || bytecode[startTree.back()] == OP_IF_VAR_EQ_CONST));
+
+                if (!startTree.empty()) {
+                    // If the condition is false, jump to the first instruction after OP_ELSE
+                    setJumpTarget(bytecode, startTree.back(), i + 2);
+                    startTree.back() = i;
+                }
+
+                break;
+
+            case OP_ENDIF:
+            case OP_LOOP_END:
+                assert(!startTree.empty());
+
+                if (!startTree.empty()) {
+                    if (bytecode[startTree.back()] != OP_FOREVER_LOOP)
+                        setJumpTarget(bytecode, startTree.back(), i + 1);
+
+                    startTree.pop_back();
+                }
+
+                break;
+
+            default:
+                break;
+        }
+
+        i += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+
+    assert(startTree.empty());
+}
+
+void CompilerPrivate::optimizeTailCalls()
+{
+    // Replace calls of the current procedure which are followed by the end of the procedure with OP_TAIL_CALL
+    if (!procedurePrototype)
+        return;
+
+    auto it = std::find(procedures.begin(), procedures.end(), procedurePrototype->procCode());
+
+    if (it == procedures.end())
+        return;
+
+    unsigned int index = it - procedures.begin();
+    size_t i = 0;
+
+    while (i < bytecode.size()) {
+        unsigned int opcode = bytecode[i];
+
+        if (opcode == OP_CALL_PROCEDURE && bytecode[i + 1] == index) {
+            size_t next = i + 2;
+
+            while (bytecode[next] == OP_ENDIF || bytecode[next] == OP_ELSE) {
+                if (bytecode[next] == OP_ELSE)
+                    next += bytecode[next + 1] + 2; // the end of the if statement
+                else
+                    next++;
+            }
+
+            if (bytecode[next] == OP_HALT)
+                bytecode[i] = OP_TAIL_CALL;
+        }
+
+        i += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+}
+
+void CompilerPrivate::setJumpTarget(std::vector<unsigned int> &bytecode, size_t instruction, size_t target)
+{
+    // The last argument is the number of words between the argument and the target
+    size_t arg = instruction + VirtualMachinePrivate::instruction_arg_count[bytecode[instruction]];
+    assert(target > arg);
+    bytecode[arg] = target - arg - 1;
 }
 
 unsigned int CompilerPrivate::constIndex(InputValue *value, bool pointsToDropdownMenu, const std::string &selectedMenuItem)
@@ -31,9 +450,63 @@ unsigned int CompilerPrivate::constIndex(InputValue *value, bool pointsToDropdow
     return constValues.size() - 1;
 }
 
+unsigned int CompilerPrivate::constIndex(const Value &value)
+{
+    // Reuse an existing constant with exactly the same type and value
+    for (size_t i = 0; i < constValues.size(); i++) {
+        const Value &v = constValue(i);
+
+        if (v.type() != value.type())
+            continue;
+
+        bool equal;
+
+        switch (value.type()) {
+            case Value::Type::Integer:
+                equal = v.toLong() == value.toLong();
+                break;
+
+            case Value::Type::Double:
+                equal = v.toDouble() == value.toDouble() && std::signbit(v.toDouble()) == std::signbit(value.toDouble());
+                break;
+
+            case Value::Type::Bool:
+                equal = v.toBool() == value.toBool();
+                break;
+
+            case Value::Type::String:
+                equal = v.toString() == value.toString();
+                break;
+
+            default:
+                equal = true;
+                break;
+        }
+
+        if (equal)
+            return i;
+    }
+
+    customConstValues.push_back(std::make_unique<InputValue>());
+    customConstValues.back()->setValue(value);
+    return constIndex(customConstValues.back().get());
+}
+
+Value CompilerPrivate::constValue(unsigned int index) const
+{
+    InputValue *value = constValues[index];
+    const auto &menuInfo = constValueMenuInfo.at(value);
+
+    if (menuInfo.first)
+        return menuInfo.second;
+    else
+        return value->value();
+}
+
 void CompilerPrivate::substackEnd()
 {
     auto parent = substackTree.back();
+    block = parent.first.first; // the end of the substack belongs to the if statement or the loop
     switch (parent.second) {
         case Compiler::SubstackType::Loop:
             // Break the frame at the end of the loop so that other scripts can run within the frame
@@ -15,8 +15,17 @@ struct CompilerPrivate
         CompilerPrivate(const CompilerPrivate &) = delete;
 
         void addInstruction(vm::Opcode opcode, std::initializer_list<unsigned int> args = {});
+        void optimize();
+        void foldConstants();
+        void specializeTypes();
+        static Value evaluate(vm::Opcode opcode, const std::vector<Value> &inputs);
+        static void resolveJumps(std::vector<unsigned int> &bytecode);
+        void optimizeTailCalls();
+        static void setJumpTarget(std::vector<unsigned int> &bytecode, size_t instruction, size_t target);
 
         unsigned int constIndex(InputValue *value, bool pointsToDropdownMenu = false, const std::string &selectedMenuItem = "");
+        unsigned int constIndex(const Value &value);
+        Value constValue(unsigned int index) const;
 
         void substackEnd();
 
@@ -28,6 +37,9 @@ struct CompilerPrivate
         bool initialized = false;
 
         std::vector<unsigned int> bytecode;
+        std::vector<Block *> bytecodeBlocks; // the block which added each word of the bytecode
+        size_t regCount = 0;
+        size_t maxRegCount = 0;
         std::vector<InputValue *> constValues;
         std::vector<std::unique_ptr<InputValue>> customConstValues;
         std::unordered_map<InputValue *, std::pair<bool, std::string>> constValueMenuInfo; // input value, <whether the input points to a dropdown menu, selected menu item>
@@ -37,6 +49,7 @@ struct CompilerPrivate
         std::unordered_map<std::string, std::vector<std::string>> procedureArgs;
         BlockPrototype *procedurePrototype = nullptr;
         bool warp = false;
+        bool optimizationsEnabled = true;
 };
 
 } // namespace libscratchcpp
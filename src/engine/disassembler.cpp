@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/disassembler.h>
+#include <scratchcpp/script.h>
+
+#include "disassembler_p.h"
+#include "virtualmachine_p.h"
+
+using namespace libscratchcpp;
+
+/*! Constructs Disassembler for the given bytecode. */
+Disassembler::Disassembler(const std::vector<unsigned int> &bytecode) :
+    impl(spimpl::make_unique_impl<DisassemblerPrivate>(bytecode))
+{
+}
+
+/*! Constructs Disassembler for the bytecode of the given script (with its constant values, variables and lists). */
+Disassembler::Disassembler(Script *script) :
+    impl(spimpl::make_unique_impl<DisassemblerPrivate>(script->bytecodeVector()))
+{
+    impl->constValues = script->constValues();
+    impl->variables = script->variables();
+    impl->lists = script->lists();
+}
+
+/*! Returns the bytecode. */
+const std::vector<unsigned int> &Disassembler::bytecode() const
+{
+    return impl->bytecode;
+}
+
+/*! Sets the constant values, which are shown next to the instructions which use them. */
+void Disassembler::setConstValues(const std::vector<Value> &values)
+{
+    impl->constValues = values;
+}
+
+/*! Sets the variables, whose names are shown next to the instructions which use them. */
+void Disassembler::setVariables(const std::vector<Variable *> &variables)
+{
+    impl->variables = variables;
+}
+
+/*! Sets the lists, whose names are shown next to the instructions which use them. */
+void Disassembler::setLists(const std::vector<List *> &lists)
+{
+    impl->lists = lists;
+}
+
+/*! Returns the list of instructions (without the arguments). This is useful for checking the output of the compiler. */
+std::vector<unsigned int> Disassembler::opcodes() const
+{
+    std::vector<unsigned int> ret;
+
+    for (size_t pos : impl->instructions)
+        ret.push_back(impl->bytecode[pos]);
+
+    return ret;
+}
+
+/*! Returns the number of instructions. */
+size_t Disassembler::instructionCount() const
+{
+    return impl->instructions.size();
+}
+
+/*! Returns the number of instructions with the given opcode (see vm::Opcode). */
+size_t Disassembler::instructionCount(unsigned int opcode) const
+{
+    size_t ret = 0;
+
+    for (size_t pos : impl->instructions) {
+        if (impl->bytecode[pos] == opcode)
+            ret++;
+    }
+
+    return ret;
+}
+
+/*!
+ * Returns the disassembled bytecode with one instruction per line. Each line contains the position of the instruction,
+ * its name and its arguments, followed by the constant values, the names of variables and lists and the jump targets:
+ * \code
+ * 5: OP_CONST 1 ; "hello"
+ * 7: OP_REPEAT_LOOP 5 ; -> 13
+ * \endcode
+ * Invalid instructions end the list.
+ */
+std::string Disassembler::toString() const
+{
+    std::string ret;
+
+    for (size_t pos : impl->instructions) {
+        unsigned int opcode = impl->bytecode[pos];
+        size_t argCount = VirtualMachinePrivate::instruction_arg_count[opcode];
+        std::string line = std::to_string(pos) + ": " + opcodeName(opcode);
+        std::string comment;
+
+        for (size_t i = 0; i < argCount; i++) {
+            line += " " + std::to_string(impl->bytecode[pos + i + 1]);
+            std::string argComment = impl->argComment(opcode, i, pos + i + 1);
+
+            if (!argComment.empty())
+                comment += (comment.empty() ? "" : ", ") + argComment;
+        }
+
+        if (!comment.empty())
+            line += " ; " + comment;
+
+        ret += line + "\n";
+    }
+
+    return ret;
+}
+
+/*! Returns the name of the given instruction (for example "OP_CONST"). */
+std::string Disassembler::opcodeName(unsigned int opcode)
+{
+    if (opcode >= VirtualMachinePrivate::instruction_count)
+        return "<invalid " + std::to_string(opcode) + ">";
+
+    return VirtualMachinePrivate::instruction_names[opcode];
+}
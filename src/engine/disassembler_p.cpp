@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/variable.h>
+#include <scratchcpp/list.h>
+
+#include "disassembler_p.h"
+#include "virtualmachine_p.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+DisassemblerPrivate::DisassemblerPrivate(const std::vector<unsigned int> &bytecode) :
+    bytecode(bytecode)
+{
+    size_t pos = 0;
+
+    while (pos < bytecode.size()) {
+        unsigned int opcode = bytecode[pos];
+
+        if (opcode >= VirtualMachinePrivate::instruction_count || pos + VirtualMachinePrivate::instruction_arg_count[opcode] >= bytecode.size())
+            break;
+
+        instructions.push_back(pos);
+        pos += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+}
+
+enum class ArgType
+{
+    Number,
+    Const,
+    Variable,
+    List,
+    Jump
+};
+
+static ArgType argType(unsigned int opcode, size_t argIndex)
+{
+    switch (opcode) {
+        case OP_CONST:
+            return ArgType::Const;
+
+        case OP_IF:
+        case OP_ELSE:
+        case OP_REPEAT_LOOP:
+        case OP_UNTIL_LOOP:
+            return ArgType::Jump;
+
+        case OP_SET_VAR:
+        case OP_CHANGE_VAR:
+        case OP_READ_VAR:
+        case OP_EQUALS_VAR:
+        case OP_GREATER_THAN_VAR:
+        case OP_LESS_THAN_VAR:
+        case OP_STR_CONCAT_VAR:
+        case OP_VAR_APPEND_STR:
+            return ArgType::Variable;
+
+        case OP_READ_LIST:
+        case OP_LIST_APPEND:
+        case OP_LIST_DEL:
+        case OP_LIST_DEL_ALL:
+        case OP_LIST_INSERT:
+        case OP_LIST_REPLACE:
+        case OP_LIST_GET_ITEM:
+        case OP_LIST_INDEX_OF:
+        case OP_LIST_LENGTH:
+        case OP_LIST_CONTAINS:
+            return ArgType::List;
+
+        case OP_CHANGE_VAR_CONST:
+            return argIndex == 0 ? ArgType::Variable : ArgType::Const;
+
+        case OP_IF_VAR_EQ_CONST:
+            return argIndex == 0 ? ArgType::Variable : (argIndex == 1 ? ArgType::Const : ArgType::Jump);
+
+        case OP_LIST_GET_VAR_INDEX:
+            return argIndex == 0 ? ArgType::List : ArgType::Variable;
+
+        default:
+            return ArgType::Number;
+    }
+}
+
+std::string DisassemblerPrivate::argComment(unsigned int opcode, size_t argIndex, size_t argPos) const
+{
+    unsigned int arg = bytecode[argPos];
+
+    switch (argType(opcode, argIndex)) {
+        case ArgType::Const:
+            if (arg < constValues.size())
+                return constValues[arg].isString() ? "\"" + constValues[arg].toString() + "\"" : constValues[arg].toString();
+
+            break;
+
+        case ArgType::Variable:
+            if (arg < variables.size() && variables[arg])
+                return variables[arg]->name();
+
+            break;
+
+        case ArgType::List:
+            if (arg < lists.size() && lists[arg])
+                return lists[arg]->name();
+
+            break;
+
+        case ArgType::Jump:
+            // The offset is the number of words between the argument and the target
+            return "-> " + std::to_string(argPos + arg + 1);
+
+        default:
+            break;
+    }
+
+    return "";
+}
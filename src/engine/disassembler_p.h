@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <scratchcpp/value.h>
+#include <vector>
+
+namespace libscratchcpp
+{
+
+class Variable;
+class List;
+
+struct DisassemblerPrivate
+{
+        DisassemblerPrivate(const std::vector<unsigned int> &bytecode);
+        DisassemblerPrivate(const DisassemblerPrivate &) = delete;
+
+        std::string argComment(unsigned int opcode, size_t argIndex, size_t argPos) const;
+
+        std::vector<unsigned int> bytecode;
+        std::vector<size_t> instructions; // positions of the instructions (invalid instructions and the rest of the bytecode are skipped)
+        std::vector<Value> constValues;
+        std::vector<Variable *> variables;
+        std::vector<List *> lists;
+};
+
+} // namespace libscratchcpp
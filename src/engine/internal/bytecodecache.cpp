@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <cstring>
+#include <cstdint>
+
+#include "bytecodecache.h"
+#include "../virtualmachine_p.h"
+
+using namespace libscratchcpp;
+
+static const char magic[] = "SCRATCHCPP-BYTECODE";
+
+namespace
+{
+
+class Writer
+{
+    public:
+        Writer(std::ostream &stream) :
+            m_stream(stream)
+        {
+        }
+
+        void write(uint32_t value) { m_stream.write(reinterpret_cast<const char *>(&value), sizeof(value)); }
+        void write(const std::string &str)
+        {
+            write(static_cast<uint32_t>(str.size()));
+            m_stream.write(str.data(), str.size());
+        }
+
+        void write(const std::vector<unsigned int> &values)
+        {
+            write(static_cast<uint32_t>(values.size()));
+            m_stream.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(unsigned int));
+        }
+
+        void write(const BytecodeCache::Entity &entity)
+        {
+            write(entity.target);
+            write(entity.index);
+        }
+
+        void write(const std::vector<BytecodeCache::Entity> &entities)
+        {
+            write(static_cast<uint32_t>(entities.size()));
+
+            for (const BytecodeCache::Entity &entity : entities)
+                write(entity);
+        }
+
+        void write(const Value &value)
+        {
+            write(static_cast<uint32_t>(value.type()));
+
+            switch (value.type()) {
+                case Value::Type::Integer: {
+                    int64_t l = value.toLong();
+                    m_stream.write(reinterpret_cast<const char *>(&l), sizeof(l));
+                    break;
+                }
+
+                case Value::Type::Double: {
+                    double d = value.toDouble();
+                    m_stream.write(reinterpret_cast<const char *>(&d), sizeof(d));
+                    break;
+                }
+
+                case Value::Type::Bool:
+                    write(static_cast<uint32_t>(value.toBool()));
+                    break;
+
+                case Value::Type::String:
+                    write(value.toString());
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+    private:
+        std::ostream &m_stream;
+};
+
+class Reader
+{
+    public:
+        Reader(std::istream &stream) :
+            m_stream(stream)
+        {
+        }
+
+        bool ok() const { return m_stream.good(); }
+
+        uint32_t readInt()
+        {
+            uint32_t value = 0;
+            m_stream.read(reinterpret_cast<char *>(&value), sizeof(value));
+            return value;
+        }
+
+        // The sizes are limited by the remaining data, so that invalid files don't allocate too much memory
+        bool readSize(size_t &size, size_t itemSize)
+        {
+            size = readInt();
+            return ok() && size <= remaining() / itemSize;
+        }
+
+        bool read(std::string &str)
+        {
+            size_t size;
+
+            if (!readSize(size, 1))
+                return false;
+
+            str.resize(size);
+            m_stream.read(str.data(), size);
+            return ok();
+        }
+
+        bool read(std::vector<unsigned int> &values)
+        {
+            size_t size;
+
+            if (!readSize(size, sizeof(unsigned int)))
+                return false;
+
+            values.resize(size);
+            m_stream.read(reinterpret_cast<char *>(values.data()), size * sizeof(unsigned int));
+            return ok();
+        }
+
+        bool read(BytecodeCache::Entity &entity)
+        {
+            entity.target = readInt();
+            entity.index = readInt();
+            return ok();
+        }
+
+        bool read(std::vector<BytecodeCache::Entity> &entities)
+        {
+            size_t size;
+
+            if (!readSize(size, 2 * sizeof(uint32_t)))
+                return false;
+
+            entities.resize(size);
+
+            for (BytecodeCache::Entity &entity : entities) {
+                if (!read(entity))
+                    return false;
+            }
+
+            return true;
+        }
+
+        bool read(Value &value)
+        {
+            switch (static_cast<Value::Type>(readInt())) {
+                case Value::Type::Integer: {
+                    int64_t l = 0;
+                    m_stream.read(reinterpret_cast<char *>(&l), sizeof(l));
+                    value = static_cast<long>(l);
+                    break;
+                }
+
+                case Value::Type::Double: {
+                    double d = 0;
+                    m_stream.read(reinterpret_cast<char *>(&d), sizeof(d));
+                    value = d;
+                    break;
+                }
+
+                case Value::Type::Bool:
+                    value = readInt() != 0;
+                    break;
+
+                case Value::Type::String: {
+                    std::string str;
+
+                    if (!read(str))
+                        return false;
+
+                    value = str;
+                    break;
+                }
+
+                case Value::Type::Infinity:
+                    value = Value(Value::SpecialValue::Infinity);
+                    break;
+
+                case Value::Type::NegativeInfinity:
+                    value = Value(Value::SpecialValue::NegativeInfinity);
+                    break;
+
+                case Value::Type::NaN:
+                    value = Value(Value::SpecialValue::NaN);
+                    break;
+
+                default:
+                    return false;
+            }
+
+            return ok();
+        }
+
+    private:
+        size_t remaining()
+        {
+            std::streampos pos = m_stream.tellg();
+            m_stream.seekg(0, std::ios::end);
+            std::streampos end = m_stream.tellg();
+            m_stream.seekg(pos);
+            return end - pos;
+        }
+
+        std::istream &m_stream;
+};
+
+} // namespace
+
+void BytecodeCache::write(std::ostream &stream) const
+{
+    Writer writer(stream);
+    stream.write(magic, sizeof(magic));
+    writer.write(version);
+    writer.write(static_cast<uint32_t>(sizeof(unsigned int)));
+    writer.write(static_cast<uint32_t>(VirtualMachinePrivate::instruction_count));
+    writer.write(key);
+    writer.write(static_cast<uint32_t>(optimizationsEnabled));
+
+    writer.write(static_cast<uint32_t>(targetCounts.size()));
+
+    for (const TargetCounts &counts : targetCounts) {
+        writer.write(counts.blocks);
+        writer.write(counts.variables);
+        writer.write(counts.lists);
+    }
+
+    writer.write(functionCount);
+    writer.write(functionScripts);
+
+    for (const Target &target : targets) {
+        writer.write(static_cast<uint32_t>(target.constValues.size()));
+
+        for (const Value &value : target.constValues)
+            writer.write(value);
+
+        writer.write(target.variables);
+        writer.write(target.lists);
+        writer.write(target.procedures);
+        writer.write(static_cast<uint32_t>(target.scripts.size()));
+
+        for (const Script &script : target.scripts) {
+            writer.write(script.block);
+            writer.write(script.bytecode);
+            writer.write(script.bytecodeBlocks);
+        }
+    }
+
+    writer.write(broadcastCount);
+    writer.write(backdropCount);
+    writer.write(static_cast<uint32_t>(hatScripts.size()));
+
+    for (const HatScript &hatScript : hatScripts) {
+        writer.write(static_cast<uint32_t>(hatScript.type));
+        writer.write(hatScript.block);
+        writer.write(hatScript.broadcast);
+        writer.write(hatScript.key);
+    }
+}
+
+// Returns false if the data is invalid or was written by an incompatible version of the library
+bool BytecodeCache::read(std::istream &stream)
+{
+    Reader reader(stream);
+    char header[sizeof(magic)];
+    stream.read(header, sizeof(header));
+
+    if (!reader.ok() || memcmp(header, magic, sizeof(magic)) != 0)
+        return false;
+
+    if (reader.readInt() != version || reader.readInt() != sizeof(unsigned int) || reader.readInt() != VirtualMachinePrivate::instruction_count)
+        return false;
+
+    if (!reader.read(key))
+        return false;
+
+    optimizationsEnabled = reader.readInt();
+    size_t size;
+
+    if (!reader.readSize(size, 3 * sizeof(uint32_t)))
+        return false;
+
+    targetCounts.resize(size);
+
+    for (TargetCounts &counts : targetCounts) {
+        counts.blocks = reader.readInt();
+        counts.variables = reader.readInt();
+        counts.lists = reader.readInt();
+    }
+
+    auto checkBlock = [this](unsigned int target, unsigned int block) { return target < targetCounts.size() && block < targetCounts[target].blocks; };
+    auto checkEntities = [this](const std::vector<Entity> &entities, bool lists) {
+        for (const Entity &entity : entities) {
+            if (entity.target >= targetCounts.size() || entity.index >= (lists ? targetCounts[entity.target].lists : targetCounts[entity.target].variables))
+                return false;
+        }
+
+        return true;
+    };
+
+    functionCount = reader.readInt();
+
+    if (!reader.read(functionScripts))
+        return false;
+
+    for (const Entity &entity : functionScripts) {
+        if (!checkBlock(entity.target, entity.index))
+            return false;
+    }
+
+    targets.resize(targetCounts.size());
+
+    for (unsigned int i = 0; i < targets.size(); i++) {
+        Target &target = targets[i];
+
+        if (!reader.readSize(size, sizeof(uint32_t)))
+            return false;
+
+        target.constValues.resize(size);
+
+        for (Value &value : target.constValues) {
+            if (!reader.read(value))
+                return false;
+        }
+
+        if (!reader.read(target.variables) || !checkEntities(target.variables, false) || !reader.read(target.lists) || !checkEntities(target.lists, true) || !reader.read(target.procedures))
+            return false;
+
+        for (unsigned int block : target.procedures) {
+            if (block != noBlock && !checkBlock(i, block))
+                return false;
+        }
+
+        if (!reader.readSize(size, 3 * sizeof(uint32_t)))
+            return false;
+
+        target.scripts.resize(size);
+
+        for (Script &script : target.scripts) {
+            script.block = reader.readInt();
+
+            if (!checkBlock(i, script.block) || !reader.read(script.bytecode) || !reader.read(script.bytecodeBlocks))
+                return false;
+
+            for (unsigned int block : script.bytecodeBlocks) {
+                if (block != noBlock && !checkBlock(i, block))
+                    return false;
+            }
+        }
+    }
+
+    broadcastCount = reader.readInt();
+    backdropCount = reader.readInt();
+
+    if (!reader.readSize(size, 5 * sizeof(uint32_t)))
+        return false;
+
+    hatScripts.resize(size);
+
+    for (HatScript &hatScript : hatScripts) {
+        hatScript.type = static_cast<HatType>(reader.readInt());
+
+        if (!reader.read(hatScript.block) || !checkBlock(hatScript.block.target, hatScript.block.index))
+            return false;
+
+        hatScript.broadcast = reader.readInt();
+
+        if (!reader.read(hatScript.key))
+            return false;
+
+        switch (hatScript.type) {
+            case HatType::Broadcast:
+                if (hatScript.broadcast >= broadcastCount)
+                    return false;
+
+                break;
+
+            case HatType::BackdropBroadcast:
+                if (hatScript.broadcast >= backdropCount)
+                    return false;
+
+                break;
+
+            case HatType::KeyPress:
+            case HatType::CloneInit:
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <scratchcpp/value.h>
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <limits>
+
+namespace libscratchcpp
+{
+
+// Serialized result of Engine::compile() (entities are stored as indexes of targets and their blocks, variables and lists)
+struct BytecodeCache
+{
+        static inline const unsigned int version = 2;
+        static inline const unsigned int noBlock = std::numeric_limits<unsigned int>::max();
+
+        struct Entity
+        {
+                unsigned int target;
+                unsigned int index;
+        };
+
+        struct TargetCounts
+        {
+                unsigned int blocks;
+                unsigned int variables;
+                unsigned int lists;
+        };
+
+        struct Script
+        {
+                unsigned int block;
+                std::vector<unsigned int> bytecode;
+                std::vector<unsigned int> bytecodeBlocks;
+        };
+
+        struct Target
+        {
+                std::vector<Value> constValues;
+                std::vector<Entity> variables;
+                std::vector<Entity> lists;
+                std::vector<unsigned int> procedures; // blocks of the procedure definitions
+                std::vector<Script> scripts;
+        };
+
+        enum class HatType
+        {
+            Broadcast = 0,
+            BackdropBroadcast = 1, // the broadcast of the backdrop (costume of the stage) with the index
+            KeyPress = 2,
+            CloneInit = 3
+        };
+
+        struct HatScript
+        {
+                HatType type;
+                Entity block;
+                unsigned int broadcast = 0;
+                std::string key;
+        };
+
+        void write(std::ostream &stream) const;
+        bool read(std::istream &stream);
+
+        std::string key;
+        bool optimizationsEnabled = true;
+        std::vector<TargetCounts> targetCounts;
+        unsigned int functionCount = 0;
+        std::vector<Entity> functionScripts; // scripts which added new block functions (in order of compilation)
+        std::vector<Target> targets;
+        unsigned int broadcastCount = 0;
+        unsigned int backdropCount = 0;
+        std::vector<HatScript> hatScripts;
+};
+
+} // namespace libscratchcpp
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/virtualmachine.h>
+#include <algorithm>
+
+#include "bytecodeverifier.h"
+#include "../virtualmachine_p.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+BytecodeVerifier::BytecodeVerifier(const std::vector<unsigned int> &bytecode) :
+    m_bytecode(bytecode)
+{
+}
+
+void BytecodeVerifier::setConstValueCount(size_t count)
+{
+    m_constValueCount = count;
+}
+
+void BytecodeVerifier::setVariableCount(size_t count)
+{
+    m_variableCount = count;
+}
+
+void BytecodeVerifier::setListCount(size_t count)
+{
+    m_listCount = count;
+}
+
+void BytecodeVerifier::setFunctionCount(size_t count)
+{
+    m_functionCount = count;
+}
+
+void BytecodeVerifier::setProcedureCount(size_t count)
+{
+    m_procedureCount = count;
+}
+
+bool BytecodeVerifier::verify()
+{
+    m_error.clear();
+    m_errorPos = 0;
+    m_maxRegCount = 0;
+
+    if (m_bytecode.empty() || m_bytecode[0] != OP_START)
+        return fail(0, "the bytecode doesn't start with OP_START");
+
+    // Functions called by OP_EXEC can free any number of registers and add a return value,
+    // so only the range of the number of used registers is known
+    size_t minRegCount = 0;
+    size_t maxRegCount = 0;
+    std::vector<Statement> statements; // if statements and loops which haven't ended yet
+    size_t pos = 1;
+
+    while (pos < m_bytecode.size()) {
+        unsigned int opcode = m_bytecode[pos];
+
+        if (opcode == OP_START || opcode >= VirtualMachinePrivate::instruction_count)
+            return fail(pos, "invalid opcode " + std::to_string(opcode));
+
+        size_t argCount = VirtualMachinePrivate::instruction_arg_count[opcode];
+
+        if (pos + argCount >= m_bytecode.size())
+            return fail(pos, "missing instruction arguments");
+
+        const unsigned int *args = m_bytecode.data() + pos + 1;
+
+        // Check the indexes of constant values, variables, lists, etc.
+        bool argsValid = true;
+
+        switch (opcode) {
+            case OP_CONST:
+                argsValid = checkArg(pos, args[0], m_constValueCount, "constant value");
+                break;
+
+            case OP_SET_VAR:
+            case OP_CHANGE_VAR:
+            case OP_READ_VAR:
+            case OP_EQUALS_VAR:
+            case OP_GREATER_THAN_VAR:
+            case OP_LESS_THAN_VAR:
+            case OP_STR_CONCAT_VAR:
+            case OP_VAR_APPEND_STR:
+                argsValid = checkArg(pos, args[0], m_variableCount, "variable");
+                break;
+
+            case OP_READ_LIST:
+            case OP_LIST_APPEND:
+            case OP_LIST_DEL:
+            case OP_LIST_DEL_ALL:
+            case OP_LIST_INSERT:
+            case OP_LIST_REPLACE:
+            case OP_LIST_GET_ITEM:
+            case OP_LIST_INDEX_OF:
+            case OP_LIST_LENGTH:
+            case OP_LIST_CONTAINS:
+                argsValid = checkArg(pos, args[0], m_listCount, "list");
+                break;
+
+            case OP_EXEC:
+                argsValid = checkArg(pos, args[0], m_functionCount, "function");
+                break;
+
+            case OP_CALL_PROCEDURE:
+            case OP_TAIL_CALL:
+                argsValid = checkArg(pos, args[0], m_procedureCount, "procedure");
+                break;
+
+            case OP_CHANGE_VAR_CONST:
+            case OP_IF_VAR_EQ_CONST:
+                argsValid = checkArg(pos, args[0], m_variableCount, "variable") && checkArg(pos, args[1], m_constValueCount, "constant value");
+                break;
+
+            case OP_LIST_GET_VAR_INDEX:
+                argsValid = checkArg(pos, args[0], m_listCount, "list") && checkArg(pos, args[1], m_variableCount, "variable");
+                break;
+
+            default:
+                break;
+        }
+
+        if (!argsValid)
+            return false;
+
+        // Update the number of used registers
+        size_t inputCount = VirtualMachinePrivate::instruction_input_count[opcode];
+
+        if (maxRegCount < inputCount)
+            return fail(pos, "the instruction reads " + std::to_string(inputCount) + " registers, but only " + std::to_string(maxRegCount) + " are used");
+
+        if (opcode == OP_EXEC) {
+            minRegCount = 0;
+            maxRegCount++;
+        } else {
+            int regEffect = VirtualMachinePrivate::instruction_reg_effect[opcode];
+            minRegCount = std::max(minRegCount, inputCount) + regEffect;
+            maxRegCount += regEffect;
+        }
+
+        m_maxRegCount = std::max(m_maxRegCount, maxRegCount);
+
+        // Check the structure of if statements and loops
+        switch (opcode) {
+            case OP_IF:
+            case OP_IF_VAR_EQ_CONST:
+            case OP_FOREVER_LOOP:
+            case OP_REPEAT_LOOP:
+            case OP_UNTIL_LOOP:
+                statements.push_back({ pos, false, false });
+                break;
+
+            case OP_ELSE: {
+                if (statements.empty() || (m_bytecode[statements.back().pos] != OP_IF && m_bytecode[statements.back().pos] != OP_IF_VAR_EQ_CONST) || statements.back().hasElse)
+                    return fail(pos, "OP_ELSE without an if statement");
+
+                Statement &statement = statements.back();
+
+                if (!checkJump(statement.pos, pos + 2))
+                    return false;
+
+                statement.pos = pos;
+                statement.hasElse = true;
+                break;
+            }
+
+            case OP_ENDIF: {
+                if (statements.empty() || (m_bytecode[statements.back().pos] != OP_IF && m_bytecode[statements.back().pos] != OP_IF_VAR_EQ_CONST && m_bytecode[statements.back().pos] != OP_ELSE))
+                    return fail(pos, "OP_ENDIF without an if statement");
+
+                if (!checkJump(statements.back().pos, pos + 1))
+                    return false;
+
+                statements.pop_back();
+                break;
+            }
+
+            case OP_BEGIN_UNTIL_LOOP:
+                if (statements.empty() || m_bytecode[statements.back().pos] != OP_UNTIL_LOOP || statements.back().hasCondition)
+                    return fail(pos, "OP_BEGIN_UNTIL_LOOP without OP_UNTIL_LOOP");
+
+                statements.back().hasCondition = true;
+                break;
+
+            case OP_LOOP_END: {
+                if (statements.empty())
+                    return fail(pos, "OP_LOOP_END without a loop");
+
+                const Statement &statement = statements.back();
+                unsigned int loopOpcode = m_bytecode[statement.pos];
+
+                if (loopOpcode != OP_FOREVER_LOOP && loopOpcode != OP_REPEAT_LOOP && (loopOpcode != OP_UNTIL_LOOP || !statement.hasCondition))
+                    return fail(pos, "OP_LOOP_END without a loop");
+
+                if (loopOpcode != OP_FOREVER_LOOP && !checkJump(statement.pos, pos + 1))
+                    return false;
+
+                statements.pop_back();
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        // These instructions are only used between stack blocks, where all registers must be free
+        switch (opcode) {
+            case OP_HALT:
+            case OP_IF:
+            case OP_IF_VAR_EQ_CONST:
+            case OP_ELSE:
+            case OP_ENDIF:
+            case OP_FOREVER_LOOP:
+            case OP_REPEAT_LOOP:
+            case OP_UNTIL_LOOP:
+            case OP_BEGIN_UNTIL_LOOP:
+            case OP_LOOP_END:
+            case OP_INIT_PROCEDURE:
+            case OP_CALL_PROCEDURE:
+            case OP_TAIL_CALL:
+            case OP_FREE_INLINE_ARGS:
+                if (minRegCount > 0)
+                    return fail(pos, std::to_string(minRegCount) + " registers were leaked");
+
+                minRegCount = 0;
+                maxRegCount = 0;
+                break;
+
+            default:
+                break;
+        }
+
+        // OP_HALT can be also used to stop the script, so only the last one ends the bytecode
+        if (opcode == OP_HALT && pos + 1 == m_bytecode.size()) {
+            if (!statements.empty())
+                return fail(statements.back().pos, "the if statement or loop doesn't have an end");
+
+            return true;
+        }
+
+        pos += argCount + 1;
+    }
+
+    return fail(m_bytecode.size(), "the bytecode doesn't end with OP_HALT");
+}
+
+const std::string &BytecodeVerifier::error() const
+{
+    return m_error;
+}
+
+size_t BytecodeVerifier::errorPos() const
+{
+    return m_errorPos;
+}
+
+size_t BytecodeVerifier::maxRegisterCount() const
+{
+    return m_maxRegCount;
+}
+
+bool BytecodeVerifier::fail(size_t pos, const std::string &error)
+{
+    m_error = error;
+    m_errorPos = pos;
+    return false;
+}
+
+bool BytecodeVerifier::checkArg(size_t pos, unsigned int arg, size_t count, const char *name)
+{
+    if (arg < count)
+        return true;
+
+    return fail(pos, std::string("invalid ") + name + " index " + std::to_string(arg));
+}
+
+bool BytecodeVerifier::checkJump(size_t pos, size_t target)
+{
+    // The last argument is the number of words between the argument and the target
+    size_t arg = pos + VirtualMachinePrivate::instruction_arg_count[m_bytecode[pos]];
+
+    if (arg + m_bytecode[arg] + 1 == target)
+        return true;
+
+    return fail(pos, "invalid jump offset " + std::to_string(m_bytecode[arg]));
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <cstddef>
+
+namespace libscratchcpp
+{
+
+class BytecodeVerifier
+{
+    public:
+        BytecodeVerifier(const std::vector<unsigned int> &bytecode);
+        BytecodeVerifier(std::vector<unsigned int> &&) = delete;
+        BytecodeVerifier(const BytecodeVerifier &) = delete;
+
+        void setConstValueCount(size_t count);
+        void setVariableCount(size_t count);
+        void setListCount(size_t count);
+        void setFunctionCount(size_t count);
+        void setProcedureCount(size_t count);
+
+        bool verify();
+
+        const std::string &error() const;
+        size_t errorPos() const;
+        size_t maxRegisterCount() const;
+
+    private:
+        struct Statement
+        {
+                size_t pos;
+                bool hasElse;
+                bool hasCondition;
+        };
+
+        bool fail(size_t pos, const std::string &error);
+        bool checkArg(size_t pos, unsigned int arg, size_t count, const char *name);
+        bool checkJump(size_t pos, size_t target);
+
+        const std::vector<unsigned int> &m_bytecode;
+        size_t m_constValueCount = std::numeric_limits<size_t>::max();
+        size_t m_variableCount = std::numeric_limits<size_t>::max();
+        size_t m_listCount = std::numeric_limits<size_t>::max();
+        size_t m_functionCount = std::numeric_limits<size_t>::max();
+        size_t m_procedureCount = std::numeric_limits<size_t>::max();
+
+        std::string m_error;
+        size_t m_errorPos = 0;
+        size_t m_maxRegCount = 0;
+};
+
+} // namespace libscratchcpp
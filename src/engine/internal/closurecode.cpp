@@ -0,0 +1,1090 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/list.h>
+#include <iostream>
+#include <cassert>
+
+#include "closurecode.h"
+#include "../virtualmachine_p.h"
+
+#define FREE_REGS(count) vm->regCount -= count
+#define ADD_RET_VALUE(value) vm->regs[vm->regCount++] = value
+#define REPLACE_RET_VALUE(value, offset) vm->regs[vm->regCount - offset] = value
+#define READ_REG(index, count) (vm->regs + vm->regCount - count + index)
+#define READ_LAST_REG() (vm->regs + vm->regCount - 1)
+
+using namespace libscratchcpp;
+using namespace vm;
+
+// Leaves the closure code, the script continues at the instruction after pos when it runs again
+static const ClosureInstruction *leave(VirtualMachinePrivate *vm, unsigned int *pos)
+{
+    vm->closureExitPos = pos;
+    return nullptr;
+}
+
+// Leaves the closure code, the bytecode interpreter continues at the instruction after pos
+static const ClosureInstruction *fallback(VirtualMachinePrivate *vm, unsigned int *pos)
+{
+    vm->closureExitPos = pos;
+    vm->closureFallback = true;
+    return nullptr;
+}
+
+// Continues at the instruction after pos
+static const ClosureInstruction *jump(VirtualMachinePrivate *vm, unsigned int *pos)
+{
+    const ClosureInstruction *instruction = vm->closureCode->instructionAt(pos + 1);
+    return instruction ? instruction : fallback(vm, pos);
+}
+
+static const ClosureInstruction *do_fallback(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    return fallback(vm, instruction->pos - 1);
+}
+
+static const ClosureInstruction *do_halt(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    // Procedures run in the bytecode interpreter
+    assert(vm->callTree.empty());
+    vm->atEnd = true;
+    vm->procedureArgCount = 0;
+    vm->procedureArgBase = 0;
+    return leave(vm, instruction->pos);
+}
+
+static const ClosureInstruction *do_const(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(*instruction->value);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_null(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(Value());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_checkpoint(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    vm->checkpoint = instruction->pos - 1;
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_if(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    bool condition = READ_LAST_REG()->toBool();
+    FREE_REGS(1);
+    return condition ? instruction + 1 : instruction->target;
+}
+
+static const ClosureInstruction *do_else(VirtualMachinePrivate *, const ClosureInstruction *instruction)
+{
+    return instruction->target;
+}
+
+static const ClosureInstruction *do_nop(VirtualMachinePrivate *, const ClosureInstruction *instruction)
+{
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_forever_loop(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::Loop l;
+    l.isRepeatLoop = true;
+    l.start = instruction->pos;
+    l.index = -1;
+    vm->loops.push_back(l);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_repeat_loop(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    size_t loopCount = READ_LAST_REG()->toLong();
+    FREE_REGS(1);
+
+    if (loopCount <= 0)
+        return instruction->target;
+
+    VirtualMachinePrivate::Loop l;
+    l.isRepeatLoop = true;
+    l.start = instruction->pos + 1;
+    l.index = 0;
+    l.max = loopCount;
+    vm->loops.push_back(l);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_repeat_loop_index(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    assert(!vm->loops.empty());
+    assert(vm->loops.back().isRepeatLoop);
+    ADD_RET_VALUE(static_cast<long>(vm->loops.back().index));
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_repeat_loop_index1(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    assert(!vm->loops.empty());
+    assert(vm->loops.back().isRepeatLoop);
+    ADD_RET_VALUE(static_cast<long>(vm->loops.back().index + 1));
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_until_loop(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::Loop l;
+    l.isRepeatLoop = false;
+    l.start = instruction->pos + 1;
+    vm->loops.push_back(l);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_begin_until_loop(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    bool condition = READ_LAST_REG()->toBool();
+    FREE_REGS(1);
+
+    if (condition) {
+        vm->loops.pop_back();
+        return instruction->target;
+    }
+
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_loop_end(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::Loop &l = vm->loops.back();
+    unsigned int *pos = l.start;
+    const ClosureInstruction *next = instruction->target;
+
+    if (l.isRepeatLoop && (l.index != static_cast<size_t>(-1)) && (++l.index >= l.max)) {
+        vm->loops.pop_back();
+        pos = instruction->pos;
+        next = instruction + 1;
+    }
+
+    if (!vm->noBreak && !vm->warp)
+        return leave(vm, pos);
+
+    return next;
+}
+
+static const ClosureInstruction *do_print(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    std::cout << READ_LAST_REG()->toString() << std::endl;
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_add(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    READ_REG(0, 2)->add(*READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_subtract(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    READ_REG(0, 2)->subtract(*READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_multiply(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    READ_REG(0, 2)->multiply(*READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_divide(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    READ_REG(0, 2)->divide(*READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_mod(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    READ_REG(0, 2)->mod(*READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_random(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::randomNumber(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_round(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::roundNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_abs(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::absNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_floor(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::floorNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_ceil(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::ceilNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_sqrt(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::sqrtNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_sin(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::sinNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_cos(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::cosNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_tan(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::tanNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_asin(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::asinNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_acos(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::acosNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_atan(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::atanNumber(READ_LAST_REG());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_greater_than(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(*READ_REG(0, 2) > *READ_REG(1, 2), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_less_than(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(*READ_REG(0, 2) < *READ_REG(1, 2), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_equals(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(*READ_REG(0, 2) == *READ_REG(1, 2), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_and(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(READ_REG(0, 2)->toBool() && READ_REG(1, 2)->toBool(), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_or(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(READ_REG(0, 2)->toBool() || READ_REG(1, 2)->toBool(), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_not(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(!READ_LAST_REG()->toBool(), 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_set_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    *instruction->var = *READ_LAST_REG();
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_change_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    instruction->var->add(*READ_LAST_REG());
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_read_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(*instruction->var);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_read_list(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(instruction->list->toString());
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_append(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    instruction->list->push_back(*READ_LAST_REG());
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_del(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::deleteListItem(instruction->list, READ_LAST_REG());
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_del_all(VirtualMachinePrivate *, const ClosureInstruction *instruction)
+{
+    instruction->list->clear();
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_insert(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::insertListItem(instruction->list, READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(2);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_replace(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::replaceListItem(instruction->list, READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(2);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_get_item(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    List *list = instruction->list;
+    size_t index = VirtualMachinePrivate::getListIndex(READ_LAST_REG(), list);
+
+    if (index == 0) {
+        REPLACE_RET_VALUE("", 1);
+    } else {
+        REPLACE_RET_VALUE(list->operator[](index - 1), 1);
+    }
+
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_index_of(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(static_cast<long>(instruction->list->indexOf(*READ_LAST_REG()) + 1), 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_length(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(static_cast<long>(instruction->list->size()));
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_list_contains(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(instruction->list->contains(*READ_LAST_REG()), 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_str_concat(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(READ_REG(0, 2)->toString() + READ_REG(1, 2)->toString(), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_str_at(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    size_t index = READ_REG(1, 2)->toLong() - 1;
+    REPLACE_RET_VALUE(READ_REG(0, 2)->utf16At(index), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_str_length(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(static_cast<long>(READ_LAST_REG()->utf16Size()), 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_str_contains(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(READ_REG(0, 2)->toString().find(READ_REG(1, 2)->toString()) != std::string::npos, 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_exec(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    // The position is tracked in the bytecode, so that the script can continue in the bytecode interpreter
+    unsigned int *pos = instruction->pos + 1;
+    const ClosureInstruction *next = instruction + 1;
+    auto ret = instruction->function(vm->vm);
+
+    if (vm->updatePos) {
+        pos = vm->pos;
+        next = nullptr;
+        vm->updatePos = false;
+    }
+
+    if (vm->stop) {
+        vm->stop = false;
+        vm->callTree.clear();
+
+        if (vm->goBack) {
+            vm->goBack = false;
+            pos -= VirtualMachinePrivate::instruction_arg_count[OP_EXEC] + 1;
+            next = nullptr;
+        } else
+            FREE_REGS(ret);
+
+        if (!vm->warp)
+            return leave(vm, pos);
+
+        return next ? next : jump(vm, pos);
+    }
+
+    FREE_REGS(ret);
+    return next ? next : jump(vm, pos);
+}
+
+static const ClosureInstruction *do_init_procedure(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    vm->nextProcedureArgBase = vm->procedureArgCount;
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_add_arg(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    if (vm->procedureArgCount < vm->procedureArgs.size())
+        vm->procedureArgs[vm->procedureArgCount] = *READ_LAST_REG();
+    else
+        vm->procedureArgs.push_back(*READ_LAST_REG());
+
+    vm->procedureArgCount++;
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_read_arg(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(vm->procedureArgs[vm->procedureArgBase + instruction->pos[1]]);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_break_frame(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    vm->noBreak = false;
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_warp(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    vm->warp = true;
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_change_var_const(VirtualMachinePrivate *, const ClosureInstruction *instruction)
+{
+    instruction->var->add(*instruction->value);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_if_var_eq_const(VirtualMachinePrivate *, const ClosureInstruction *instruction)
+{
+    return (*instruction->var == *instruction->value) ? instruction + 1 : instruction->target;
+}
+
+static const ClosureInstruction *do_list_get_var_index(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    List *list = instruction->list;
+    size_t index = VirtualMachinePrivate::getListIndex(instruction->var, list);
+
+    if (index == 0) {
+        ADD_RET_VALUE("");
+    } else {
+        ADD_RET_VALUE(list->operator[](index - 1));
+    }
+
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_read_inline_arg(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    ADD_RET_VALUE(vm->procedureArgs[vm->procedureArgCount - instruction->pos[1]]);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_free_inline_args(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    vm->procedureArgCount -= instruction->pos[1];
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_add_num(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::addNumbers(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_subtract_num(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::subtractNumbers(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_multiply_num(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    VirtualMachinePrivate::multiplyNumbers(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_greater_than_num(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(VirtualMachinePrivate::numberGreaterThan(READ_REG(0, 2), READ_REG(1, 2)), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_less_than_num(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(VirtualMachinePrivate::numberLessThan(READ_REG(0, 2), READ_REG(1, 2)), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_equals_num(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(VirtualMachinePrivate::numbersEqual(READ_REG(0, 2), READ_REG(1, 2)), 2);
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_equals_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(*READ_LAST_REG() == *instruction->var, 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_greater_than_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(*READ_LAST_REG() > *instruction->var, 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_less_than_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(*READ_LAST_REG() < *instruction->var, 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_str_concat_var(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    REPLACE_RET_VALUE(READ_LAST_REG()->toString() + instruction->var->toString(), 1);
+    return instruction + 1;
+}
+
+static const ClosureInstruction *do_var_append_str(VirtualMachinePrivate *vm, const ClosureInstruction *instruction)
+{
+    instruction->var->append(*READ_LAST_REG());
+    FREE_REGS(1);
+    return instruction + 1;
+}
+
+ClosureCode::ClosureCode(VirtualMachinePrivate *vm) :
+    m_bytecode(vm->bytecode)
+{
+    assert(m_bytecode);
+    compile(vm);
+}
+
+const ClosureInstruction *ClosureCode::instructionAt(const unsigned int *pos) const
+{
+    size_t index = pos - m_bytecode;
+    return (pos >= m_bytecode && index < m_instructionMap.size()) ? m_instructionMap[index] : nullptr;
+}
+
+unsigned int *ClosureCode::run(VirtualMachinePrivate *vm, const ClosureInstruction *instruction) const
+{
+    while ((instruction = instruction->handler(vm, instruction)))
+        ;
+
+    if (vm->closureFallback) {
+        vm->closureFallback = false;
+        return vm->run(vm->closureExitPos);
+    }
+
+    return vm->closureExitPos;
+}
+
+void ClosureCode::compile(VirtualMachinePrivate *vm)
+{
+    // Find the instructions (the script ends with the first OP_HALT outside of if statements and loops)
+    std::vector<unsigned int *> positions;
+    unsigned int *pos = m_bytecode;
+    size_t depth = 0;
+
+    while (true) {
+        unsigned int opcode = *pos;
+        assert(opcode < VirtualMachinePrivate::instruction_count);
+        positions.push_back(pos);
+
+        if (opcode == OP_HALT && depth == 0)
+            break;
+
+        switch (opcode) {
+            case OP_IF:
+            case OP_IF_VAR_EQ_CONST:
+            case OP_FOREVER_LOOP:
+            case OP_REPEAT_LOOP:
+            case OP_UNTIL_LOOP:
+                depth++;
+                break;
+
+            case OP_ENDIF:
+            case OP_LOOP_END:
+                depth--;
+                break;
+
+            default:
+                break;
+        }
+
+        pos += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+
+    m_instructions.resize(positions.size());
+    m_instructionMap.assign(positions.back() - m_bytecode + 1, nullptr);
+
+    for (size_t i = 0; i < positions.size(); i++)
+        m_instructionMap[positions[i] - m_bytecode] = &m_instructions[i];
+
+    // Bind the handlers and operands
+    std::vector<ClosureInstruction *> loops; // loop instructions of the current loops
+    bool hasVariables = vm->variables;
+    bool hasLists = vm->lists;
+    bool hasConstValues = vm->constValues;
+    bool hasFunctions = vm->functions;
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        ClosureInstruction &instruction = m_instructions[i];
+        pos = positions[i];
+        instruction.pos = pos;
+        instruction.handler = &do_fallback;
+        unsigned int opcode = *pos;
+        unsigned int *arg = pos + 1;
+        unsigned int *lastArg = pos + VirtualMachinePrivate::instruction_arg_count[opcode];
+
+        // OP_IF, OP_ELSE, OP_IF_VAR_EQ_CONST and OP_REPEAT_LOOP jump after the last argument plus the offset in the last argument
+        auto jumpTarget = [this, lastArg]() { return instructionAt(lastArg + *lastArg + 1); };
+        bool jumps = false;
+
+        switch (opcode) {
+            case OP_HALT:
+                instruction.handler = &do_halt;
+                break;
+
+            case OP_CONST:
+                if (hasConstValues) {
+                    instruction.handler = &do_const;
+                    instruction.value = &vm->constValues[*arg];
+                }
+                break;
+
+            case OP_NULL:
+                instruction.handler = &do_null;
+                break;
+
+            case OP_CHECKPOINT:
+                instruction.handler = &do_checkpoint;
+                break;
+
+            case OP_IF:
+                jumps = true;
+                instruction.handler = &do_if;
+                instruction.target = jumpTarget();
+                break;
+
+            case OP_ELSE:
+                jumps = true;
+                instruction.handler = &do_else;
+                instruction.target = jumpTarget();
+                break;
+
+            case OP_ENDIF:
+                instruction.handler = &do_nop;
+                break;
+
+            case OP_FOREVER_LOOP:
+                instruction.handler = &do_forever_loop;
+                loops.push_back(&instruction);
+                break;
+
+            case OP_REPEAT_LOOP:
+                jumps = true;
+                instruction.handler = &do_repeat_loop;
+                instruction.target = jumpTarget();
+                loops.push_back(&instruction);
+                break;
+
+            case OP_REPEAT_LOOP_INDEX:
+                instruction.handler = &do_repeat_loop_index;
+                break;
+
+            case OP_REPEAT_LOOP_INDEX1:
+                instruction.handler = &do_repeat_loop_index1;
+                break;
+
+            case OP_UNTIL_LOOP:
+                jumps = true;
+                instruction.handler = &do_until_loop;
+                instruction.target = jumpTarget();
+                loops.push_back(&instruction);
+                break;
+
+            case OP_BEGIN_UNTIL_LOOP:
+                jumps = true;
+                assert(!loops.empty());
+                instruction.handler = &do_begin_until_loop;
+                instruction.target = loops.back()->target;
+                break;
+
+            case OP_LOOP_END:
+                // Loops continue after the loop instruction
+                assert(!loops.empty());
+                instruction.handler = &do_loop_end;
+                instruction.target = loops.back() + 1;
+                loops.pop_back();
+                break;
+
+            case OP_PRINT:
+                instruction.handler = &do_print;
+                break;
+
+            case OP_ADD:
+                instruction.handler = &do_add;
+                break;
+
+            case OP_SUBTRACT:
+                instruction.handler = &do_subtract;
+                break;
+
+            case OP_MULTIPLY:
+                instruction.handler = &do_multiply;
+                break;
+
+            case OP_DIVIDE:
+                instruction.handler = &do_divide;
+                break;
+
+            case OP_MOD:
+                instruction.handler = &do_mod;
+                break;
+
+            case OP_RANDOM:
+                instruction.handler = &do_random;
+                break;
+
+            case OP_ROUND:
+                instruction.handler = &do_round;
+                break;
+
+            case OP_ABS:
+                instruction.handler = &do_abs;
+                break;
+
+            case OP_FLOOR:
+                instruction.handler = &do_floor;
+                break;
+
+            case OP_CEIL:
+                instruction.handler = &do_ceil;
+                break;
+
+            case OP_SQRT:
+                instruction.handler = &do_sqrt;
+                break;
+
+            case OP_SIN:
+                instruction.handler = &do_sin;
+                break;
+
+            case OP_COS:
+                instruction.handler = &do_cos;
+                break;
+
+            case OP_TAN:
+                instruction.handler = &do_tan;
+                break;
+
+            case OP_ASIN:
+                instruction.handler = &do_asin;
+                break;
+
+            case OP_ACOS:
+                instruction.handler = &do_acos;
+                break;
+
+            case OP_ATAN:
+                instruction.handler = &do_atan;
+                break;
+
+            case OP_GREATER_THAN:
+                instruction.handler = &do_greater_than;
+                break;
+
+            case OP_LESS_THAN:
+                instruction.handler = &do_less_than;
+                break;
+
+            case OP_EQUALS:
+                instruction.handler = &do_equals;
+                break;
+
+            case OP_AND:
+                instruction.handler = &do_and;
+                break;
+
+            case OP_OR:
+                instruction.handler = &do_or;
+                break;
+
+            case OP_NOT:
+                instruction.handler = &do_not;
+                break;
+
+            case OP_SET_VAR:
+            case OP_CHANGE_VAR:
+            case OP_READ_VAR:
+                if (hasVariables) {
+                    instruction.handler = opcode == OP_SET_VAR ? &do_set_var : (opcode == OP_CHANGE_VAR ? &do_change_var : &do_read_var);
+                    instruction.var = vm->variables[*arg];
+                }
+                break;
+
+            case OP_READ_LIST:
+            case OP_LIST_APPEND:
+            case OP_LIST_DEL:
+            case OP_LIST_DEL_ALL:
+            case OP_LIST_INSERT:
+            case OP_LIST_REPLACE:
+            case OP_LIST_GET_ITEM:
+            case OP_LIST_INDEX_OF:
+            case OP_LIST_LENGTH:
+            case OP_LIST_CONTAINS:
+                if (hasLists) {
+                    switch (opcode) {
+                        case OP_READ_LIST:
+                            instruction.handler = &do_read_list;
+                            break;
+                        case OP_LIST_APPEND:
+                            instruction.handler = &do_list_append;
+                            break;
+                        case OP_LIST_DEL:
+                            instruction.handler = &do_list_del;
+                            break;
+                        case OP_LIST_DEL_ALL:
+                            instruction.handler = &do_list_del_all;
+                            break;
+                        case OP_LIST_INSERT:
+                            instruction.handler = &do_list_insert;
+                            break;
+                        case OP_LIST_REPLACE:
+                            instruction.handler = &do_list_replace;
+                            break;
+                        case OP_LIST_GET_ITEM:
+                            instruction.handler = &do_list_get_item;
+                            break;
+                        case OP_LIST_INDEX_OF:
+                            instruction.handler = &do_list_index_of;
+                            break;
+                        case OP_LIST_LENGTH:
+                            instruction.handler = &do_list_length;
+                            break;
+                        default:
+                            instruction.handler = &do_list_contains;
+                            break;
+                    }
+
+                    instruction.list = vm->lists[*arg];
+                }
+                break;
+
+            case OP_STR_CONCAT:
+                instruction.handler = &do_str_concat;
+                break;
+
+            case OP_STR_AT:
+                instruction.handler = &do_str_at;
+                break;
+
+            case OP_STR_LENGTH:
+                instruction.handler = &do_str_length;
+                break;
+
+            case OP_STR_CONTAINS:
+                instruction.handler = &do_str_contains;
+                break;
+
+            case OP_EXEC:
+                if (hasFunctions) {
+                    instruction.handler = &do_exec;
+                    instruction.function = vm->functions[*arg];
+                }
+                break;
+
+            case OP_INIT_PROCEDURE:
+                instruction.handler = &do_init_procedure;
+                break;
+
+            case OP_ADD_ARG:
+                instruction.handler = &do_add_arg;
+                break;
+
+            case OP_READ_ARG:
+                instruction.handler = &do_read_arg;
+                break;
+
+            case OP_BREAK_FRAME:
+                instruction.handler = &do_break_frame;
+                break;
+
+            case OP_WARP:
+                instruction.handler = &do_warp;
+                break;
+
+            case OP_CHANGE_VAR_CONST:
+                if (hasVariables && hasConstValues) {
+                    instruction.handler = &do_change_var_const;
+                    instruction.var = vm->variables[arg[0]];
+                    instruction.value = &vm->constValues[arg[1]];
+                }
+                break;
+
+            case OP_IF_VAR_EQ_CONST:
+                jumps = true;
+                // The jump target is needed even if the operands can't be bound
+                instruction.target = jumpTarget();
+
+                if (hasVariables && hasConstValues) {
+                    instruction.handler = &do_if_var_eq_const;
+                    instruction.var = vm->variables[arg[0]];
+                    instruction.value = &vm->constValues[arg[1]];
+                }
+                break;
+
+            case OP_LIST_GET_VAR_INDEX:
+                if (hasVariables && hasLists) {
+                    instruction.handler = &do_list_get_var_index;
+                    instruction.list = vm->lists[arg[0]];
+                    instruction.var = vm->variables[arg[1]];
+                }
+                break;
+
+            case OP_READ_INLINE_ARG:
+                instruction.handler = &do_read_inline_arg;
+                break;
+
+            case OP_FREE_INLINE_ARGS:
+                instruction.handler = &do_free_inline_args;
+                break;
+
+            case OP_ADD_NUM:
+                instruction.handler = &do_add_num;
+                break;
+
+            case OP_SUBTRACT_NUM:
+                instruction.handler = &do_subtract_num;
+                break;
+
+            case OP_MULTIPLY_NUM:
+                instruction.handler = &do_multiply_num;
+                break;
+
+            case OP_GREATER_THAN_NUM:
+                instruction.handler = &do_greater_than_num;
+                break;
+
+            case OP_LESS_THAN_NUM:
+                instruction.handler = &do_less_than_num;
+                break;
+
+            case OP_EQUALS_NUM:
+                instruction.handler = &do_equals_num;
+                break;
+
+            case OP_EQUALS_VAR:
+            case OP_GREATER_THAN_VAR:
+            case OP_LESS_THAN_VAR:
+            case OP_STR_CONCAT_VAR:
+            case OP_VAR_APPEND_STR:
+                if (hasVariables) {
+                    switch (opcode) {
+                        case OP_EQUALS_VAR:
+                            instruction.handler = &do_equals_var;
+                            break;
+                        case OP_GREATER_THAN_VAR:
+                            instruction.handler = &do_greater_than_var;
+                            break;
+                        case OP_LESS_THAN_VAR:
+                            instruction.handler = &do_less_than_var;
+                            break;
+                        case OP_STR_CONCAT_VAR:
+                            instruction.handler = &do_str_concat_var;
+                            break;
+                        default:
+                            instruction.handler = &do_var_append_str;
+                            break;
+                    }
+
+                    instruction.var = vm->variables[*arg];
+                }
+                break;
+
+            default:
+                // Procedure calls (OP_CALL_PROCEDURE and OP_TAIL_CALL) run in the bytecode interpreter
+                break;
+        }
+
+        // Invalid jumps are left for the bytecode interpreter
+        if (jumps && !instruction.target)
+            instruction.handler = &do_fallback;
+    }
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <vector>
+#include <scratchcpp/value.h>
+
+namespace libscratchcpp
+{
+
+struct VirtualMachinePrivate;
+class List;
+struct ClosureInstruction;
+
+using ClosureHandler = const ClosureInstruction *(*)(VirtualMachinePrivate *vm, const ClosureInstruction *instruction);
+
+struct ClosureInstruction
+{
+        ClosureHandler handler = nullptr;
+        unsigned int *pos = nullptr; // the opcode in the bytecode
+        Value *var = nullptr;
+        List *list = nullptr;
+        const Value *value = nullptr;
+        BlockFunc function = nullptr;
+        const ClosureInstruction *target = nullptr; // jump target
+};
+
+class ClosureCode
+{
+    public:
+        ClosureCode(VirtualMachinePrivate *vm);
+        ClosureCode(const ClosureCode &) = delete;
+
+        const ClosureInstruction *instructionAt(const unsigned int *pos) const;
+
+        unsigned int *run(VirtualMachinePrivate *vm, const ClosureInstruction *instruction) const;
+
+    private:
+        void compile(VirtualMachinePrivate *vm);
+
+        unsigned int *m_bytecode = nullptr;
+        std::vector<ClosureInstruction> m_instructions;
+        std::vector<const ClosureInstruction *> m_instructionMap; // instruction at each word of the bytecode
+};
+
+} // namespace libscratchcpp
@@ -15,13 +15,20 @@
 #include <scratchcpp/list.h>
 #include <scratchcpp/costume.h>
 #include <scratchcpp/keyevent.h>
+#include <scratchcpp/disassembler.h>
+#include <scratchcpp/virtualmachine.h>
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
 #include "engine.h"
 #include "blocksectioncontainer.h"
+#include "bytecodeverifier.h"
+#include "procedureinliner.h"
 #include "timer.h"
 #include "clock.h"
+#include "tracespan.h"
+#include "bytecodecache.h"
 #include "../../blocks/standardblocks.h"
 
 using namespace libscratchcpp;
@@ -29,6 +36,8 @@ using namespace libscratchcpp;
 Engine::Engine() :
     m_defaultTimer(std::make_unique<Timer>()),
     m_timer(m_defaultTimer.get()),
+    m_profiler(std::make_unique<Profiler>()),
+    m_tracer(std::make_unique<Tracer>()),
     m_clock(Clock::instance().get())
 {
 }
@@ -46,6 +55,8 @@ void Engine::clear()
     m_broadcasts.clear();
     removeExecutableClones();
     m_clones.clear();
+    m_functionScripts.clear();
+    m_profiler->reset(); // the samples refer to the blocks
 
     m_running = false;
 }
@@ -93,11 +104,21 @@ void Engine::compile()
     // Resolve entities by ID
     resolveIds();
 
+    // The function indexes are assigned again, so that the scripts which add them can be recorded for the bytecode cache
+    m_functions.clear();
+    m_functionIndexes.clear();
+    m_functionScripts.clear();
+
     // Compile scripts to bytecode
     for (auto target : m_targets) {
         std::cout << "Compiling scripts in target " << target->name() << "..." << std::endl;
-        std::unordered_map<std::string, unsigned int *> procedureBytecodeMap;
+        std::unordered_map<std::shared_ptr<Block>, std::vector<unsigned int>> bytecodeMap;
+        std::unordered_map<std::shared_ptr<Block>, std::vector<Block *>> bytecodeBlocksMap;
+        std::unordered_map<std::shared_ptr<Block>, size_t> registerCountMap;
+        std::unordered_map<std::string, std::shared_ptr<Block>> procedureDefinitionMap;
         Compiler compiler(this, target.get());
+        compiler.setOptimizationsEnabled(m_compilerOptimizationsEnabled);
+        size_t maxRegisterCount = 0; // procedures use the registers of the calling script
         auto blocks = target->blocks();
         for (auto block : blocks) {
             if (block->topLevel()) {
@@ -106,13 +127,19 @@ void Engine::compile()
                     auto script = std::make_shared<Script>(target.get(), this);
                     m_scripts[block] = script;
 
+                    size_t functionCount = m_functions.size();
                     compiler.compile(block);
 
-                    script->setFunctions(m_functions);
-                    script->setBytecode(compiler.bytecode());
+                    if (m_functions.size() > functionCount)
+                        m_functionScripts.push_back(block.get());
+
+                    bytecodeMap[block] = compiler.bytecode();
+                    bytecodeBlocksMap[block] = compiler.bytecodeBlocks();
+                    registerCountMap[block] = compiler.maxRegisterCount();
+
                     if (block->opcode() == "procedures_definition") {
                         auto b = block->inputAt(block->findInput("custom_block"))->valueBlock();
-                        procedureBytecodeMap[b->mutationPrototype()->procCode()] = script->bytecode();
+                        procedureDefinitionMap[b->mutationPrototype()->procCode()] = block;
                     }
                 } else
                     std::cout << "warning: unsupported top level block: " << block->opcode() << std::endl;
@@ -120,13 +147,66 @@ void Engine::compile()
         }
 
         const std::vector<std::string> &procedures = compiler.procedures();
+
+        // Inline small procedures (all of them must be compiled first)
+        if (m_compilerOptimizationsEnabled) {
+            std::vector<const std::vector<unsigned int> *> procedureCode;
+
+            for (const std::string &code : procedures) {
+                auto it = procedureDefinitionMap.find(code);
+                procedureCode.push_back(it == procedureDefinitionMap.cend() ? nullptr : &bytecodeMap[it->second]);
+            }
+
+            ProcedureInliner inliner(procedureCode);
+            std::unordered_map<std::shared_ptr<Block>, std::vector<unsigned int>> inlinedBytecodeMap;
+
+            for (const auto &[block, bytecode] : bytecodeMap)
+                inlinedBytecodeMap[block] = inliner.process(bytecode, &bytecodeBlocksMap[block]);
+
+            bytecodeMap = std::move(inlinedBytecodeMap);
+        }
+
+        for (auto block : blocks) {
+            auto it = bytecodeMap.find(block);
+
+            if (it == bytecodeMap.cend())
+                continue;
+
+            auto script = m_scripts[block];
+            BytecodeVerifier verifier(it->second);
+            verifier.setConstValueCount(compiler.constInputValues().size());
+            verifier.setVariableCount(compiler.variables().size());
+            verifier.setListCount(compiler.lists().size());
+            verifier.setFunctionCount(m_functions.size());
+            verifier.setProcedureCount(procedures.size());
+
+            script->setFunctions(m_functions);
+
+            if (verifier.verify()) {
+                script->setBytecode(it->second);
+                script->setBytecodeBlocks(bytecodeBlocksMap[block]);
+                // Both values are upper bounds (inlined procedures are compiled as separate scripts, so they're included in the maximum)
+                maxRegisterCount = std::max(maxRegisterCount, std::min(registerCountMap[block], verifier.maxRegisterCount()));
+            } else {
+                std::cout << "warning: invalid bytecode at position " << verifier.errorPos() << " (" << verifier.error() << "); the script will do nothing" << std::endl;
+                script->setBytecode({ vm::OP_START, vm::OP_HALT });
+            }
+        }
+
         std::vector<unsigned int *> procedureBytecodes;
-        for (const std::string &code : procedures)
-            procedureBytecodes.push_back(procedureBytecodeMap[code]);
+        std::vector<Script *> procedureScripts;
+        for (const std::string &code : procedures) {
+            auto it = procedureDefinitionMap.find(code);
+            Script *procedureScript = it == procedureDefinitionMap.cend() ? nullptr : m_scripts[it->second].get();
+            procedureBytecodes.push_back(procedureScript ? procedureScript->bytecode() : nullptr);
+            procedureScripts.push_back(procedureScript);
+        }
 
         for (auto block : blocks) {
             if (m_scripts.count(block) == 1) {
                 m_scripts[block]->setProcedures(procedureBytecodes);
+                m_scripts[block]->setProcedureScripts(procedureScripts);
+                m_scripts[block]->setMaxRegisterCount(maxRegisterCount);
                 m_scripts[block]->setConstValues(compiler.constValues());
                 m_scripts[block]->setVariables(compiler.variables());
                 m_scripts[block]->setLists(compiler.lists());
@@ -135,6 +215,304 @@ void Engine::compile()
     }
 }
 
+bool Engine::saveBytecodeCache(std::ostream &stream, const std::string &key) const
+{
+    BytecodeCache cache;
+    cache.key = key;
+    cache.optimizationsEnabled = m_compilerOptimizationsEnabled;
+    cache.functionCount = m_functions.size();
+    cache.broadcastCount = m_broadcasts.size();
+    Stage *stage = this->stage();
+    cache.backdropCount = stage ? stage->costumes().size() : 0;
+    cache.targets.resize(m_targets.size());
+
+    // Entities are stored as indexes
+    std::unordered_map<Block *, BytecodeCache::Entity> blockIndexes;
+    std::unordered_map<Variable *, BytecodeCache::Entity> variableIndexes;
+    std::unordered_map<List *, BytecodeCache::Entity> listIndexes;
+    std::unordered_map<const unsigned int *, unsigned int> procedureIndexes; // bytecode, block of the definition
+    std::unordered_map<Script *, BytecodeCache::Entity> scriptIndexes;
+
+    for (unsigned int i = 0; i < m_targets.size(); i++) {
+        Target *target = m_targets[i].get();
+        const auto &blocks = target->blocks();
+        const auto &variables = target->variables();
+        const auto &lists = target->lists();
+        cache.targetCounts.push_back({ static_cast<unsigned int>(blocks.size()), static_cast<unsigned int>(variables.size()), static_cast<unsigned int>(lists.size()) });
+
+        for (unsigned int j = 0; j < blocks.size(); j++)
+            blockIndexes[blocks[j].get()] = { i, j };
+
+        for (unsigned int j = 0; j < variables.size(); j++)
+            variableIndexes[variables[j].get()] = { i, j };
+
+        for (unsigned int j = 0; j < lists.size(); j++)
+            listIndexes[lists[j].get()] = { i, j };
+
+        for (unsigned int j = 0; j < blocks.size(); j++) {
+            auto it = m_scripts.find(blocks[j]);
+
+            if (it != m_scripts.cend()) {
+                procedureIndexes[it->second->bytecode()] = j;
+                scriptIndexes[it->second.get()] = { i, j };
+            }
+        }
+    }
+
+    for (Block *block : m_functionScripts) {
+        auto it = blockIndexes.find(block);
+
+        if (it == blockIndexes.cend())
+            return false;
+
+        cache.functionScripts.push_back(it->second);
+    }
+
+    for (unsigned int i = 0; i < m_targets.size(); i++) {
+        BytecodeCache::Target &targetCache = cache.targets[i];
+        bool first = true;
+
+        for (auto block : m_targets[i]->blocks()) {
+            auto it = m_scripts.find(block);
+
+            if (it == m_scripts.cend())
+                continue;
+
+            Script *script = it->second.get();
+
+            // These are the same in all scripts of the target
+            if (first) {
+                targetCache.constValues = script->constValues();
+
+                for (Variable *var : script->variables())
+                    targetCache.variables.push_back(variableIndexes[var]);
+
+                for (List *list : script->lists())
+                    targetCache.lists.push_back(listIndexes[list]);
+
+                for (unsigned int *procedure : script->procedures())
+                    targetCache.procedures.push_back(procedure ? procedureIndexes[procedure] : BytecodeCache::noBlock);
+
+                first = false;
+            }
+
+            BytecodeCache::Script scriptCache;
+            scriptCache.block = blockIndexes[block.get()].index;
+            scriptCache.bytecode = script->bytecodeVector();
+
+            for (Block *b : script->bytecodeBlocks())
+                scriptCache.bytecodeBlocks.push_back(b ? blockIndexes[b].index : BytecodeCache::noBlock);
+
+            targetCache.scripts.push_back(std::move(scriptCache));
+        }
+    }
+
+    // Hat scripts are saved in the order of registration
+    for (unsigned int i = 0; i < m_broadcasts.size(); i++) {
+        auto it = m_broadcastMap.find(m_broadcasts[i].get());
+
+        if (it != m_broadcastMap.cend()) {
+            for (Script *script : it->second)
+                cache.hatScripts.push_back({ BytecodeCache::HatType::Broadcast, scriptIndexes[script], i, "" });
+        }
+    }
+
+    for (unsigned int i = 0; i < cache.backdropCount; i++) {
+        auto it = m_broadcastMap.find(stage->costumeAt(i)->broadcast());
+
+        if (it != m_broadcastMap.cend()) {
+            for (Script *script : it->second)
+                cache.hatScripts.push_back({ BytecodeCache::HatType::BackdropBroadcast, scriptIndexes[script], i, "" });
+        }
+    }
+
+    for (const auto &target : m_targets) {
+        auto it = m_cloneInitScriptsMap.find(target.get());
+
+        if (it != m_cloneInitScriptsMap.cend()) {
+            for (Script *script : it->second)
+                cache.hatScripts.push_back({ BytecodeCache::HatType::CloneInit, scriptIndexes[script], 0, "" });
+        }
+    }
+
+    for (const auto &[key, scripts] : m_whenKeyPressedScripts) {
+        for (Script *script : scripts)
+            cache.hatScripts.push_back({ BytecodeCache::HatType::KeyPress, scriptIndexes[script], 0, key });
+    }
+
+    cache.write(stream);
+    return true;
+}
+
+bool Engine::loadBytecodeCache(std::istream &stream, const std::string &key)
+{
+    BytecodeCache cache;
+
+    if (!cache.read(stream) || cache.key != key || cache.optimizationsEnabled != m_compilerOptimizationsEnabled || cache.targetCounts.size() != m_targets.size() ||
+        cache.broadcastCount != m_broadcasts.size() || cache.backdropCount != (stage() ? stage()->costumes().size() : 0))
+        return false;
+
+    for (unsigned int i = 0; i < m_targets.size(); i++) {
+        const BytecodeCache::TargetCounts &counts = cache.targetCounts[i];
+        Target *target = m_targets[i].get();
+
+        if (counts.blocks != target->blocks().size() || counts.variables != target->variables().size() || counts.lists != target->lists().size())
+            return false;
+    }
+
+    // Verify everything before changing the engine, so that it can compile the scripts if the cache is invalid
+    std::vector<std::vector<bool>> scriptBlocks(m_targets.size());
+    std::vector<size_t> maxRegisterCounts(m_targets.size(), 0); // procedures use the registers of the calling script
+
+    for (unsigned int i = 0; i < m_targets.size(); i++) {
+        const BytecodeCache::Target &targetCache = cache.targets[i];
+        scriptBlocks[i].resize(cache.targetCounts[i].blocks);
+
+        for (const BytecodeCache::Script &scriptCache : targetCache.scripts) {
+            scriptBlocks[i][scriptCache.block] = true;
+
+            BytecodeVerifier verifier(scriptCache.bytecode);
+            verifier.setConstValueCount(targetCache.constValues.size());
+            verifier.setVariableCount(targetCache.variables.size());
+            verifier.setListCount(targetCache.lists.size());
+            verifier.setFunctionCount(cache.functionCount);
+            verifier.setProcedureCount(targetCache.procedures.size());
+
+            if (!verifier.verify() || (!scriptCache.bytecodeBlocks.empty() && scriptCache.bytecodeBlocks.size() != scriptCache.bytecode.size()))
+                return false;
+
+            maxRegisterCounts[i] = std::max(maxRegisterCounts[i], verifier.maxRegisterCount());
+        }
+    }
+
+    for (const BytecodeCache::HatScript &hatScript : cache.hatScripts) {
+        if (!scriptBlocks[hatScript.block.target][hatScript.block.index])
+            return false;
+    }
+
+    resolveIds();
+
+    // Block functions can't be saved, so compile the scripts which added them (the functions get the same indexes)
+    auto functions = m_functions;
+    auto functionIndexes = m_functionIndexes;
+    auto scripts = m_scripts;
+    auto broadcastMap = m_broadcastMap;
+    auto cloneInitScriptsMap = m_cloneInitScriptsMap;
+    auto whenKeyPressedScripts = m_whenKeyPressedScripts;
+
+    for (const BytecodeCache::Entity &entity : cache.functionScripts) {
+        auto target = m_targets[entity.target];
+        Compiler compiler(this, target.get());
+        compiler.setOptimizationsEnabled(m_compilerOptimizationsEnabled);
+        compiler.compile(target->blocks()[entity.index]);
+    }
+
+    if (m_functions.size() != cache.functionCount) {
+        // The blocks register different functions now
+        m_functions = std::move(functions);
+        m_functionIndexes = std::move(functionIndexes);
+        m_scripts = std::move(scripts);
+        m_broadcastMap = std::move(broadcastMap);
+        m_cloneInitScriptsMap = std::move(cloneInitScriptsMap);
+        m_whenKeyPressedScripts = std::move(whenKeyPressedScripts);
+        return false;
+    }
+
+    // The compile functions of hat blocks register the scripts, which is done later
+    m_broadcastMap.clear();
+    m_runningBroadcastMap.clear();
+    m_cloneInitScriptsMap.clear();
+    m_whenKeyPressedScripts.clear();
+    m_scripts.clear();
+
+    m_functionScripts.clear();
+
+    for (const BytecodeCache::Entity &entity : cache.functionScripts)
+        m_functionScripts.push_back(m_targets[entity.target]->blocks()[entity.index].get());
+
+    for (unsigned int i = 0; i < m_targets.size(); i++) {
+        Target *target = m_targets[i].get();
+        const auto &blocks = target->blocks();
+        const BytecodeCache::Target &targetCache = cache.targets[i];
+        std::vector<Variable *> variables;
+        std::vector<List *> lists;
+        std::vector<std::shared_ptr<Script>> scripts;
+
+        for (const BytecodeCache::Entity &entity : targetCache.variables)
+            variables.push_back(m_targets[entity.target]->variables()[entity.index].get());
+
+        for (const BytecodeCache::Entity &entity : targetCache.lists)
+            lists.push_back(m_targets[entity.target]->lists()[entity.index].get());
+
+        for (const BytecodeCache::Script &scriptCache : targetCache.scripts) {
+            auto script = std::make_shared<Script>(target, this);
+            std::vector<Block *> bytecodeBlocks;
+
+            for (unsigned int index : scriptCache.bytecodeBlocks)
+                bytecodeBlocks.push_back(index == BytecodeCache::noBlock ? nullptr : blocks[index].get());
+
+            script->setBytecode(scriptCache.bytecode);
+            script->setBytecodeBlocks(bytecodeBlocks);
+            script->setFunctions(m_functions);
+            script->setMaxRegisterCount(maxRegisterCounts[i]);
+            script->setConstValues(targetCache.constValues);
+            script->setVariables(variables);
+            script->setLists(lists);
+            m_scripts[blocks[scriptCache.block]] = script;
+            scripts.push_back(script);
+        }
+
+        std::vector<unsigned int *> procedureBytecodes;
+        std::vector<Script *> procedureScripts;
+
+        for (unsigned int index : targetCache.procedures) {
+            auto it = (index == BytecodeCache::noBlock) ? m_scripts.cend() : m_scripts.find(blocks[index]);
+            Script *procedureScript = it == m_scripts.cend() ? nullptr : it->second.get();
+            procedureBytecodes.push_back(procedureScript ? procedureScript->bytecode() : nullptr);
+            procedureScripts.push_back(procedureScript);
+        }
+
+        for (auto script : scripts) {
+            script->setProcedures(procedureBytecodes);
+            script->setProcedureScripts(procedureScripts);
+        }
+    }
+
+    for (const BytecodeCache::HatScript &hatScript : cache.hatScripts) {
+        auto block = m_targets[hatScript.block.target]->blocks()[hatScript.block.index];
+
+        switch (hatScript.type) {
+            case BytecodeCache::HatType::Broadcast:
+                addBroadcastScript(block, m_broadcasts[hatScript.broadcast].get());
+                break;
+
+            case BytecodeCache::HatType::BackdropBroadcast:
+                addBroadcastScript(block, stage()->costumeAt(hatScript.broadcast)->broadcast());
+                break;
+
+            case BytecodeCache::HatType::KeyPress:
+                addKeyPressScript(block, hatScript.key);
+                break;
+
+            case BytecodeCache::HatType::CloneInit:
+                addCloneInitScript(block);
+                break;
+        }
+    }
+
+    return true;
+}
+
+bool Engine::compilerOptimizationsEnabled() const
+{
+    return m_compilerOptimizationsEnabled;
+}
+
+void Engine::setCompilerOptimizationsEnabled(bool enabled)
+{
+    m_compilerOptimizationsEnabled = enabled;
+}
+
 void Engine::start()
 {
     // NOTE: Running scripts should be deleted, but this method will probably be removed anyway
@@ -188,6 +566,7 @@ void Engine::broadcast(unsigned int index, VirtualMachine *sourceScript, bool wa
 
 void Engine::broadcastByPtr(Broadcast *broadcast, VirtualMachine *sourceScript, bool wait)
 {
+    TraceSpan span(m_tracer.get(), m_clock, "broadcast", broadcast->name());
     const std::vector<Script *> &scripts = m_broadcastMap[broadcast];
 
     for (auto script : scripts) {
@@ -279,6 +658,7 @@ void Engine::initClone(Sprite *clone)
     if (!source || !root)
         return;
 
+    TraceSpan span(m_tracer.get(), m_clock, "clone", root->name());
     auto it = m_cloneInitScriptsMap.find(root);
 
     if (it != m_cloneInitScriptsMap.cend()) {
@@ -341,6 +721,7 @@ void Engine::eventLoop(bool untilProjectStops)
     m_stopEventLoop = false;
 
     while (true) {
+        TraceSpan frameSpan(m_tracer.get(), m_clock, "frame");
         auto frameStart = m_clock->currentSteadyTime();
         std::chrono::steady_clock::time_point currentTime;
         std::chrono::milliseconds elapsedTime, sleepTime;
@@ -354,11 +735,18 @@ void Engine::eventLoop(bool untilProjectStops)
             m_scriptsToRemove.clear();
 
             // Execute new scripts from last frame
-            runScripts(m_newScripts, scripts);
+            {
+                TraceSpan span(m_tracer.get(), m_clock, "new scripts");
+                runScripts(m_newScripts, scripts);
+            }
 
             // Execute all running scripts
             m_newScripts.clear();
-            runScripts(scripts, scripts);
+
+            {
+                TraceSpan span(m_tracer.get(), m_clock, "running scripts");
+                runScripts(scripts, scripts);
+            }
 
             // Stop the event loop if the project has finished running (and untilProjectStops is set to true)
             if (untilProjectStops) {
@@ -381,6 +769,7 @@ void Engine::eventLoop(bool untilProjectStops)
             m_stopEventLoopMutex.lock();
 
             if (m_stopEventLoop) {
+                m_stopEventLoopMutex.unlock();
                 stop = true;
                 break;
             }
@@ -397,12 +786,16 @@ void Engine::eventLoop(bool untilProjectStops)
             break;
 
         // Redraw
-        if (m_redrawHandler)
+        if (m_redrawHandler) {
+            TraceSpan span(m_tracer.get(), m_clock, "redraw");
             m_redrawHandler();
+        }
 
         // If the timeout hasn't been reached yet (redraw was requested), sleep
-        if (!timeout)
+        if (!timeout) {
+            TraceSpan span(m_tracer.get(), m_clock, "sleep");
             m_clock->sleep(sleepTime);
+        }
     }
 
     finalize();
@@ -418,6 +811,7 @@ void Engine::runScripts(const TargetScriptMap &scriptMap, TargetScriptMap &globa
             continue; // skip the target if it doesn't have any running script
 
         const auto &scripts = it->second;
+        TraceSpan span(m_tracer.get(), m_clock, "target", m_executableTargets[i]->name());
 
         for (int i = 0; i < scripts.size(); i++) {
             auto script = scripts[i];
@@ -511,6 +905,16 @@ void Engine::setTurboModeEnabled(bool turboMode)
     m_turboModeEnabled = turboMode;
 }
 
+int Engine::warpTime() const
+{
+    return m_warpTime;
+}
+
+void Engine::setWarpTime(int time)
+{
+    m_warpTime = time;
+}
+
 bool Engine::keyPressed(const std::string &name) const
 {
     if (name == "any") {
@@ -681,6 +1085,64 @@ void Engine::setTimer(ITimer *timer)
     m_timer = timer;
 }
 
+Profiler *Engine::profiler() const
+{
+    return m_profiler.get();
+}
+
+Tracer *Engine::tracer() const
+{
+    return m_tracer.get();
+}
+
+std::string Engine::bytecodeReport() const
+{
+    struct ScriptReport
+    {
+            std::string target;
+            Block *block;
+            Script *script;
+    };
+
+    // Sort the scripts so that the report doesn't depend on the order of the script map
+    std::vector<ScriptReport> scripts;
+
+    for (const auto &[block, script] : m_scripts) {
+        if (script->target())
+            scripts.push_back({ script->target()->name(), block.get(), script.get() });
+    }
+
+    std::sort(scripts.begin(), scripts.end(), [](const ScriptReport &s1, const ScriptReport &s2) { return s1.target < s2.target || (s1.target == s2.target && s1.block->id() < s2.block->id()); });
+
+    std::string ret;
+
+    for (const ScriptReport &report : scripts) {
+        Disassembler disassembler(report.script);
+        std::vector<std::pair<unsigned int, size_t>> mix;
+
+        for (unsigned int opcode : disassembler.opcodes()) {
+            auto it = std::find_if(mix.begin(), mix.end(), [opcode](const std::pair<unsigned int, size_t> &item) { return item.first == opcode; });
+
+            if (it == mix.end())
+                mix.push_back({ opcode, 1 });
+            else
+                it->second++;
+        }
+
+        std::stable_sort(mix.begin(), mix.end(), [](const std::pair<unsigned int, size_t> &item1, const std::pair<unsigned int, size_t> &item2) { return item1.second > item2.second; });
+
+        ret += report.target + ": " + report.block->opcode() + " [" + report.block->id() + "]\n";
+        ret += "    words: " + std::to_string(disassembler.bytecode().size()) + "\n";
+        ret += "    instructions: " + std::to_string(disassembler.instructionCount()) + "\n";
+        ret += "    procedure calls: " + std::to_string(disassembler.instructionCount(vm::OP_CALL_PROCEDURE) + disassembler.instructionCount(vm::OP_TAIL_CALL)) + "\n";
+
+        for (const auto &[opcode, count] : mix)
+            ret += "    " + Disassembler::opcodeName(opcode) + ": " + std::to_string(count) + "\n";
+    }
+
+    return ret;
+}
+
 void Engine::registerSection(std::shared_ptr<IBlockSection> section)
 {
     if (section) {
@@ -706,11 +1168,13 @@ std::vector<std::shared_ptr<IBlockSection>> Engine::registeredSections() const
 
 unsigned int Engine::functionIndex(BlockFunc f)
 {
-    auto it = std::find(m_functions.begin(), m_functions.end(), f);
-    if (it != m_functions.end())
-        return it - m_functions.begin();
+    auto it = m_functionIndexes.find(f);
+    if (it != m_functionIndexes.end())
+        return it->second;
+    unsigned int index = m_functions.size();
     m_functions.push_back(f);
-    return m_functions.size() - 1;
+    m_functionIndexes[f] = index;
+    return index;
 }
 
 void Engine::addCompileFunction(IBlockSection *section, const std::string &opcode, BlockComp f)
@@ -5,6 +5,8 @@
 #include <scratchcpp/iengine.h>
 #include <scratchcpp/target.h>
 #include <scratchcpp/itimer.h>
+#include <scratchcpp/profiler.h>
+#include <scratchcpp/tracer.h>
 #include <unordered_map>
 #include <memory>
 #include <chrono>
@@ -28,6 +30,11 @@ class Engine : public IEngine
         void clear() override;
         void resolveIds();
         void compile() override;
+        bool saveBytecodeCache(std::ostream &stream, const std::string &key) const override;
+        bool loadBytecodeCache(std::istream &stream, const std::string &key) override;
+
+        bool compilerOptimizationsEnabled() const override;
+        void setCompilerOptimizationsEnabled(bool enabled) override;
 
         void start() override;
         void stop() override;
@@ -53,6 +60,9 @@ class Engine : public IEngine
         bool turboModeEnabled() const override;
         void setTurboModeEnabled(bool turboMode) override;
 
+        int warpTime() const override;
+        void setWarpTime(int time) override;
+
         bool keyPressed(const std::string &name) const override;
         void setKeyState(const std::string &name, bool pressed) override;
         void setAnyKeyPressed(bool pressed) override;
@@ -88,6 +98,10 @@ class Engine : public IEngine
         ITimer *timer() const override;
         void setTimer(ITimer *timer);
 
+        Profiler *profiler() const override;
+        Tracer *tracer() const override;
+        std::string bytecodeReport() const override;
+
         void registerSection(std::shared_ptr<IBlockSection> section) override;
         std::vector<std::shared_ptr<IBlockSection>> registeredSections() const;
         unsigned int functionIndex(BlockFunc f) override;
@@ -166,12 +180,18 @@ class Engine : public IEngine
         std::vector<VirtualMachine *> m_scriptsToRemove;
         std::unordered_map<std::shared_ptr<Block>, std::shared_ptr<Script>> m_scripts;
         std::vector<BlockFunc> m_functions;
+        std::unordered_map<BlockFunc, unsigned int> m_functionIndexes; // function, index in m_functions
+        std::vector<Block *> m_functionScripts;                        // scripts which added new functions (in order of compilation)
 
         std::unique_ptr<ITimer> m_defaultTimer;
         ITimer *m_timer = nullptr;
+        std::unique_ptr<Profiler> m_profiler;
+        std::unique_ptr<Tracer> m_tracer;
         double m_fps = 30;                         // default FPS
         std::chrono::milliseconds m_frameDuration; // will be computed in eventLoop()
         bool m_turboModeEnabled = false;
+        int m_warpTime = 500;
+        bool m_compilerOptimizationsEnabled = true;
         std::unordered_map<std::string, bool> m_keyMap; // holds key states
         bool m_anyKeyPressed = false;
         double m_mouseX = 0;
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/virtualmachine.h>
+#include <algorithm>
+
+#include "procedureinliner.h"
+#include "../virtualmachine_p.h"
+#include "../compiler_p.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+ProcedureInliner::ProcedureInliner(const std::vector<const std::vector<unsigned int> *> &procedures) :
+    m_procedures(procedures),
+    m_states(procedures.size(), State::Unprocessed),
+    m_bodies(procedures.size()),
+    m_argCounts(procedures.size(), 0)
+{
+}
+
+size_t ProcedureInliner::maxProcedureSize() const
+{
+    return m_maxProcedureSize;
+}
+
+void ProcedureInliner::setMaxProcedureSize(size_t size)
+{
+    m_maxProcedureSize = size;
+}
+
+std::vector<unsigned int> ProcedureInliner::process(const std::vector<unsigned int> &bytecode, std::vector<Block *> *blocks)
+{
+    // The blocks of the bytecode words are replaced with the blocks of the result (inlined procedures belong to the block which calls them)
+    if (blocks && blocks->size() != bytecode.size())
+        blocks = nullptr;
+
+    std::vector<unsigned int> ret;
+    std::vector<Block *> retBlocks;
+    ret.reserve(bytecode.size());
+    std::vector<std::pair<size_t, size_t>> calls; // position of OP_INIT_PROCEDURE in the result, number of added arguments
+    bool inlined = false;
+    size_t pos = 0;
+
+    while (pos < bytecode.size()) {
+        unsigned int opcode = bytecode[pos];
+
+        // Invalid bytecode is left for the verifier
+        if (opcode >= VirtualMachinePrivate::instruction_count || pos + VirtualMachinePrivate::instruction_arg_count[opcode] >= bytecode.size())
+            return bytecode;
+
+        size_t argCount = VirtualMachinePrivate::instruction_arg_count[opcode];
+
+        switch (opcode) {
+            case OP_INIT_PROCEDURE:
+                calls.push_back({ ret.size(), 0 });
+                break;
+
+            case OP_ADD_ARG:
+                if (!calls.empty())
+                    calls.back().second++;
+                break;
+
+            case OP_TAIL_CALL:
+                if (!calls.empty())
+                    calls.pop_back();
+                break;
+
+            case OP_CALL_PROCEDURE: {
+                if (calls.empty())
+                    break;
+
+                auto call = calls.back();
+                calls.pop_back();
+                unsigned int index = bytecode[pos + 1];
+                const std::vector<unsigned int> *body = inlinableProcedure(index);
+
+                if (body && m_argCounts[index] <= call.second) {
+                    // Keep the arguments on the argument stack, but don't jump to the procedure
+                    ret.erase(ret.begin() + call.first);
+                    addBody(ret, *body, call.second);
+                    inlined = true;
+
+                    if (blocks) {
+                        retBlocks.erase(retBlocks.begin() + call.first);
+                        retBlocks.resize(ret.size(), (*blocks)[pos]);
+                    }
+
+                    pos += argCount + 1;
+                    continue;
+                }
+
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        ret.insert(ret.end(), bytecode.begin() + pos, bytecode.begin() + pos + argCount + 1);
+
+        if (blocks)
+            retBlocks.insert(retBlocks.end(), blocks->begin() + pos, blocks->begin() + pos + argCount + 1);
+
+        pos += argCount + 1;
+    }
+
+    if (inlined)
+        CompilerPrivate::resolveJumps(ret);
+
+    if (blocks)
+        *blocks = retBlocks;
+
+    return ret;
+}
+
+const std::vector<unsigned int> *ProcedureInliner::inlinableProcedure(unsigned int index)
+{
+    if (index >= m_procedures.size() || !m_procedures[index])
+        return nullptr;
+
+    switch (m_states[index]) {
+        case State::Unprocessed:
+            break;
+
+        case State::Inlinable:
+            return &m_bodies[index];
+
+        default:
+            return nullptr; // recursive or not inlinable
+    }
+
+    m_states[index] = State::Processing;
+    std::vector<unsigned int> code = process(*m_procedures[index]);
+
+    // Only procedures which don't call other procedures (after inlining) can be inlined, so recursive procedures are never inlined.
+    // Warp mode and OP_HALT ("stop this script" returns from the procedure) depend on the call tree, so these procedures are skipped too.
+    bool inlinable = code.size() >= 2 && code.front() == OP_START && code.back() == OP_HALT && code.size() - 2 <= m_maxProcedureSize;
+    size_t argCount = 0;
+    size_t pos = 1;
+
+    while (inlinable && pos < code.size() - 1) {
+        unsigned int opcode = code[pos];
+
+        switch (opcode) {
+            case OP_START:
+            case OP_HALT:
+            case OP_WARP:
+            case OP_INIT_PROCEDURE:
+            case OP_CALL_PROCEDURE:
+            case OP_TAIL_CALL:
+                inlinable = false;
+                break;
+
+            case OP_READ_ARG:
+                argCount = std::max(argCount, static_cast<size_t>(code[pos + 1]) + 1);
+                break;
+
+            default:
+                break;
+        }
+
+        pos += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+
+    if (!inlinable) {
+        m_states[index] = State::NotInlinable;
+        return nullptr;
+    }
+
+    m_bodies[index].assign(code.begin() + 1, code.end() - 1);
+    m_argCounts[index] = argCount;
+    m_states[index] = State::Inlinable;
+    return &m_bodies[index];
+}
+
+void ProcedureInliner::addBody(std::vector<unsigned int> &dst, const std::vector<unsigned int> &body, size_t argCount)
+{
+    // The arguments are read relative to the top of the argument stack, which also contains
+    // the arguments of the procedures inlined in the body while their arguments are being added
+    size_t nestedArgCount = 0;
+    size_t pos = 0;
+
+    while (pos < body.size()) {
+        unsigned int opcode = body[pos];
+        size_t instructionArgCount = VirtualMachinePrivate::instruction_arg_count[opcode];
+
+        if (opcode == OP_READ_ARG)
+            dst.insert(dst.end(), { OP_READ_INLINE_ARG, static_cast<unsigned int>(argCount + nestedArgCount - body[pos + 1]) });
+        else {
+            dst.insert(dst.end(), body.begin() + pos, body.begin() + pos + instructionArgCount + 1);
+
+            if (opcode == OP_ADD_ARG)
+                nestedArgCount++;
+            else if (opcode == OP_FREE_INLINE_ARGS)
+                nestedArgCount -= body[pos + 1];
+        }
+
+        pos += instructionArgCount + 1;
+    }
+
+    if (argCount > 0)
+        dst.insert(dst.end(), { OP_FREE_INLINE_ARGS, static_cast<unsigned int>(argCount) });
+}
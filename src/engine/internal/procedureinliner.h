@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace libscratchcpp
+{
+
+class Block;
+
+class ProcedureInliner
+{
+    public:
+        ProcedureInliner(const std::vector<const std::vector<unsigned int> *> &procedures);
+        ProcedureInliner(std::vector<const std::vector<unsigned int> *> &&) = delete;
+        ProcedureInliner(const ProcedureInliner &) = delete;
+
+        size_t maxProcedureSize() const;
+        void setMaxProcedureSize(size_t size);
+
+        std::vector<unsigned int> process(const std::vector<unsigned int> &bytecode, std::vector<Block *> *blocks = nullptr);
+
+    private:
+        enum class State
+        {
+            Unprocessed,
+            Processing,
+            Inlinable,
+            NotInlinable
+        };
+
+        const std::vector<unsigned int> *inlinableProcedure(unsigned int index);
+        void addBody(std::vector<unsigned int> &dst, const std::vector<unsigned int> &body, size_t argCount);
+
+        const std::vector<const std::vector<unsigned int> *> &m_procedures;
+        std::vector<State> m_states;
+        std::vector<std::vector<unsigned int>> m_bodies; // procedure bytecode without OP_START and OP_HALT
+        std::vector<size_t> m_argCounts;                 // number of arguments read by the procedures
+        size_t m_maxProcedureSize = 64;
+};
+
+} // namespace libscratchcpp
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <scratchcpp/tracer.h>
+
+#include "iclock.h"
+
+namespace libscratchcpp
+{
+
+// Records an event in the tracer (if it's enabled) when the span goes out of scope
+class TraceSpan
+{
+    public:
+        TraceSpan(Tracer *tracer, IClock *clock, const char *name, const std::string &detail = std::string()) :
+            m_tracer((tracer && tracer->enabled()) ? tracer : nullptr),
+            m_clock(clock),
+            m_name(name)
+        {
+            if (m_tracer) {
+                m_detail = detail;
+                m_start = m_clock->currentSteadyTime();
+            }
+        }
+
+        TraceSpan(const TraceSpan &) = delete;
+
+        ~TraceSpan()
+        {
+            if (m_tracer)
+                m_tracer->addEvent(m_name, m_detail, m_start, m_clock->currentSteadyTime());
+        }
+
+    private:
+        Tracer *m_tracer = nullptr;
+        IClock *m_clock = nullptr;
+        const char *m_name = nullptr;
+        std::string m_detail;
+        std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace libscratchcpp
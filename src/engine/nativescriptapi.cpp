@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/nativescriptapi.h>
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/list.h>
+#include <cassert>
+
+#include "virtualmachine_p.h"
+
+using namespace libscratchcpp;
+
+/*!
+ * Returns true if scripts generated for the given API version and compiled with the given sizes of Value and List
+ * can run with this build of the library.
+ */
+bool NativeScriptApi::isCompatible(unsigned int version, size_t valueSize, size_t listSize)
+{
+    return (version == NativeScriptApi::version) && (valueSize == sizeof(Value)) && (listSize == sizeof(List));
+}
+
+/*! Returns the register at the given index with the given register count (see VirtualMachine::getInput()). */
+Value *NativeScriptApi::reg(VirtualMachine *vm, unsigned int index, unsigned int count)
+{
+    VirtualMachinePrivate *impl = vm->impl.get();
+    assert(impl->regCount >= count);
+    return &impl->regs[impl->regCount - count + index];
+}
+
+/*! Adds the given value to registers. */
+void NativeScriptApi::push(VirtualMachine *vm, const Value &v)
+{
+    vm->addReturnValue(v);
+}
+
+/*! Frees the given number of registers. */
+void NativeScriptApi::pop(VirtualMachine *vm, unsigned int count)
+{
+    assert(vm->impl->regCount >= count);
+    vm->impl->regCount -= count;
+}
+
+/*! Marks the script as finished (the end of the script). */
+void NativeScriptApi::halt(VirtualMachine *vm)
+{
+    VirtualMachinePrivate *impl = vm->impl.get();
+    impl->atEnd = true;
+    impl->procedureArgCount = 0;
+    impl->procedureArgBase = 0;
+}
+
+/*! Stores the position of the last checkpoint (see VirtualMachine::moveToLastCheckpoint()). */
+void NativeScriptApi::setCheckpoint(VirtualMachine *vm, unsigned int *pos)
+{
+    vm->impl->checkpoint = pos;
+}
+
+/*!
+ * Starts a loop which continues at the given position.
+ * \param[in] vm The virtual machine.
+ * \param[in] isRepeatLoop Whether it's a repeat (or forever) loop.
+ * \param[in] start The position of the loop instruction.
+ * \param[in] index The index of the first iteration (-1 for forever loops).
+ * \param[in] max The number of iterations of repeat loops.
+ */
+void NativeScriptApi::beginLoop(VirtualMachine *vm, bool isRepeatLoop, unsigned int *start, size_t index, size_t max)
+{
+    vm->impl->loops.push_back({ isRepeatLoop, start, index, max });
+}
+
+/*! Returns the index of the current repeat loop. */
+size_t NativeScriptApi::loopIndex(VirtualMachine *vm)
+{
+    assert(!vm->impl->loops.empty());
+    return vm->impl->loops.back().index;
+}
+
+/*! Ends the current loop (used when the condition of a repeat until loop is met). */
+void NativeScriptApi::popLoop(VirtualMachine *vm)
+{
+    assert(!vm->impl->loops.empty());
+    vm->impl->loops.pop_back();
+}
+
+/*!
+ * Handles the end of an iteration of the current loop.
+ * \param[in] vm The virtual machine.
+ * \param[in] pos The position of the loop end instruction.
+ * \param[out] yieldPos The position where the script continues if it must stop now (the screen refreshes), or nullptr.
+ * \return True if the loop runs again.
+ */
+bool NativeScriptApi::endLoop(VirtualMachine *vm, unsigned int *pos, unsigned int **yieldPos)
+{
+    VirtualMachinePrivate *impl = vm->impl.get();
+    assert(!impl->loops.empty());
+    VirtualMachinePrivate::Loop &l = impl->loops.back();
+    bool yield = !impl->noBreak && !impl->warp;
+
+    if (l.isRepeatLoop && (l.index != static_cast<size_t>(-1)) && (++l.index >= l.max)) {
+        impl->loops.pop_back();
+        *yieldPos = yield ? pos : nullptr;
+        return false;
+    }
+
+    *yieldPos = yield ? l.start : nullptr;
+    return true;
+}
+
+/*!
+ * Calls the function with the given index.
+ * \param[in] vm The virtual machine.
+ * \param[in] function The index of the function.
+ * \param[in] pos The position of the argument of the instruction.
+ * \param[out] nextPos The position where the script continues (unless the result is ExecResult::Continue).
+ */
+NativeScriptApi::ExecResult NativeScriptApi::exec(VirtualMachine *vm, unsigned int function, unsigned int *pos, unsigned int **nextPos)
+{
+    VirtualMachinePrivate *impl = vm->impl.get();
+    unsigned int ret = impl->functions[function](vm);
+    bool jump = false;
+
+    // Moving to a checkpoint and going back continue in the bytecode interpreter
+    if (impl->updatePos) {
+        pos = impl->pos;
+        impl->updatePos = false;
+        jump = true;
+    }
+
+    if (impl->stop) {
+        impl->stop = false;
+        impl->callTree.clear();
+
+        if (impl->goBack) {
+            impl->goBack = false;
+            pos -= 2;
+            jump = true;
+        } else
+            impl->regCount -= ret;
+
+        if (!impl->warp) {
+            *nextPos = pos;
+            return ExecResult::Yield;
+        }
+    } else
+        impl->regCount -= ret;
+
+    *nextPos = pos;
+    return jump ? ExecResult::Jump : ExecResult::Continue;
+}
+
+/*! Initializes the list of procedure (custom block) arguments. */
+void NativeScriptApi::initProcedure(VirtualMachine *vm)
+{
+    vm->impl->nextProcedureArgBase = vm->impl->procedureArgCount;
+}
+
+/*! Adds a procedure (custom block) argument with the value from the last register and frees the register. */
+void NativeScriptApi::addArg(VirtualMachine *vm)
+{
+    VirtualMachinePrivate *impl = vm->impl.get();
+    const Value &v = impl->regs[impl->regCount - 1];
+
+    if (impl->procedureArgCount < impl->procedureArgs.size())
+        impl->procedureArgs[impl->procedureArgCount] = v;
+    else
+        impl->procedureArgs.push_back(v);
+
+    impl->procedureArgCount++;
+    impl->regCount--;
+}
+
+/*! Returns the procedure (custom block) argument with the given index. */
+const Value &NativeScriptApi::arg(VirtualMachine *vm, unsigned int index)
+{
+    return vm->impl->procedureArgs[vm->impl->procedureArgBase + index];
+}
+
+/*! Returns the argument of an inlined procedure with the given offset from the top of the argument stack. */
+const Value &NativeScriptApi::inlineArg(VirtualMachine *vm, unsigned int offset)
+{
+    return vm->impl->procedureArgs[vm->impl->procedureArgCount - offset];
+}
+
+/*! Removes the given number of arguments from the top of the argument stack. */
+void NativeScriptApi::freeInlineArgs(VirtualMachine *vm, unsigned int count)
+{
+    vm->impl->procedureArgCount -= count;
+}
+
+/*! Breaks the current frame at the end of the loop. */
+void NativeScriptApi::breakFrame(VirtualMachine *vm)
+{
+    vm->impl->noBreak = false;
+}
+
+/*! Runs the script without screen refresh. */
+void NativeScriptApi::warp(VirtualMachine *vm)
+{
+    vm->impl->warp = true;
+}
+
+/*! Returns the index (starting with 1) of the list item referenced by the given value (for example "last" or "random"), or 0 if it's invalid. */
+size_t NativeScriptApi::listIndex(const Value *index, List *list)
+{
+    return VirtualMachinePrivate::getListIndex(index, list);
+}
+
+/*! Deletes the list item referenced by the given value (for example "last", "random" or "all"). */
+void NativeScriptApi::deleteListItem(List *list, const Value *index)
+{
+    VirtualMachinePrivate::deleteListItem(list, index);
+}
+
+/*! Inserts the given item at the position referenced by the given value (for example "last" or "random"). */
+void NativeScriptApi::insertListItem(List *list, const Value *item, const Value *index)
+{
+    VirtualMachinePrivate::insertListItem(list, item, index);
+}
+
+/*! Replaces the list item referenced by the given value (for example "last" or "random") with the given item. */
+void NativeScriptApi::replaceListItem(List *list, const Value *index, const Value *item)
+{
+    VirtualMachinePrivate::replaceListItem(list, index, item);
+}
+
+/*! Stores a random number between v1 and v2 in v1. */
+void NativeScriptApi::randomNumber(Value *v1, const Value *v2)
+{
+    VirtualMachinePrivate::randomNumber(v1, v2);
+}
+
+/*! Rounds the given number. */
+void NativeScriptApi::roundNumber(Value *v)
+{
+    VirtualMachinePrivate::roundNumber(v);
+}
+
+/*! Replaces the given number with its absolute value. */
+void NativeScriptApi::absNumber(Value *v)
+{
+    VirtualMachinePrivate::absNumber(v);
+}
+
+/*! Replaces the given number with its floor. */
+void NativeScriptApi::floorNumber(Value *v)
+{
+    VirtualMachinePrivate::floorNumber(v);
+}
+
+/*! Replaces the given number with its ceiling. */
+void NativeScriptApi::ceilNumber(Value *v)
+{
+    VirtualMachinePrivate::ceilNumber(v);
+}
+
+/*! Replaces the given number with its square root. */
+void NativeScriptApi::sqrtNumber(Value *v)
+{
+    VirtualMachinePrivate::sqrtNumber(v);
+}
+
+/*! Replaces the given angle (in degrees) with its sine. */
+void NativeScriptApi::sinNumber(Value *v)
+{
+    VirtualMachinePrivate::sinNumber(v);
+}
+
+/*! Replaces the given angle (in degrees) with its cosine. */
+void NativeScriptApi::cosNumber(Value *v)
+{
+    VirtualMachinePrivate::cosNumber(v);
+}
+
+/*! Replaces the given angle (in degrees) with its tangent. */
+void NativeScriptApi::tanNumber(Value *v)
+{
+    VirtualMachinePrivate::tanNumber(v);
+}
+
+/*! Replaces the given number with its arcsine (in degrees). */
+void NativeScriptApi::asinNumber(Value *v)
+{
+    VirtualMachinePrivate::asinNumber(v);
+}
+
+/*! Replaces the given number with its arccosine (in degrees). */
+void NativeScriptApi::acosNumber(Value *v)
+{
+    VirtualMachinePrivate::acosNumber(v);
+}
+
+/*! Replaces the given number with its arctangent (in degrees). */
+void NativeScriptApi::atanNumber(Value *v)
+{
+    VirtualMachinePrivate::atanNumber(v);
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/profiler.h>
+#include <scratchcpp/block.h>
+#include <scratchcpp/blockprototype.h>
+#include <scratchcpp/input.h>
+#include <scratchcpp/target.h>
+#include <algorithm>
+#include <map>
+
+#include "profiler_p.h"
+
+using namespace libscratchcpp;
+
+static std::string blockFrame(Block *block)
+{
+    // Custom blocks are identified by their code
+    std::string name = block->opcode();
+
+    if (name == "procedures_call" && block->mutationPrototype())
+        name = block->mutationPrototype()->procCode();
+    else if (name == "procedures_definition") {
+        auto input = block->inputAt(block->findInput("custom_block"));
+
+        if (input && input->valueBlock() && input->valueBlock()->mutationPrototype())
+            name = "define " + input->valueBlock()->mutationPrototype()->procCode();
+    }
+
+    name += " [" + block->id() + "]";
+
+    // Semicolons separate the frames
+    std::replace(name.begin(), name.end(), ';', '_');
+    std::replace(name.begin(), name.end(), '\n', ' ');
+    return name;
+}
+
+/*! Constructs Profiler. */
+Profiler::Profiler() :
+    impl(spimpl::make_unique_impl<ProfilerPrivate>())
+{
+}
+
+/*! Returns true if the virtual machines record the executed instructions. */
+bool Profiler::enabled() const
+{
+    return impl->enabled;
+}
+
+/*!
+ * Sets whether the virtual machines record the executed instructions.
+ * \note While profiling is enabled, scripts run in the bytecode interpreter (precompiled and exported code isn't used).
+ */
+void Profiler::setEnabled(bool enabled)
+{
+    impl->enabled = enabled;
+}
+
+/*! Returns true if the virtual machines sample the running blocks (see foldedStacks()). */
+bool Profiler::samplingEnabled() const
+{
+    return impl->samplingEnabled;
+}
+
+/*!
+ * Sets whether the virtual machines sample the running blocks (see foldedStacks()).
+ * \note Like the instruction counting, sampling runs scripts in the bytecode interpreter.
+ */
+void Profiler::setSamplingEnabled(bool enabled)
+{
+    impl->samplingEnabled = enabled;
+}
+
+/*! Returns the number of instructions between samples. */
+unsigned int Profiler::sampleInterval() const
+{
+    return impl->sampleInterval;
+}
+
+/*! Sets the number of instructions between samples (the default is 1000). */
+void Profiler::setSampleInterval(unsigned int interval)
+{
+    impl->sampleInterval = std::max(interval, 1u);
+}
+
+/*! Removes all recorded data. */
+void Profiler::reset()
+{
+    impl->opcodes.clear();
+    impl->functions.clear();
+    impl->functionEntries.clear();
+    impl->samples.clear();
+}
+
+/*! Returns the number of executions of the given instruction (see vm::Opcode). */
+unsigned long long Profiler::opcodeCount(unsigned int opcode) const
+{
+    return opcode < impl->opcodes.size() ? impl->opcodes[opcode].count : 0;
+}
+
+/*! Returns the total time spent in the given instruction (see vm::Opcode). The time of vm::OP_EXEC includes the block functions. */
+std::chrono::nanoseconds Profiler::opcodeTime(unsigned int opcode) const
+{
+    return opcode < impl->opcodes.size() ? impl->opcodes[opcode].time : std::chrono::nanoseconds::zero();
+}
+
+/*! Returns the list of called block functions in the order of their first call. */
+const std::vector<BlockFunc> &Profiler::functions() const
+{
+    return impl->functions;
+}
+
+/*! Returns the number of calls of the given block function. */
+unsigned long long Profiler::functionCount(BlockFunc function) const
+{
+    auto it = impl->functionEntries.find(function);
+    return it == impl->functionEntries.cend() ? 0 : it->second.count;
+}
+
+/*! Returns the total time spent in the given block function. */
+std::chrono::nanoseconds Profiler::functionTime(BlockFunc function) const
+{
+    auto it = impl->functionEntries.find(function);
+    return it == impl->functionEntries.cend() ? std::chrono::nanoseconds::zero() : it->second.time;
+}
+
+/*! Returns the total time spent in all instructions. */
+std::chrono::nanoseconds Profiler::totalTime() const
+{
+    std::chrono::nanoseconds ret = std::chrono::nanoseconds::zero();
+
+    for (const auto &entry : impl->opcodes)
+        ret += entry.time;
+
+    return ret;
+}
+
+/*!
+ * Returns the sampled time in the "folded stacks" format used by flame graph tools (for example FlameGraph or speedscope).
+ * Each line contains the target, the script, the custom block calls and the running block separated by semicolons,
+ * followed by the time in nanoseconds. Blocks are identified by their opcode (or the custom block code) and ID.
+ * \code
+ * Sprite1;event_whenflagclicked [a1];my block %s [b2];define my block %s [c3];motion_movesteps [d4] 1520
+ * \endcode
+ * \note The samples refer to the blocks, so the blocks must exist when this is called.
+ */
+std::string Profiler::foldedStacks() const
+{
+    // The lines are sorted (different block stacks may have the same names)
+    std::map<std::string, std::chrono::nanoseconds> lines;
+
+    for (const auto &[stack, time] : impl->samples) {
+        std::string line;
+
+        // Clones use the blocks of the sprite, so they're sampled as the sprite
+        if (!stack.empty() && stack.front()->target())
+            line = stack.front()->target()->name();
+
+        for (Block *block : stack)
+            line += (line.empty() ? "" : ";") + blockFrame(block);
+
+        lines[line] += time;
+    }
+
+    std::string ret;
+
+    for (const auto &[line, time] : lines)
+        ret += line + " " + std::to_string(time.count()) + "\n";
+
+    return ret;
+}
+
+/*! Records an execution of the given instruction. This is called by the virtual machine. */
+void Profiler::addOpcode(unsigned int opcode, std::chrono::nanoseconds time)
+{
+    if (opcode >= impl->opcodes.size())
+        impl->opcodes.resize(opcode + 1, { 0, std::chrono::nanoseconds::zero() });
+
+    auto &entry = impl->opcodes[opcode];
+    entry.count++;
+    entry.time += time;
+}
+
+/*! Records a call of the given block function. This is called by the virtual machine. */
+void Profiler::addFunction(BlockFunc function, std::chrono::nanoseconds time)
+{
+    auto it = impl->functionEntries.find(function);
+
+    if (it == impl->functionEntries.end()) {
+        impl->functions.push_back(function);
+        it = impl->functionEntries.insert({ function, { 0, std::chrono::nanoseconds::zero() } }).first;
+    }
+
+    it->second.count++;
+    it->second.time += time;
+}
+
+/*!
+ * Records a sample of the given stack, i. e. the top level block of each script in the call tree followed by
+ * the running block in it (see foldedStacks()). This is called by the virtual machine.
+ */
+void Profiler::addSample(const std::vector<Block *> &stack, std::chrono::nanoseconds time)
+{
+    auto it = impl->samples.find(stack);
+
+    if (it == impl->samples.end())
+        impl->samples[stack] = time;
+    else
+        it->second += time;
+}
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "profiler_p.h"
+
+using namespace libscratchcpp;
+
+ProfilerPrivate::ProfilerPrivate()
+{
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <scratchcpp/global.h>
+#include <unordered_map>
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+
+namespace libscratchcpp
+{
+
+class Block;
+
+struct ProfilerPrivate
+{
+        ProfilerPrivate();
+        ProfilerPrivate(const ProfilerPrivate &) = delete;
+
+        typedef struct
+        {
+                unsigned long long count;
+                std::chrono::nanoseconds time;
+        } Entry;
+
+        bool enabled = false;
+        std::vector<Entry> opcodes; // indexed by opcode
+        std::vector<BlockFunc> functions;
+        std::unordered_map<BlockFunc, Entry> functionEntries;
+
+        bool samplingEnabled = false;
+        unsigned int sampleInterval = 1000;
+        std::map<std::vector<Block *>, std::chrono::nanoseconds> samples; // stack (the scripts and the blocks), time
+};
+
+} // namespace libscratchcpp
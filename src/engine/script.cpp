@@ -7,6 +7,7 @@
 #include <scratchcpp/sprite.h>
 #include <scratchcpp/iengine.h>
 #include <iostream>
+#include <algorithm>
 
 #include "script_p.h"
 
@@ -43,6 +44,55 @@ void Script::setBytecode(const std::vector<unsigned int> &code)
     impl->bytecode = impl->bytecodeVector.data();
 }
 
+/*! Returns the block which generated each word of the bytecode (see Compiler::bytecodeBlocks()). */
+const std::vector<Block *> &Script::bytecodeBlocks() const
+{
+    return impl->bytecodeBlocks;
+}
+
+/*! Sets the block which generated each word of the bytecode (see Compiler::bytecodeBlocks()). */
+void Script::setBytecodeBlocks(const std::vector<Block *> &blocks)
+{
+    impl->bytecodeBlocks = blocks;
+}
+
+/*! Returns the block which generated the instruction at the given position, or nullptr if the position isn't in the bytecode of the script. */
+Block *Script::blockAt(const unsigned int *pos) const
+{
+    if (!impl->bytecode || pos < impl->bytecode)
+        return nullptr;
+
+    size_t index = pos - impl->bytecode;
+    return index < std::min(impl->bytecodeVector.size(), impl->bytecodeBlocks.size()) ? impl->bytecodeBlocks[index] : nullptr;
+}
+
+/*! Returns the native (exported to C++) function of the script. */
+NativeScript Script::nativeScript() const
+{
+    return impl->nativeScript;
+}
+
+/*!
+ * Sets the native (exported to C++) function of the script, which is used by virtual machines of the script instead of the bytecode.
+ * \see ScriptExporter
+ */
+void Script::setNativeScript(NativeScript script)
+{
+    impl->nativeScript = script;
+}
+
+/*! Returns the number of registers allocated by virtual machines of the script. */
+size_t Script::maxRegisterCount() const
+{
+    return impl->maxRegisterCount;
+}
+
+/*! Sets the number of registers allocated by virtual machines of the script (see Compiler::maxRegisterCount()). */
+void Script::setMaxRegisterCount(size_t count)
+{
+    impl->maxRegisterCount = count;
+}
+
 /*! Starts the script (creates a virtual machine). */
 std::shared_ptr<VirtualMachine> Script::start()
 {
@@ -54,9 +104,12 @@ std::shared_ptr<VirtualMachine> Script::start(Target *target)
 {
     auto vm = std::make_shared<VirtualMachine>(target, impl->engine, this);
     vm->setBytecode(impl->bytecode);
+    vm->setNativeScript(impl->nativeScript);
     vm->setProcedures(impl->procedures);
     vm->setFunctions(impl->functions);
     vm->setConstValues(impl->constValues);
+    vm->setWarpTime(impl->engine ? impl->engine->warpTime() : 0);
+    vm->setProfiler(impl->engine ? impl->engine->profiler() : nullptr);
 
     Sprite *sprite = nullptr;
     if (target && !target->isStage())
@@ -112,6 +165,12 @@ std::shared_ptr<VirtualMachine> Script::start(Target *target)
     return vm;
 }
 
+/*! Returns the list of procedures (custom blocks), i. e. the bytecode of their definitions. */
+const std::vector<unsigned int *> &Script::procedures() const
+{
+    return impl->proceduresVector;
+}
+
 /*! Sets the list of procedures (custom blocks). */
 void Script::setProcedures(const std::vector<unsigned int *> &procedures)
 {
@@ -119,6 +178,18 @@ void Script::setProcedures(const std::vector<unsigned int *> &procedures)
     impl->procedures = impl->proceduresVector.data();
 }
 
+/*! Returns the scripts of the procedures (in the same order as procedures()). */
+const std::vector<Script *> &Script::procedureScripts() const
+{
+    return impl->procedureScripts;
+}
+
+/*! Sets the scripts of the procedures, which are used to find the blocks in the call tree (see Profiler::foldedStacks()). */
+void Script::setProcedureScripts(const std::vector<Script *> &scripts)
+{
+    impl->procedureScripts = scripts;
+}
+
 /*! Sets the list of functions. */
 void Script::setFunctions(const std::vector<BlockFunc> &functions)
 {
@@ -126,6 +197,12 @@ void Script::setFunctions(const std::vector<BlockFunc> &functions)
     impl->functions = impl->functionsVector.data();
 }
 
+/*! Returns the list of constant values. */
+const std::vector<Value> &Script::constValues() const
+{
+    return impl->constValuesVector;
+}
+
 /*! Sets the list of constant values. */
 void Script::setConstValues(const std::vector<Value> &values)
 {
@@ -133,6 +210,12 @@ void Script::setConstValues(const std::vector<Value> &values)
     impl->constValues = impl->constValuesVector.data();
 }
 
+/*! Returns the list of variables. */
+const std::vector<Variable *> &Script::variables() const
+{
+    return impl->variables;
+}
+
 /*! Sets the list of variables. */
 void Script::setVariables(const std::vector<Variable *> &variables)
 {
@@ -143,6 +226,12 @@ void Script::setVariables(const std::vector<Variable *> &variables)
         impl->variableValues.push_back(var->valuePtr());
 }
 
+/*! Returns the list of lists. */
+const std::vector<List *> &Script::lists() const
+{
+    return impl->lists;
+}
+
 /*! Sets the list of lists. */
 void Script::setLists(const std::vector<List *> &lists)
 {
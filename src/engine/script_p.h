@@ -12,6 +12,8 @@ class Target;
 class IEngine;
 class Variable;
 class List;
+class Block;
+class Script;
 
 struct ScriptPrivate
 {
@@ -20,12 +22,16 @@ struct ScriptPrivate
 
         unsigned int *bytecode = nullptr;
         std::vector<unsigned int> bytecodeVector;
+        std::vector<Block *> bytecodeBlocks;
+        NativeScript nativeScript = nullptr;
+        size_t maxRegisterCount = 1024;
 
         Target *target = nullptr;
         IEngine *engine = nullptr;
 
         unsigned int **procedures = nullptr;
         std::vector<unsigned int *> proceduresVector;
+        std::vector<Script *> procedureScripts;
 
         BlockFunc *functions = nullptr;
         std::vector<BlockFunc> functionsVector;
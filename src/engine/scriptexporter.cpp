@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/scriptexporter.h>
+#include <scratchcpp/iengine.h>
+#include <scratchcpp/script.h>
+#include <scratchcpp/block.h>
+#include <scratchcpp/target.h>
+#include <scratchcpp/nativescriptapi.h>
+#include <algorithm>
+
+#include "scriptexporter_p.h"
+
+using namespace libscratchcpp;
+
+/*! The name of the function which registers the exported scripts. */
+const std::string ScriptExporter::registerFunctionName = "libscratchcpp_register_scripts";
+
+static const std::string header =
+    "// Generated by libscratchcpp, do not edit.\n"
+    "// The scripts are only registered if the library is compatible (see NativeScriptApi::version) and the bytecode hasn't changed.\n"
+    "\n"
+    "#include <scratchcpp/iengine.h>\n"
+    "#include <scratchcpp/script.h>\n"
+    "#include <scratchcpp/block.h>\n"
+    "#include <scratchcpp/target.h>\n"
+    "#include <scratchcpp/list.h>\n"
+    "#include <scratchcpp/virtualmachine.h>\n"
+    "#include <scratchcpp/nativescriptapi.h>\n"
+    "#include <algorithm>\n"
+    "#include <iostream>\n"
+    "\n"
+    "#define REG(index, count) NativeScriptApi::reg(vm, index, count)\n"
+    "#define LAST_REG() NativeScriptApi::reg(vm, 0, 1)\n"
+    "#define PUSH(value) NativeScriptApi::push(vm, value)\n"
+    "#define POP() NativeScriptApi::pop(vm, 1)\n"
+    "\n"
+    "using namespace libscratchcpp;\n";
+
+static std::string escape(const std::string &str)
+{
+    std::string ret;
+
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            ret.push_back('\\');
+
+        ret.push_back(c);
+    }
+
+    return ret;
+}
+
+/*!
+ * Constructs ScriptExporter.
+ * \param[in] engine The engine with compiled scripts (see IEngine::compile()).
+ */
+ScriptExporter::ScriptExporter(IEngine *engine) :
+    impl(spimpl::make_unique_impl<ScriptExporterPrivate>(engine))
+{
+}
+
+/*! Returns the engine. */
+IEngine *ScriptExporter::engine() const
+{
+    return impl->engine;
+}
+
+/*!
+ * Converts the bytecode of all compiled scripts to C++ functions and returns the source code.\n
+ * The source code must be compiled with the include directories of the library into a shared library
+ * or directly into the application. The scripts access the virtual machine through NativeScriptApi. Scripts are registered by calling
+ * the extern "C" function called registerFunctionName with the engine (after loading the same project):
+ * \code
+ * extern "C" void libscratchcpp_register_scripts(libscratchcpp::IEngine *engine);
+ * \endcode
+ * Scripts whose bytecode has changed aren't registered and no scripts are registered if the library isn't compatible
+ * (see NativeScriptApi::isCompatible()). Yield points (for example a function which stops the script)
+ * continue from the bytecode position, so the exported scripts can continue scripts started by the bytecode interpreter
+ * and procedures (custom blocks) run in the bytecode interpreter.
+ */
+std::string ScriptExporter::generate() const
+{
+    struct ExportedScript
+    {
+            std::string target;
+            std::string block;
+            const std::vector<unsigned int> *bytecode;
+    };
+
+    // Sort the scripts so that the source code doesn't depend on the order of the script map
+    std::vector<ExportedScript> scripts;
+
+    for (const auto &[block, script] : impl->engine->scripts()) {
+        if (script->target() && !script->bytecodeVector().empty())
+            scripts.push_back({ script->target()->name(), block->id(), &script->bytecodeVector() });
+    }
+
+    std::sort(scripts.begin(), scripts.end(), [](const ExportedScript &s1, const ExportedScript &s2) { return s1.target < s2.target || (s1.target == s2.target && s1.block < s2.block); });
+
+    std::string ret = header;
+
+    for (size_t i = 0; i < scripts.size(); i++) {
+        const std::vector<unsigned int> &bytecode = *scripts[i].bytecode;
+        ret += "\nstatic const unsigned int bytecode" + std::to_string(i) + "[] = { ";
+
+        for (size_t j = 0; j < bytecode.size(); j++)
+            ret += (j == 0 ? "" : ", ") + std::to_string(bytecode[j]);
+
+        ret += " };\n\n";
+        ret += ScriptExporterPrivate::generateScript(bytecode, "script" + std::to_string(i));
+    }
+
+    ret += "\nstruct ExportedScript\n{\n"
+           "        const char *target;\n"
+           "        const char *block;\n"
+           "        const unsigned int *bytecode;\n"
+           "        size_t size;\n"
+           "        NativeScript function;\n"
+           "};\n\n"
+           "static const ExportedScript scripts[] = {\n";
+
+    for (size_t i = 0; i < scripts.size(); i++) {
+        std::string index = std::to_string(i);
+        ret += "    { \"" + escape(scripts[i].target) + "\", \"" + escape(scripts[i].block) + "\", bytecode" + index + ", sizeof(bytecode" + index + ") / sizeof(unsigned int), &script" + index +
+               " },\n";
+    }
+
+    ret += "    { nullptr, nullptr, nullptr, 0, nullptr }\n"
+           "};\n\n"
+           "extern \"C\" void " +
+           registerFunctionName +
+           "(IEngine *engine)\n"
+           "{\n"
+           "    // The scripts were generated for this version of the API and the library must use the same layout of values and lists\n"
+           "    if (!NativeScriptApi::isCompatible(" +
+           std::to_string(NativeScriptApi::version) +
+           ", sizeof(Value), sizeof(List)))\n"
+           "        return;\n\n"
+           "    for (const auto &[block, script] : engine->scripts()) {\n"
+           "        const std::vector<unsigned int> &bytecode = script->bytecodeVector();\n\n"
+           "        for (const ExportedScript *exported = scripts; exported->function; exported++) {\n"
+           "            if (script->target() && (script->target()->name() == exported->target) && (block->id() == exported->block) && (bytecode.size() == exported->size) &&\n"
+           "                std::equal(bytecode.begin(), bytecode.end(), exported->bytecode))\n"
+           "                script->setNativeScript(exported->function);\n"
+           "        }\n"
+           "    }\n"
+           "}\n";
+
+    return ret;
+}
@@ -0,0 +1,470 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/virtualmachine.h>
+#include <unordered_set>
+#include <cassert>
+
+#include "scriptexporter_p.h"
+#include "virtualmachine_p.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+ScriptExporterPrivate::ScriptExporterPrivate(IEngine *engine) :
+    engine(engine)
+{
+}
+
+static std::string label(size_t pos)
+{
+    return "i" + std::to_string(pos);
+}
+
+// Returns the source code which stores the position and leaves the function
+static std::string leave(const std::string &pos, bool ret)
+{
+    return "*pos = " + pos + ";\n        return " + (ret ? "true" : "false") + ";\n";
+}
+
+std::string ScriptExporterPrivate::generateScript(const std::vector<unsigned int> &bytecode, const std::string &name)
+{
+    // Find the instructions (the script ends with the first OP_HALT outside of if statements and loops)
+    std::vector<size_t> positions;
+    std::unordered_set<size_t> instructions;
+    size_t depth = 0;
+    size_t pos = 0;
+
+    while (pos < bytecode.size()) {
+        unsigned int opcode = bytecode[pos];
+        assert(opcode < VirtualMachinePrivate::instruction_count);
+        positions.push_back(pos);
+        instructions.insert(pos);
+
+        if (opcode == OP_HALT && depth == 0)
+            break;
+
+        switch (opcode) {
+            case OP_IF:
+            case OP_IF_VAR_EQ_CONST:
+            case OP_FOREVER_LOOP:
+            case OP_REPEAT_LOOP:
+            case OP_UNTIL_LOOP:
+                depth++;
+                break;
+
+            case OP_ENDIF:
+            case OP_LOOP_END:
+                depth--;
+                break;
+
+            default:
+                break;
+        }
+
+        pos += VirtualMachinePrivate::instruction_arg_count[opcode] + 1;
+    }
+
+    // The function continues after the given position in the bytecode
+    std::string body = "    switch (*pos + 1 - bytecode) {\n";
+
+    for (size_t pos : positions)
+        body += "        case " + std::to_string(pos) + ":\n            goto " + label(pos) + ";\n";
+
+    body += "        default:\n            return false;\n    }\n";
+
+    std::vector<size_t> loops; // positions of the loop instructions of the current loops
+
+    for (size_t pos : positions) {
+        unsigned int opcode = bytecode[pos];
+        size_t lastArg = pos + VirtualMachinePrivate::instruction_arg_count[opcode];
+        std::string arg = lastArg > pos ? std::to_string(bytecode[pos + 1]) : "";
+        std::string next = label(lastArg + 1);
+        std::string code;
+
+        // OP_IF, OP_ELSE, OP_IF_VAR_EQ_CONST, OP_REPEAT_LOOP and OP_UNTIL_LOOP jump after the last argument plus the offset in the last argument
+        size_t jumpTarget = lastArg + bytecode[lastArg] + 1;
+        bool validJump = instructions.find(jumpTarget) != instructions.cend();
+        std::string target = label(jumpTarget);
+
+        switch (opcode) {
+            case OP_HALT:
+                code = "NativeScriptApi::halt(vm);\n        " + leave("bytecode + " + std::to_string(pos), true);
+                break;
+
+            case OP_CONST:
+                code = "PUSH(constValues[" + arg + "]);\n";
+                break;
+
+            case OP_NULL:
+                code = "PUSH(Value());\n";
+                break;
+
+            case OP_CHECKPOINT:
+                code = "NativeScriptApi::setCheckpoint(vm, bytecode + " + std::to_string(pos - 1) + ");\n";
+                break;
+
+            case OP_IF:
+                if (validJump)
+                    code = "bool condition = LAST_REG()->toBool();\n        POP();\n\n        if (!condition)\n            goto " + target + ";\n";
+                break;
+
+            case OP_ELSE:
+                if (validJump)
+                    code = "goto " + target + ";\n";
+                break;
+
+            case OP_START:
+            case OP_ENDIF:
+                code = "\n";
+                break;
+
+            case OP_FOREVER_LOOP:
+                code = "NativeScriptApi::beginLoop(vm, true, bytecode + " + std::to_string(pos) + ", static_cast<size_t>(-1), 0);\n";
+                loops.push_back(pos);
+                break;
+
+            case OP_REPEAT_LOOP:
+                if (validJump) {
+                    code = "size_t count = LAST_REG()->toLong();\n        POP();\n\n        if (count == 0)\n            goto " + target +
+                           ";\n\n        NativeScriptApi::beginLoop(vm, true, bytecode + " + std::to_string(pos + 1) + ", 0, count);\n";
+                }
+
+                loops.push_back(pos);
+                break;
+
+            case OP_REPEAT_LOOP_INDEX:
+                code = "PUSH(static_cast<long>(NativeScriptApi::loopIndex(vm)));\n";
+                break;
+
+            case OP_REPEAT_LOOP_INDEX1:
+                code = "PUSH(static_cast<long>(NativeScriptApi::loopIndex(vm) + 1));\n";
+                break;
+
+            case OP_UNTIL_LOOP:
+                if (validJump)
+                    code = "NativeScriptApi::beginLoop(vm, false, bytecode + " + std::to_string(pos + 1) + ", 0, 0);\n";
+
+                loops.push_back(pos);
+                break;
+
+            case OP_BEGIN_UNTIL_LOOP: {
+                assert(!loops.empty());
+                size_t loopArg = loops.back() + 1;
+                size_t loopTarget = loopArg + bytecode[loopArg] + 1;
+
+                if (instructions.find(loopTarget) != instructions.cend()) {
+                    code = "bool condition = LAST_REG()->toBool();\n        POP();\n\n        if (condition) {\n            NativeScriptApi::popLoop(vm);\n            goto " + label(loopTarget) +
+                           ";\n        }\n";
+                }
+
+                break;
+            }
+
+            case OP_LOOP_END: {
+                // Loops continue after the loop instruction
+                assert(!loops.empty());
+                size_t loop = loops.back();
+                loops.pop_back();
+                code = "unsigned int *yieldPos;\n"
+                       "        bool repeat = NativeScriptApi::endLoop(vm, bytecode + " +
+                       std::to_string(pos) +
+                       ", &yieldPos);\n\n"
+                       "        if (yieldPos) {\n"
+                       "            *pos = yieldPos;\n"
+                       "            return true;\n"
+                       "        }\n\n"
+                       "        if (repeat)\n"
+                       "            goto " +
+                       label(loop + VirtualMachinePrivate::instruction_arg_count[bytecode[loop]] + 1) + ";\n";
+                break;
+            }
+
+            case OP_PRINT:
+                code = "std::cout << LAST_REG()->toString() << std::endl;\n        POP();\n";
+                break;
+
+            case OP_ADD:
+            case OP_ADD_NUM:
+                code = "REG(0, 2)->add(*REG(1, 2));\n        POP();\n";
+                break;
+
+            case OP_SUBTRACT:
+            case OP_SUBTRACT_NUM:
+                code = "REG(0, 2)->subtract(*REG(1, 2));\n        POP();\n";
+                break;
+
+            case OP_MULTIPLY:
+            case OP_MULTIPLY_NUM:
+                code = "REG(0, 2)->multiply(*REG(1, 2));\n        POP();\n";
+                break;
+
+            case OP_DIVIDE:
+                code = "REG(0, 2)->divide(*REG(1, 2));\n        POP();\n";
+                break;
+
+            case OP_MOD:
+                code = "REG(0, 2)->mod(*REG(1, 2));\n        POP();\n";
+                break;
+
+            case OP_RANDOM:
+                code = "NativeScriptApi::randomNumber(REG(0, 2), REG(1, 2));\n        POP();\n";
+                break;
+
+            case OP_ROUND:
+                code = "NativeScriptApi::roundNumber(LAST_REG());\n";
+                break;
+
+            case OP_ABS:
+                code = "NativeScriptApi::absNumber(LAST_REG());\n";
+                break;
+
+            case OP_FLOOR:
+                code = "NativeScriptApi::floorNumber(LAST_REG());\n";
+                break;
+
+            case OP_CEIL:
+                code = "NativeScriptApi::ceilNumber(LAST_REG());\n";
+                break;
+
+            case OP_SQRT:
+                code = "NativeScriptApi::sqrtNumber(LAST_REG());\n";
+                break;
+
+            case OP_SIN:
+                code = "NativeScriptApi::sinNumber(LAST_REG());\n";
+                break;
+
+            case OP_COS:
+                code = "NativeScriptApi::cosNumber(LAST_REG());\n";
+                break;
+
+            case OP_TAN:
+                code = "NativeScriptApi::tanNumber(LAST_REG());\n";
+                break;
+
+            case OP_ASIN:
+                code = "NativeScriptApi::asinNumber(LAST_REG());\n";
+                break;
+
+            case OP_ACOS:
+                code = "NativeScriptApi::acosNumber(LAST_REG());\n";
+                break;
+
+            case OP_ATAN:
+                code = "NativeScriptApi::atanNumber(LAST_REG());\n";
+                break;
+
+            case OP_GREATER_THAN:
+            case OP_GREATER_THAN_NUM:
+                code = "*REG(0, 2) = *REG(0, 2) > *REG(1, 2);\n        POP();\n";
+                break;
+
+            case OP_LESS_THAN:
+            case OP_LESS_THAN_NUM:
+                code = "*REG(0, 2) = *REG(0, 2) < *REG(1, 2);\n        POP();\n";
+                break;
+
+            case OP_EQUALS:
+            case OP_EQUALS_NUM:
+                code = "*REG(0, 2) = *REG(0, 2) == *REG(1, 2);\n        POP();\n";
+                break;
+
+            case OP_AND:
+                code = "*REG(0, 2) = REG(0, 2)->toBool() && REG(1, 2)->toBool();\n        POP();\n";
+                break;
+
+            case OP_OR:
+                code = "*REG(0, 2) = REG(0, 2)->toBool() || REG(1, 2)->toBool();\n        POP();\n";
+                break;
+
+            case OP_NOT:
+                code = "*LAST_REG() = !LAST_REG()->toBool();\n";
+                break;
+
+            case OP_SET_VAR:
+                code = "*variables[" + arg + "] = *LAST_REG();\n        POP();\n";
+                break;
+
+            case OP_CHANGE_VAR:
+                code = "variables[" + arg + "]->add(*LAST_REG());\n        POP();\n";
+                break;
+
+            case OP_READ_VAR:
+                code = "PUSH(*variables[" + arg + "]);\n";
+                break;
+
+            case OP_READ_LIST:
+                code = "PUSH(lists[" + arg + "]->toString());\n";
+                break;
+
+            case OP_LIST_APPEND:
+                code = "lists[" + arg + "]->push_back(*LAST_REG());\n        POP();\n";
+                break;
+
+            case OP_LIST_DEL:
+                code = "NativeScriptApi::deleteListItem(lists[" + arg + "], LAST_REG());\n        POP();\n";
+                break;
+
+            case OP_LIST_DEL_ALL:
+                code = "lists[" + arg + "]->clear();\n";
+                break;
+
+            case OP_LIST_INSERT:
+                code = "NativeScriptApi::insertListItem(lists[" + arg + "], REG(0, 2), REG(1, 2));\n        NativeScriptApi::pop(vm, 2);\n";
+                break;
+
+            case OP_LIST_REPLACE:
+                code = "NativeScriptApi::replaceListItem(lists[" + arg + "], REG(0, 2), REG(1, 2));\n        NativeScriptApi::pop(vm, 2);\n";
+                break;
+
+            case OP_LIST_GET_ITEM:
+                code = "List *list = lists[" + arg +
+                       "];\n"
+                       "        size_t index = NativeScriptApi::listIndex(LAST_REG(), list);\n\n"
+                       "        if (index == 0)\n"
+                       "            *LAST_REG() = \"\";\n"
+                       "        else\n"
+                       "            *LAST_REG() = list->operator[](index - 1);\n";
+                break;
+
+            case OP_LIST_INDEX_OF:
+                code = "*LAST_REG() = static_cast<long>(lists[" + arg + "]->indexOf(*LAST_REG()) + 1);\n";
+                break;
+
+            case OP_LIST_LENGTH:
+                code = "PUSH(static_cast<long>(lists[" + arg + "]->size()));\n";
+                break;
+
+            case OP_LIST_CONTAINS:
+                code = "*LAST_REG() = lists[" + arg + "]->contains(*LAST_REG());\n";
+                break;
+
+            case OP_STR_CONCAT:
+                code = "*REG(0, 2) = REG(0, 2)->toString() + REG(1, 2)->toString();\n        POP();\n";
+                break;
+
+            case OP_STR_AT:
+                code = "*REG(0, 2) = REG(0, 2)->utf16At(REG(1, 2)->toLong() - 1);\n        POP();\n";
+                break;
+
+            case OP_STR_LENGTH:
+                code = "*LAST_REG() = static_cast<long>(LAST_REG()->utf16Size());\n";
+                break;
+
+            case OP_STR_CONTAINS:
+                code = "*REG(0, 2) = REG(0, 2)->toString().find(REG(1, 2)->toString()) != std::string::npos;\n        POP();\n";
+                break;
+
+            case OP_EXEC:
+                // Moving to a checkpoint and going back continue in the bytecode interpreter
+                code = "unsigned int *p;\n\n"
+                       "        switch (NativeScriptApi::exec(vm, " +
+                       arg + ", bytecode + " + std::to_string(pos + 1) +
+                       ", &p)) {\n"
+                       "            case NativeScriptApi::ExecResult::Continue:\n"
+                       "                break;\n"
+                       "            case NativeScriptApi::ExecResult::Yield:\n"
+                       "                *pos = p;\n"
+                       "                return true;\n"
+                       "            default:\n"
+                       "                *pos = p;\n"
+                       "                return false;\n"
+                       "        }\n";
+                break;
+
+            case OP_INIT_PROCEDURE:
+                code = "NativeScriptApi::initProcedure(vm);\n";
+                break;
+
+            case OP_ADD_ARG:
+                code = "NativeScriptApi::addArg(vm);\n";
+                break;
+
+            case OP_READ_ARG:
+                code = "PUSH(NativeScriptApi::arg(vm, " + arg + "));\n";
+                break;
+
+            case OP_BREAK_FRAME:
+                code = "NativeScriptApi::breakFrame(vm);\n";
+                break;
+
+            case OP_WARP:
+                code = "NativeScriptApi::warp(vm);\n";
+                break;
+
+            case OP_CHANGE_VAR_CONST:
+                code = "variables[" + arg + "]->add(constValues[" + std::to_string(bytecode[pos + 2]) + "]);\n";
+                break;
+
+            case OP_IF_VAR_EQ_CONST:
+                if (validJump)
+                    code = "if (!(*variables[" + arg + "] == constValues[" + std::to_string(bytecode[pos + 2]) + "]))\n            goto " + target + ";\n";
+                break;
+
+            case OP_LIST_GET_VAR_INDEX:
+                code = "List *list = lists[" + arg +
+                       "];\n"
+                       "        size_t index = NativeScriptApi::listIndex(variables[" +
+                       std::to_string(bytecode[pos + 2]) +
+                       "], list);\n\n"
+                       "        if (index == 0)\n"
+                       "            PUSH(\"\");\n"
+                       "        else\n"
+                       "            PUSH(list->operator[](index - 1));\n";
+                break;
+
+            case OP_READ_INLINE_ARG:
+                code = "PUSH(NativeScriptApi::inlineArg(vm, " + arg + "));\n";
+                break;
+
+            case OP_FREE_INLINE_ARGS:
+                code = "NativeScriptApi::freeInlineArgs(vm, " + arg + ");\n";
+                break;
+
+            case OP_EQUALS_VAR:
+                code = "*LAST_REG() = *LAST_REG() == *variables[" + arg + "];\n";
+                break;
+
+            case OP_GREATER_THAN_VAR:
+                code = "*LAST_REG() = *LAST_REG() > *variables[" + arg + "];\n";
+                break;
+
+            case OP_LESS_THAN_VAR:
+                code = "*LAST_REG() = *LAST_REG() < *variables[" + arg + "];\n";
+                break;
+
+            case OP_STR_CONCAT_VAR:
+                code = "*LAST_REG() = LAST_REG()->toString() + variables[" + arg + "]->toString();\n";
+                break;
+
+            case OP_VAR_APPEND_STR:
+                code = "variables[" + arg + "]->append(*LAST_REG());\n        POP();\n";
+                break;
+
+            default:
+                // Procedure calls (OP_CALL_PROCEDURE and OP_TAIL_CALL) run in the bytecode interpreter
+                break;
+        }
+
+        if (code.empty())
+            code = leave("bytecode + " + std::to_string(pos - 1), false);
+
+        body += "\n" + label(pos) + ": {\n        " + code + "    }\n";
+    }
+
+    // Only read the arrays which are used (to avoid unused variable warnings)
+    std::string ret = "static bool " + name + "(VirtualMachine *vm, unsigned int **pos)\n{\n";
+    ret += "    unsigned int *bytecode = vm->bytecode();\n";
+
+    if (body.find("constValues[") != std::string::npos)
+        ret += "    const Value *constValues = vm->constValues();\n";
+
+    if (body.find("variables[") != std::string::npos)
+        ret += "    Value **variables = vm->variables();\n";
+
+    if (body.find("lists[") != std::string::npos)
+        ret += "    List **lists = vm->lists();\n";
+
+    ret += "\n" + body + "}\n";
+    return ret;
+}
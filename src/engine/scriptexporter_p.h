@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace libscratchcpp
+{
+
+class IEngine;
+class Script;
+
+struct ScriptExporterPrivate
+{
+        ScriptExporterPrivate(IEngine *engine);
+        ScriptExporterPrivate(const ScriptExporterPrivate &) = delete;
+
+        static std::string generateScript(const std::vector<unsigned int> &bytecode, const std::string &name);
+
+        IEngine *engine = nullptr;
+};
+
+} // namespace libscratchcpp
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include <scratchcpp/tracer.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+
+#include "tracer_p.h"
+
+using namespace libscratchcpp;
+
+/*! Constructs Tracer. */
+Tracer::Tracer() :
+    impl(spimpl::make_unique_impl<TracerPrivate>())
+{
+}
+
+/*! Returns true if the engine records events. */
+bool Tracer::enabled() const
+{
+    return impl->enabled;
+}
+
+/*! Sets whether the engine records events. The event buffer is allocated when the tracer is enabled for the first time. */
+void Tracer::setEnabled(bool enabled)
+{
+    impl->enabled = enabled;
+
+    if (enabled && impl->events.empty())
+        impl->allocate();
+}
+
+/*! Returns the maximum number of events. When the buffer is full, the oldest events are overwritten. */
+size_t Tracer::capacity() const
+{
+    return impl->capacity;
+}
+
+/*! Sets the maximum number of events (the default is 10000). This removes all recorded events. */
+void Tracer::setCapacity(size_t capacity)
+{
+    impl->capacity = std::max(capacity, static_cast<size_t>(1));
+    impl->events.clear();
+
+    if (impl->enabled)
+        impl->allocate();
+}
+
+/*! Returns the number of events in the buffer. */
+size_t Tracer::eventCount() const
+{
+    return std::min(impl->count, impl->events.size());
+}
+
+/*! Removes all recorded events. */
+void Tracer::clear()
+{
+    impl->next = 0;
+    impl->count = 0;
+}
+
+/*!
+ * Returns the recorded events in the Chrome trace event format, which can be opened in chrome://tracing or in Perfetto.
+ * Events are complete events ("ph": "X") with the time in microseconds, the details (for example the name of the target) are in "args".
+ */
+std::string Tracer::toJson() const
+{
+    nlohmann::json events = nlohmann::json::array();
+    size_t count = eventCount();
+    size_t first = impl->count > impl->events.size() ? impl->next : 0; // the oldest event
+
+    for (size_t i = 0; i < count; i++) {
+        const auto &event = impl->events[(first + i) % impl->events.size()];
+        nlohmann::json json;
+        json["name"] = event.name;
+        json["cat"] = "engine";
+        json["ph"] = "X";
+        json["ts"] = std::chrono::duration<double, std::micro>(event.start.time_since_epoch()).count();
+        json["dur"] = std::chrono::duration<double, std::micro>(event.duration).count();
+        json["pid"] = 1;
+        json["tid"] = 1;
+
+        if (!event.detail.empty())
+            json["args"]["name"] = event.detail;
+
+        events.push_back(json);
+    }
+
+    nlohmann::json ret;
+    ret["traceEvents"] = events;
+    ret["displayTimeUnit"] = "ms";
+    return ret.dump();
+}
+
+/*! Records an event (span) with the given name (which must be a string literal) and details. This is called by the engine. */
+void Tracer::addEvent(const char *name, const std::string &detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    if (impl->events.empty())
+        return;
+
+    auto &event = impl->events[impl->next];
+    event.name = name;
+    event.detail = detail;
+    event.start = start;
+    event.duration = end - start;
+    impl->next = (impl->next + 1) % impl->events.size();
+    impl->count++;
+}
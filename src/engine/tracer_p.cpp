@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#include "tracer_p.h"
+
+using namespace libscratchcpp;
+
+TracerPrivate::TracerPrivate()
+{
+}
+
+void TracerPrivate::allocate()
+{
+    // The events are allocated at once so that recording doesn't allocate memory (except for longer details)
+    events.resize(capacity, { nullptr, "", std::chrono::steady_clock::time_point(), std::chrono::steady_clock::duration::zero() });
+    next = 0;
+    count = 0;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+namespace libscratchcpp
+{
+
+struct TracerPrivate
+{
+        TracerPrivate();
+        TracerPrivate(const TracerPrivate &) = delete;
+
+        void allocate();
+
+        typedef struct
+        {
+                const char *name;
+                std::string detail;
+                std::chrono::steady_clock::time_point start;
+                std::chrono::steady_clock::duration duration;
+        } Event;
+
+        bool enabled = false;
+        size_t capacity = 10000;
+        std::vector<Event> events; // ring buffer, allocated when the tracer is enabled
+        size_t next = 0;           // the position of the next event
+        size_t count = 0;          // the number of recorded events (including overwritten events)
+};
+
+} // namespace libscratchcpp
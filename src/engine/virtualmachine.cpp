@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/profiler.h>
 #include <cassert>
 
 #include "virtualmachine_p.h"
+#include "internal/closurecode.h"
 
 using namespace libscratchcpp;
 using namespace vm;
@@ -30,24 +32,28 @@ void VirtualMachine::setProcedures(unsigned int **procedures)
 void VirtualMachine::setFunctions(BlockFunc *functions)
 {
     impl->functions = functions;
+    impl->clearPrecompiledCode();
 }
 
 /*! Sets the list of constant values. */
 void VirtualMachine::setConstValues(const Value *values)
 {
     impl->constValues = values;
+    impl->clearPrecompiledCode();
 }
 
 /*! Sets the list of variables. */
 void VirtualMachine::setVariables(Value **variables)
 {
     impl->variables = variables;
+    impl->clearPrecompiledCode();
 }
 
 /*! Sets the list of lists. */
 void VirtualMachine::setLists(List **lists)
 {
     impl->lists = lists;
+    impl->clearPrecompiledCode();
 }
 
 /*!
@@ -58,6 +64,7 @@ void VirtualMachine::setVariablesVector(const std::vector<Value *> &variables)
 {
     impl->variablesVector = variables;
     impl->variables = impl->variablesVector.data();
+    impl->clearPrecompiledCode();
 }
 
 /*!
@@ -68,6 +75,7 @@ void VirtualMachine::setListsVector(const std::vector<List *> &lists)
 {
     impl->listsVector = lists;
     impl->lists = impl->listsVector.data();
+    impl->clearPrecompiledCode();
 }
 
 /*! Sets the bytecode of the script. */
@@ -75,6 +83,16 @@ void VirtualMachine::setBytecode(unsigned int *code)
 {
     impl->bytecode = code;
     impl->pos = code;
+    impl->clearPrecompiledCode();
+}
+
+/*!
+ * Sets the native (exported to C++) function of the script, which runs instead of the bytecode.
+ * \see ScriptExporter
+ */
+void VirtualMachine::setNativeScript(NativeScript script)
+{
+    impl->nativeScript = script;
 }
 
 /*! Returns the array of procedures. */
@@ -113,6 +131,12 @@ unsigned int *VirtualMachine::bytecode() const
     return impl->bytecode;
 }
 
+/*! Returns the native function of the script. */
+NativeScript VirtualMachine::nativeScript() const
+{
+    return impl->nativeScript;
+}
+
 /*! Returns number of currently used registers. */
 size_t VirtualMachine::registerCount() const
 {
@@ -140,13 +164,16 @@ Script *VirtualMachine::script() const
 /*! Returns the register at the given index with the given argument (register) count. */
 const Value *VirtualMachine::getInput(unsigned int index, unsigned int argCount) const
 {
-    return impl->regs[impl->regCount - argCount + index];
+    return &impl->regs[impl->regCount - argCount + index];
 }
 
 /*! Adds the given value to registers. */
 void VirtualMachine::addReturnValue(const Value &v)
 {
-    *impl->regs[impl->regCount++] = v;
+    if (impl->regCount >= impl->regsVector.size())
+        impl->growRegisters();
+
+    impl->regs[impl->regCount++] = v;
 }
 
 /*!
@@ -158,15 +185,53 @@ void VirtualMachine::addReturnValue(const Value &v)
  */
 void VirtualMachine::replaceReturnValue(const Value &v, unsigned int offset)
 {
-    *impl->regs[impl->regCount - offset] = v;
+    impl->regs[impl->regCount - offset] = v;
 }
 
-/*! Continues running the script from last position (the first instruction is skipped). */
+/*!
+ * Continues running the script from last position (the first instruction is skipped).
+ * \note The bytecode is precompiled after the number of runs set by setPrecompileThreshold().
+ */
 void VirtualMachine::run()
 {
     impl->running = true;
+    impl->atEnd = false;
+    impl->noBreak = true;
+    impl->warp = impl->resumeWarp; // scripts stopped by the warp timer continue without screen refresh
+    impl->resumeWarp = false;
+    impl->warpTimerStarted = false;
+    impl->profileOpcodes = impl->profiler && impl->profiler->enabled();
+    impl->sampling = impl->profiler && impl->profiler->samplingEnabled();
+    impl->profiling = impl->profileOpcodes || impl->sampling;
+
+    if (impl->sampling) {
+        impl->sampleCountdown = impl->profiler->sampleInterval();
+        impl->lastSample = std::chrono::steady_clock::now();
+    }
+
+    if (!impl->closureCode && (impl->precompileThreshold > 0) && (++impl->runCount >= impl->precompileThreshold))
+        precompile();
+
+    unsigned int *ret;
+
+    // Procedures aren't precompiled or exported, so scripts which stopped in a procedure continue in the bytecode interpreter
+    if (impl->profiling) {
+        ret = impl->run(impl->pos);
+        impl->stopProfiling();
+
+        // The rest of the time belongs to the position where the script stopped
+        if (impl->sampling)
+            impl->takeSample(ret);
+    } else if (impl->nativeScript && impl->callTree.empty()) {
+        ret = impl->pos;
+
+        if (!impl->nativeScript(this, &ret))
+            ret = impl->run(ret);
+    } else {
+        const ClosureInstruction *instruction = (impl->closureCode && impl->callTree.empty()) ? impl->closureCode->instructionAt(impl->pos + 1) : nullptr;
+        ret = instruction ? impl->closureCode->run(impl.get(), instruction) : impl->run(impl->pos);
+    }
 
-    unsigned int *ret = impl->run(impl->pos);
     assert(ret);
 
     if (impl->savePos)
@@ -175,12 +240,79 @@ void VirtualMachine::run()
     impl->running = false;
 }
 
+/*!
+ * Translates the bytecode to a list of instructions with resolved operands (variables, lists, constant values and functions),
+ * which run without decoding the bytecode. Instructions which aren't supported by the precompiled code (such as procedure calls)
+ * run in the bytecode interpreter.
+ * \note The precompiled code is removed when the bytecode or any of the operand arrays changes.
+ */
+void VirtualMachine::precompile()
+{
+    assert(impl->bytecode);
+    impl->closureCode = std::make_unique<ClosureCode>(impl.get());
+}
+
+/*! Returns true if the bytecode has been precompiled. */
+bool VirtualMachine::isPrecompiled() const
+{
+    return impl->closureCode != nullptr;
+}
+
+/*! Returns the number of runs after which the bytecode is precompiled. */
+unsigned int VirtualMachine::precompileThreshold() const
+{
+    return impl->precompileThreshold;
+}
+
+/*!
+ * Sets the number of runs after which the bytecode is precompiled (see precompile()).
+ * Use 0 to disable automatic precompilation.
+ */
+void VirtualMachine::setPrecompileThreshold(unsigned int threshold)
+{
+    impl->precompileThreshold = threshold;
+}
+
+/*! Returns the maximum time (in milliseconds) the script can run without screen refresh before it yields. */
+int VirtualMachine::warpTime() const
+{
+    return impl->warpTime;
+}
+
+/*!
+ * Sets the maximum time (in milliseconds) the script can run without screen refresh (see vm::OP_WARP) before it yields.
+ * The script continues without screen refresh when it runs again. Use 0 to disable the limit.
+ */
+void VirtualMachine::setWarpTime(int time)
+{
+    impl->warpTime = time;
+}
+
+/*! Returns the profiler which records the executed instructions. */
+Profiler *VirtualMachine::profiler() const
+{
+    return impl->profiler;
+}
+
+/*!
+ * Sets the profiler which records the executed instructions (if it's enabled, see Profiler::setEnabled()).
+ * \note While profiling, the script runs in the bytecode interpreter.
+ */
+void VirtualMachine::setProfiler(Profiler *profiler)
+{
+    impl->profiler = profiler;
+}
+
 /*! Jumps back to the initial position. */
 void VirtualMachine::reset()
 {
     assert(impl->bytecode);
     impl->pos = impl->bytecode;
     impl->atEnd = false;
+    impl->callTree.clear();
+    impl->procedureArgCount = 0;
+    impl->procedureArgBase = 0;
+    impl->resumeWarp = false;
 
     if (!impl->running) // Registers will be freed when the script stops running
         impl->regCount = 0;
@@ -4,26 +4,25 @@
 #include <scratchcpp/iengine.h>
 #include <scratchcpp/value.h>
 #include <scratchcpp/list.h>
+#include <scratchcpp/script.h>
+#include <scratchcpp/profiler.h>
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 
 #include "virtualmachine_p.h"
 #include "internal/randomgenerator.h"
+#include "internal/clock.h"
+#include "internal/closurecode.h"
 
-#define DISPATCH() goto *dispatch_table[*++pos]
+#define DISPATCH() goto *table[*++pos]
 #define FREE_REGS(count) regCount -= count
-#define ADD_RET_VALUE(value)                                                                                                                                                                           \
-    if (regCount + 1 >= regsVector.size()) {                                                                                                                                                           \
-        regsVector.reserve(regsVector.size() + 1024);                                                                                                                                                  \
-        for (size_t i = 0; i < 1024; i++)                                                                                                                                                              \
-            regsVector.push_back(new Value());                                                                                                                                                         \
-        regs = regsVector.data();                                                                                                                                                                      \
-    }                                                                                                                                                                                                  \
-    *regs[regCount++] = value
-#define REPLACE_RET_VALUE(value, offset) *regs[regCount - offset] = value
+#define ADD_RET_VALUE(value) regs[regCount++] = value
+#define REPLACE_RET_VALUE(value, offset) regs[regCount - offset] = value
 #define GET_NEXT_ARG() constValues[*++pos]
-#define READ_REG(index, count) regs[regCount - count + index]
-#define READ_LAST_REG() regs[regCount - 1]
+#define JUMP() pos += *++pos
+#define READ_REG(index, count) (regs + regCount - count + index)
+#define READ_LAST_REG() (regs + regCount - 1)
 
 #define FIX_LIST_INDEX(index, listSize)                                                                                                                                                                \
     if ((listSize == 0) || (index < 1) || (index > listSize))                                                                                                                                          \
@@ -35,6 +34,7 @@ using namespace vm;
 static const double pi = std::acos(-1); // TODO: Use std::numbers::pi in C++20
 
 IRandomGenerator *VirtualMachinePrivate::rng = nullptr;
+IClock *VirtualMachinePrivate::clock = nullptr;
 
 const unsigned int VirtualMachinePrivate::instruction_arg_count[] = {
     0, // OP_START
@@ -42,14 +42,14 @@ const unsigned int VirtualMachinePrivate::instruction_arg_count[] = {
     1, // OP_CONST
     0, // OP_NULL
     0, // OP_CHECKPOINT
-    0, // OP_IF
-    0, // OP_ELSE
+    1, // OP_IF
+    1, // OP_ELSE
     0, // OP_ENDIF
     0, // OP_FOREVER_LOOP
-    0, // OP_REPEAT_LOOP
+    1, // OP_REPEAT_LOOP
     0, // OP_REPEAT_LOOP_INDEX
     0, // OP_REPEAT_LOOP_INDEX1
-    0, // OP_UNTIL_LOOP
+    1, // OP_UNTIL_LOOP
     0, // OP_BEGIN_UNTIL_LOOP
     0, // OP_LOOP_END
     0, // OP_PRINT
@@ -99,33 +99,394 @@ const unsigned int VirtualMachinePrivate::instruction_arg_count[] = {
     0, // OP_ADD_ARG
     1, // OP_READ_ARG
     0, // OP_BREAK_FRAME
-    0  // OP_WARP
+    0, // OP_WARP
+    2, // OP_CHANGE_VAR_CONST
+    3, // OP_IF_VAR_EQ_CONST
+    2, // OP_LIST_GET_VAR_INDEX
+    1, // OP_READ_INLINE_ARG
+    1, // OP_FREE_INLINE_ARGS
+    1, // OP_TAIL_CALL
+    0, // OP_ADD_NUM
+    0, // OP_SUBTRACT_NUM
+    0, // OP_MULTIPLY_NUM
+    0, // OP_GREATER_THAN_NUM
+    0, // OP_LESS_THAN_NUM
+    0, // OP_EQUALS_NUM
+    1, // OP_EQUALS_VAR
+    1, // OP_GREATER_THAN_VAR
+    1, // OP_LESS_THAN_VAR
+    1, // OP_STR_CONCAT_VAR
+    1  // OP_VAR_APPEND_STR
+};
+
+// Number of registers read by the instruction
+const unsigned int VirtualMachinePrivate::instruction_input_count[] = {
+    0, // OP_START
+    0, // OP_HALT
+    0, // OP_CONST
+    0, // OP_NULL
+    0, // OP_CHECKPOINT
+    1, // OP_IF
+    0, // OP_ELSE
+    0, // OP_ENDIF
+    0, // OP_FOREVER_LOOP
+    1, // OP_REPEAT_LOOP
+    0, // OP_REPEAT_LOOP_INDEX
+    0, // OP_REPEAT_LOOP_INDEX1
+    0, // OP_UNTIL_LOOP
+    1, // OP_BEGIN_UNTIL_LOOP
+    0, // OP_LOOP_END
+    1, // OP_PRINT
+    2, // OP_ADD
+    2, // OP_SUBTRACT
+    2, // OP_MULTIPLY
+    2, // OP_DIVIDE
+    2, // OP_MOD
+    2, // OP_RANDOM
+    1, // OP_ROUND
+    1, // OP_ABS
+    1, // OP_FLOOR
+    1, // OP_CEIL
+    1, // OP_SQRT
+    1, // OP_SIN
+    1, // OP_COS
+    1, // OP_TAN
+    1, // OP_ASIN
+    1, // OP_ACOS
+    1, // OP_ATAN
+    2, // OP_GREATER_THAN
+    2, // OP_LESS_THAN
+    2, // OP_EQUALS
+    2, // OP_AND
+    2, // OP_OR
+    1, // OP_NOT
+    1, // OP_SET_VAR
+    1, // OP_CHANGE_VAR
+    0, // OP_READ_VAR
+    0, // OP_READ_LIST
+    1, // OP_LIST_APPEND
+    1, // OP_LIST_DEL
+    0, // OP_LIST_DEL_ALL
+    2, // OP_LIST_INSERT
+    2, // OP_LIST_REPLACE
+    1, // OP_LIST_GET_ITEM
+    1, // OP_LIST_INDEX_OF
+    0, // OP_LIST_LENGTH
+    1, // OP_LIST_CONTAINS
+    2, // OP_STR_CONCAT
+    2, // OP_STR_AT
+    1, // OP_STR_LENGTH
+    2, // OP_STR_CONTAINS
+    0, // OP_EXEC (depends on the function)
+    0, // OP_INIT_PROCEDURE
+    0, // OP_CALL_PROCEDURE
+    1, // OP_ADD_ARG
+    0, // OP_READ_ARG
+    0, // OP_BREAK_FRAME
+    0, // OP_WARP
+    0, // OP_CHANGE_VAR_CONST
+    0, // OP_IF_VAR_EQ_CONST
+    0, // OP_LIST_GET_VAR_INDEX
+    0, // OP_READ_INLINE_ARG
+    0, // OP_FREE_INLINE_ARGS
+    0, // OP_TAIL_CALL
+    2, // OP_ADD_NUM
+    2, // OP_SUBTRACT_NUM
+    2, // OP_MULTIPLY_NUM
+    2, // OP_GREATER_THAN_NUM
+    2, // OP_LESS_THAN_NUM
+    2, // OP_EQUALS_NUM
+    1, // OP_EQUALS_VAR
+    1, // OP_GREATER_THAN_VAR
+    1, // OP_LESS_THAN_VAR
+    1, // OP_STR_CONCAT_VAR
+    1  // OP_VAR_APPEND_STR
+};
+
+// Change of the number of used registers (OP_EXEC depends on the function, so the upper bound is used)
+const int VirtualMachinePrivate::instruction_reg_effect[] = {
+    0,  // OP_START
+    0,  // OP_HALT
+    1,  // OP_CONST
+    1,  // OP_NULL
+    0,  // OP_CHECKPOINT
+    -1, // OP_IF
+    0,  // OP_ELSE
+    0,  // OP_ENDIF
+    0,  // OP_FOREVER_LOOP
+    -1, // OP_REPEAT_LOOP
+    1,  // OP_REPEAT_LOOP_INDEX
+    1,  // OP_REPEAT_LOOP_INDEX1
+    0,  // OP_UNTIL_LOOP
+    -1, // OP_BEGIN_UNTIL_LOOP
+    0,  // OP_LOOP_END
+    -1, // OP_PRINT
+    -1, // OP_ADD
+    -1, // OP_SUBTRACT
+    -1, // OP_MULTIPLY
+    -1, // OP_DIVIDE
+    -1, // OP_MOD
+    -1, // OP_RANDOM
+    0,  // OP_ROUND
+    0,  // OP_ABS
+    0,  // OP_FLOOR
+    0,  // OP_CEIL
+    0,  // OP_SQRT
+    0,  // OP_SIN
+    0,  // OP_COS
+    0,  // OP_TAN
+    0,  // OP_ASIN
+    0,  // OP_ACOS
+    0,  // OP_ATAN
+    -1, // OP_GREATER_THAN
+    -1, // OP_LESS_THAN
+    -1, // OP_EQUALS
+    -1, // OP_AND
+    -1, // OP_OR
+    0,  // OP_NOT
+    -1, // OP_SET_VAR
+    -1, // OP_CHANGE_VAR
+    1,  // OP_READ_VAR
+    1,  // OP_READ_LIST
+    -1, // OP_LIST_APPEND
+    -1, // OP_LIST_DEL
+    0,  // OP_LIST_DEL_ALL
+    -2, // OP_LIST_INSERT
+    -2, // OP_LIST_REPLACE
+    0,  // OP_LIST_GET_ITEM
+    0,  // OP_LIST_INDEX_OF
+    1,  // OP_LIST_LENGTH
+    0,  // OP_LIST_CONTAINS
+    -1, // OP_STR_CONCAT
+    -1, // OP_STR_AT
+    0,  // OP_STR_LENGTH
+    -1, // OP_STR_CONTAINS
+    1,  // OP_EXEC (at most one return value)
+    0,  // OP_INIT_PROCEDURE
+    0,  // OP_CALL_PROCEDURE
+    -1, // OP_ADD_ARG
+    1,  // OP_READ_ARG
+    0,  // OP_BREAK_FRAME
+    0,  // OP_WARP
+    0,  // OP_CHANGE_VAR_CONST
+    0,  // OP_IF_VAR_EQ_CONST
+    1,  // OP_LIST_GET_VAR_INDEX
+    1,  // OP_READ_INLINE_ARG
+    0,  // OP_FREE_INLINE_ARGS
+    0,  // OP_TAIL_CALL
+    -1, // OP_ADD_NUM
+    -1, // OP_SUBTRACT_NUM
+    -1, // OP_MULTIPLY_NUM
+    -1, // OP_GREATER_THAN_NUM
+    -1, // OP_LESS_THAN_NUM
+    -1, // OP_EQUALS_NUM
+    0,  // OP_EQUALS_VAR
+    0,  // OP_GREATER_THAN_VAR
+    0,  // OP_LESS_THAN_VAR
+    0,  // OP_STR_CONCAT_VAR
+    -1  // OP_VAR_APPEND_STR
+};
+
+const char *VirtualMachinePrivate::instruction_names[] = {
+    "OP_START",
+    "OP_HALT",
+    "OP_CONST",
+    "OP_NULL",
+    "OP_CHECKPOINT",
+    "OP_IF",
+    "OP_ELSE",
+    "OP_ENDIF",
+    "OP_FOREVER_LOOP",
+    "OP_REPEAT_LOOP",
+    "OP_REPEAT_LOOP_INDEX",
+    "OP_REPEAT_LOOP_INDEX1",
+    "OP_UNTIL_LOOP",
+    "OP_BEGIN_UNTIL_LOOP",
+    "OP_LOOP_END",
+    "OP_PRINT",
+    "OP_ADD",
+    "OP_SUBTRACT",
+    "OP_MULTIPLY",
+    "OP_DIVIDE",
+    "OP_MOD",
+    "OP_RANDOM",
+    "OP_ROUND",
+    "OP_ABS",
+    "OP_FLOOR",
+    "OP_CEIL",
+    "OP_SQRT",
+    "OP_SIN",
+    "OP_COS",
+    "OP_TAN",
+    "OP_ASIN",
+    "OP_ACOS",
+    "OP_ATAN",
+    "OP_GREATER_THAN",
+    "OP_LESS_THAN",
+    "OP_EQUALS",
+    "OP_AND",
+    "OP_OR",
+    "OP_NOT",
+    "OP_SET_VAR",
+    "OP_CHANGE_VAR",
+    "OP_READ_VAR",
+    "OP_READ_LIST",
+    "OP_LIST_APPEND",
+    "OP_LIST_DEL",
+    "OP_LIST_DEL_ALL",
+    "OP_LIST_INSERT",
+    "OP_LIST_REPLACE",
+    "OP_LIST_GET_ITEM",
+    "OP_LIST_INDEX_OF",
+    "OP_LIST_LENGTH",
+    "OP_LIST_CONTAINS",
+    "OP_STR_CONCAT",
+    "OP_STR_AT",
+    "OP_STR_LENGTH",
+    "OP_STR_CONTAINS",
+    "OP_EXEC",
+    "OP_INIT_PROCEDURE",
+    "OP_CALL_PROCEDURE",
+    "OP_ADD_ARG",
+    "OP_READ_ARG",
+    "OP_BREAK_FRAME",
+    "OP_WARP",
+    "OP_CHANGE_VAR_CONST",
+    "OP_IF_VAR_EQ_CONST",
+    "OP_LIST_GET_VAR_INDEX",
+    "OP_READ_INLINE_ARG",
+    "OP_FREE_INLINE_ARGS",
+    "OP_TAIL_CALL",
+    "OP_ADD_NUM",
+    "OP_SUBTRACT_NUM",
+    "OP_MULTIPLY_NUM",
+    "OP_GREATER_THAN_NUM",
+    "OP_LESS_THAN_NUM",
+    "OP_EQUALS_NUM",
+    "OP_EQUALS_VAR",
+    "OP_GREATER_THAN_VAR",
+    "OP_LESS_THAN_VAR",
+    "OP_STR_CONCAT_VAR",
+    "OP_VAR_APPEND_STR",
 };
 
+const size_t VirtualMachinePrivate::instruction_count = sizeof(instruction_arg_count) / sizeof(instruction_arg_count[0]);
+
+static_assert(sizeof(VirtualMachinePrivate::instruction_input_count) / sizeof(unsigned int) == sizeof(VirtualMachinePrivate::instruction_arg_count) / sizeof(unsigned int));
+static_assert(sizeof(VirtualMachinePrivate::instruction_reg_effect) / sizeof(int) == sizeof(VirtualMachinePrivate::instruction_arg_count) / sizeof(unsigned int));
+static_assert(sizeof(VirtualMachinePrivate::instruction_names) / sizeof(const char *) == sizeof(VirtualMachinePrivate::instruction_arg_count) / sizeof(unsigned int));
+
 VirtualMachinePrivate::VirtualMachinePrivate(VirtualMachine *vm, Target *target, IEngine *engine, Script *script) :
     vm(vm),
     target(target),
     engine(engine),
     script(script)
 {
-    regsVector.reserve(1024);
-    for (int i = 0; i < 1024; i++)
-        regsVector.push_back(new Value());
+    // All registers are allocated at once, scripts compiled by the engine only get as many as they need
+    regsVector.resize(script ? script->maxRegisterCount() : 1024);
     regs = regsVector.data();
     loops.reserve(256);
     callTree.reserve(1024);
 
     if (!rng)
         rng = RandomGenerator::instance().get();
+
+    if (!clock)
+        clock = Clock::instance().get();
 }
 
 VirtualMachinePrivate::~VirtualMachinePrivate()
 {
-    for (int i = 0; i < regsVector.size(); i++)
-        delete regsVector[i];
 }
 
-unsigned int *VirtualMachinePrivate::run(unsigned int *pos, bool reset)
+bool VirtualMachinePrivate::checkWarpTimer()
+{
+    auto now = clock->currentSteadyTime();
+
+    // The timer starts with the first check in each run
+    if (!warpTimerStarted) {
+        warpTimerStarted = true;
+        warpStart = now;
+        return false;
+    }
+
+    if (now - warpStart < std::chrono::milliseconds(warpTime))
+        return false;
+
+    // Continue without screen refresh in the next run
+    resumeWarp = true;
+    savePos = true;
+    return true;
+}
+
+void VirtualMachinePrivate::stopProfiling()
+{
+    if (!profiledInstruction)
+        return;
+
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profileStart);
+    profiler->addOpcode(*profiledInstruction, time);
+
+    if (*profiledInstruction == OP_EXEC)
+        profiler->addFunction(functions[profiledInstruction[1]], time);
+
+    profiledInstruction = nullptr;
+}
+
+// Adds the script and the block at the given position in the script to the sampled stack
+static void addSampleFrame(std::vector<Block *> &stack, Script *script, const unsigned int *pos)
+{
+    if (!script)
+        return;
+
+    // The first instruction belongs to the top level block
+    Block *topBlock = script->blockAt(script->bytecode());
+    Block *block = script->blockAt(pos);
+
+    if (topBlock)
+        stack.push_back(topBlock);
+
+    if (block && block != topBlock)
+        stack.push_back(block);
+}
+
+void VirtualMachinePrivate::takeSample(unsigned int *pos)
+{
+    auto now = std::chrono::steady_clock::now();
+    sampleCountdown = profiler->sampleInterval();
+
+    // The stack contains the script and the calls of procedures (the return position is in the bytecode of the caller)
+    sampleStack.clear();
+    Script *owner = script;
+    const std::vector<Script *> *procedureScripts = script ? &script->procedureScripts() : nullptr;
+
+    for (const CallFrame &frame : callTree) {
+        addSampleFrame(sampleStack, owner, frame.returnPos);
+        owner = (procedureScripts && frame.procedure < procedureScripts->size()) ? (*procedureScripts)[frame.procedure] : nullptr;
+    }
+
+    addSampleFrame(sampleStack, owner, pos);
+
+    if (!sampleStack.empty())
+        profiler->addSample(sampleStack, std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastSample));
+
+    lastSample = now;
+}
+
+// Registers are sized by the compiler, but functions (for example from extensions) may add more values than expected
+void VirtualMachinePrivate::growRegisters()
+{
+    regsVector.resize(regsVector.size() + 1024);
+    regs = regsVector.data();
+}
+
+void VirtualMachinePrivate::clearPrecompiledCode()
+{
+    closureCode.reset();
+    runCount = 0;
+}
+
+unsigned int *VirtualMachinePrivate::run(unsigned int *pos)
 {
     static const void *dispatch_table[] = {
         nullptr,
@@ -190,37 +551,59 @@ unsigned int *VirtualMachinePrivate::run(unsigned int *pos, bool reset)
         &&do_add_arg,
         &&do_read_arg,
         &&do_break_frame,
-        &&do_warp
+        &&do_warp,
+        &&do_change_var_const,
+        &&do_if_var_eq_const,
+        &&do_list_get_var_index,
+        &&do_read_inline_arg,
+        &&do_free_inline_args,
+        &&do_tail_call,
+        &&do_add_num,
+        &&do_subtract_num,
+        &&do_multiply_num,
+        &&do_greater_than_num,
+        &&do_less_than_num,
+        &&do_equals_num,
+        &&do_equals_var,
+        &&do_greater_than_var,
+        &&do_less_than_var,
+        &&do_str_concat_var,
+        &&do_var_append_str
     };
+    // When profiling, all instructions go through do_profile, so the profiler doesn't slow down the other scripts
+    static const void *profile_table[sizeof(dispatch_table) / sizeof(dispatch_table[0])] = { nullptr };
+    if (!profile_table[0])
+        std::fill(std::begin(profile_table), std::end(profile_table), &&do_profile);
+    const void *const *table = profiling ? profile_table : dispatch_table;
     assert(pos);
-    unsigned int *loopStart;
-    unsigned int *loopEnd;
     size_t loopCount;
-    if (reset) {
-        atEnd = false;
-        noBreak = true;
-        warp = false;
-    }
     DISPATCH();
 
-do_halt:
-    if (regCount > 0) {
-        std::cout << "warning: VM: " << regCount << " registers were leaked by the script; this is most likely a bug in the VM or in the compiler" << std::endl;
+do_profile:
+    stopProfiling();
+    if (sampling && --sampleCountdown == 0)
+        takeSample(pos);
+    if (profileOpcodes) {
+        profiledInstruction = pos;
+        profileStart = std::chrono::steady_clock::now();
     }
+    goto *dispatch_table[*pos];
+
+do_halt:
     if (callTree.empty()) {
         atEnd = true;
+        procedureArgCount = 0;
+        procedureArgBase = 0;
         return pos;
     } else {
         if (callTree.size() == 1)
             warp = false;
 
-        pos = callTree.back();
+        const CallFrame &frame = callTree.back();
+        pos = frame.returnPos;
+        procedureArgCount = procedureArgBase;
+        procedureArgBase = frame.argBase;
         callTree.pop_back();
-        procedureArgTree.pop_back();
-        if (procedureArgTree.empty())
-            procedureArgs = nullptr;
-        else
-            procedureArgs = &procedureArgTree.back();
         DISPATCH();
     }
 
@@ -237,16 +620,15 @@ do_checkpoint:
     DISPATCH();
 
 do_if:
-    if (!READ_LAST_REG()->toBool()) {
-        while (*pos != OP_ELSE && *pos != OP_ENDIF)
-            pos += instruction_arg_count[*pos++];
-    }
+    if (!READ_LAST_REG()->toBool())
+        JUMP();
+    else
+        pos++;
     FREE_REGS(1);
     DISPATCH();
 
 do_else:
-    while (*pos != OP_ENDIF)
-        pos += instruction_arg_count[*pos++];
+    JUMP();
 
 do_endif:
     DISPATCH();
@@ -262,15 +644,12 @@ do_forever_loop:
 do_repeat_loop:
     loopCount = READ_LAST_REG()->toLong();
     FREE_REGS(1);
-    if (loopCount <= 0) {
-        loopEnd = pos;
-        while (*loopEnd != OP_LOOP_END)
-            loopEnd += instruction_arg_count[*loopEnd++];
-        pos = loopEnd;
-    } else {
+    if (loopCount <= 0)
+        JUMP();
+    else {
         Loop l;
         l.isRepeatLoop = true;
-        l.start = pos;
+        l.start = ++pos;
         l.index = 0;
         l.max = loopCount;
         loops.push_back(l);
@@ -293,24 +672,23 @@ do_repeat_loop_index1 : {
     DISPATCH();
 }
 
-do_until_loop:
-    loopStart = run(pos, false);
-    if (!READ_LAST_REG()->toBool()) {
-        Loop l;
-        l.isRepeatLoop = false;
-        l.start = pos;
-        loops.push_back(l);
-        pos = loopStart;
-    } else {
-        pos = loopStart;
-        while (*pos != OP_LOOP_END)
-            pos += instruction_arg_count[*pos++];
-    }
-    FREE_REGS(1);
+do_until_loop : {
+    // The condition is evaluated by the following instructions, OP_BEGIN_UNTIL_LOOP jumps out of the loop
+    Loop l;
+    l.isRepeatLoop = false;
+    l.start = ++pos;
+    loops.push_back(l);
     DISPATCH();
+}
 
 do_begin_until_loop:
-    return pos;
+    if (READ_LAST_REG()->toBool()) {
+        pos = loops.back().start;
+        pos += *pos;
+        loops.pop_back();
+    }
+    FREE_REGS(1);
+    DISPATCH();
 
 do_loop_end : {
     Loop &l = loops.back();
@@ -319,20 +697,11 @@ do_loop_end : {
             pos = l.start;
         else
             loops.pop_back();
-        if (!noBreak && !warp)
-            return pos;
-        DISPATCH();
-    } else {
-        if (!noBreak && !warp)
-            return pos - 1;
-        loopStart = run(l.start, false);
-        if (!READ_LAST_REG()->toBool())
-            pos = loopStart;
-        else
-            loops.pop_back();
-        FREE_REGS(1);
-        DISPATCH();
-    }
+    } else
+        pos = l.start; // evaluate the condition again
+    if (warp ? warpTimeout() : !noBreak)
+        return pos;
+    DISPATCH();
 }
 
 do_print:
@@ -366,122 +735,53 @@ do_mod:
     DISPATCH();
 
 do_random:
-    if ((READ_REG(0, 2)->type() == Value::Type::Integer) && (READ_REG(1, 2)->type() == Value::Type::Integer))
-        REPLACE_RET_VALUE(rng->randint(READ_REG(0, 2)->toInt(), READ_REG(1, 2)->toInt()), 2);
-    else
-        REPLACE_RET_VALUE(rng->randintDouble(READ_REG(0, 2)->toDouble(), READ_REG(1, 2)->toDouble()), 2);
+    randomNumber(READ_REG(0, 2), READ_REG(1, 2));
     FREE_REGS(1);
     DISPATCH();
 
-do_round : {
-    const Value *v = READ_REG(0, 1);
-    if (!v->isInfinity() && !v->isNegativeInfinity()) {
-        if (v->toDouble() < 0) {
-            REPLACE_RET_VALUE(static_cast<long>(std::floor(v->toDouble() + 0.5)), 1);
-        } else
-            REPLACE_RET_VALUE(static_cast<long>(v->toDouble() + 0.5), 1);
-    }
+do_round:
+    roundNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_abs : {
-    const Value *v = READ_REG(0, 1);
-    if (v->isNegativeInfinity())
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::Infinity), 1);
-    else if (!v->isInfinity())
-        REPLACE_RET_VALUE(std::abs(v->toDouble()), 1);
+do_abs:
+    absNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_floor : {
-    const Value *v = READ_REG(0, 1);
-    if (!v->isInfinity() && !v->isNegativeInfinity())
-        REPLACE_RET_VALUE(std::floor(v->toDouble()), 1);
+do_floor:
+    floorNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_ceil : {
-    const Value *v = READ_REG(0, 1);
-    if (!v->isInfinity() && !v->isNegativeInfinity())
-        REPLACE_RET_VALUE(std::ceil(v->toDouble()), 1);
+do_ceil:
+    ceilNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_sqrt : {
-    const Value &v = *READ_REG(0, 1);
-    if (v < 0)
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::NaN), 1);
-    else if (!v.isInfinity())
-        REPLACE_RET_VALUE(std::sqrt(v.toDouble()), 1);
+do_sqrt:
+    sqrtNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_sin : {
-    const Value *v = READ_REG(0, 1);
-    if (v->isInfinity() || v->isNegativeInfinity())
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::NaN), 1);
-    else
-        REPLACE_RET_VALUE(std::sin(v->toDouble() * pi / 180), 1);
+do_sin:
+    sinNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_cos : {
-    const Value *v = READ_REG(0, 1);
-    if (v->isInfinity() || v->isNegativeInfinity())
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::NaN), 1);
-    else
-        REPLACE_RET_VALUE(std::cos(v->toDouble() * pi / 180), 1);
+do_cos:
+    cosNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_tan : {
-    const Value *v = READ_REG(0, 1);
-    if (v->isInfinity() || v->isNegativeInfinity())
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::NaN), 1);
-    else {
-        long mod;
-        if (v->toLong() < 0)
-            mod = (v->toLong() + 360) % 360;
-        else
-            mod = v->toLong() % 360;
-        if (mod == 90)
-            REPLACE_RET_VALUE(Value(Value::SpecialValue::Infinity), 1);
-        else if (mod == 270)
-            REPLACE_RET_VALUE(Value(Value::SpecialValue::NegativeInfinity), 1);
-        else
-            REPLACE_RET_VALUE(std::tan(v->toDouble() * pi / 180), 1);
-    }
+do_tan:
+    tanNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_asin : {
-    const Value &v = *READ_REG(0, 1);
-    if (v < -1 || v > 1)
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::NaN), 1);
-    else
-        REPLACE_RET_VALUE(std::asin(v.toDouble()) * 180 / pi, 1);
+do_asin:
+    asinNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_acos : {
-    const Value &v = *READ_REG(0, 1);
-    if (v < -1 || v > 1)
-        REPLACE_RET_VALUE(Value(Value::SpecialValue::NaN), 1);
-    else
-        REPLACE_RET_VALUE(std::acos(v.toDouble()) * 180 / pi, 1);
+do_acos:
+    acosNumber(READ_LAST_REG());
     DISPATCH();
-}
 
-do_atan : {
-    const Value &v = *READ_REG(0, 1);
-    if (v.isInfinity())
-        REPLACE_RET_VALUE(90, 1);
-    else if (v.isNegativeInfinity())
-        REPLACE_RET_VALUE(-90, 1);
-    else
-        REPLACE_RET_VALUE(std::atan(v.toDouble()) * 180 / pi, 1);
+do_atan:
+    atanNumber(READ_LAST_REG());
     DISPATCH();
-}
 
 do_greater_than:
     REPLACE_RET_VALUE(*READ_REG(0, 2) > *READ_REG(1, 2), 2);
@@ -535,104 +835,28 @@ do_list_append:
     FREE_REGS(1);
     DISPATCH();
 
-do_list_del : {
-    const Value *indexValue = READ_LAST_REG();
-    size_t index;
-    List *list = lists[*++pos];
-    if (indexValue->isString()) {
-        const std::string &str = indexValue->toString();
-        if (str == "last") {
-            index = list->size();
-        } else if (str == "all") {
-            list->clear();
-            index = 0;
-        } else if (str == "random") {
-            size_t size = list->size();
-            index = size == 0 ? 0 : rng->randint(1, size);
-        } else
-            index = 0;
-    } else {
-        index = indexValue->toLong();
-        FIX_LIST_INDEX(index, list->size());
-    }
-    if (index != 0)
-        list->removeAt(index - 1);
+do_list_del:
+    deleteListItem(lists[*++pos], READ_LAST_REG());
     FREE_REGS(1);
     DISPATCH();
-}
 
 do_list_del_all:
     lists[*++pos]->clear();
     DISPATCH();
 
-do_list_insert : {
-    const Value *indexValue = READ_REG(1, 2);
-    size_t index;
-    List *list = lists[*++pos];
-    if (indexValue->isString()) {
-        const std::string &str = indexValue->toString();
-        if (str == "last") {
-            list->push_back(*READ_REG(0, 2));
-            index = 0;
-        } else if (str == "random") {
-            size_t size = list->size();
-            index = size == 0 ? 1 : rng->randint(1, size);
-        } else
-            index = 0;
-    } else {
-        index = indexValue->toLong();
-        FIX_LIST_INDEX(index, list->size());
-    }
-    if ((index != 0) || list->empty()) {
-        if (list->empty())
-            list->push_back(*READ_REG(0, 2));
-        else
-            list->insert(index - 1, *READ_REG(0, 2));
-    }
+do_list_insert:
+    insertListItem(lists[*++pos], READ_REG(0, 2), READ_REG(1, 2));
     FREE_REGS(2);
     DISPATCH();
-}
 
-do_list_replace : {
-    const Value *indexValue = READ_REG(0, 2);
-    size_t index;
-    List *list = lists[*++pos];
-    if (indexValue->isString()) {
-        std::string str = indexValue->toString();
-        if (str == "last")
-            index = list->size();
-        else if (str == "random") {
-            size_t size = list->size();
-            index = size == 0 ? 0 : rng->randint(1, size);
-        } else
-            index = 0;
-    } else {
-        index = indexValue->toLong();
-        FIX_LIST_INDEX(index, list->size());
-    }
-    if (index != 0)
-        list->operator[](index - 1) = *READ_REG(1, 2);
+do_list_replace:
+    replaceListItem(lists[*++pos], READ_REG(0, 2), READ_REG(1, 2));
     FREE_REGS(2);
     DISPATCH();
-}
 
 do_list_get_item : {
-    const Value *indexValue = READ_LAST_REG();
-    size_t index;
     List *list = lists[*++pos];
-    if (indexValue->isString()) {
-        std::string str = indexValue->toString();
-        if (str == "last")
-            index = list->size();
-        else if (str == "random") {
-            size_t size = list->size();
-            index = size == 0 ? 0 : rng->randint(1, size);
-        } else
-            index = 0;
-    } else {
-        index = indexValue->toLong();
-        FIX_LIST_INDEX(index, list->size());
-    }
+    size_t index = getListIndex(READ_LAST_REG(), list);
     if (index == 0) {
         REPLACE_RET_VALUE("", 1);
     } else {
@@ -662,23 +886,18 @@ do_str_concat:
 
 do_str_at : {
     size_t index = READ_REG(1, 2)->toLong() - 1;
-    {
-        std::u16string str = READ_REG(0, 2)->toUtf16();
-        if (index < 0 || index >= str.size())
-            REPLACE_RET_VALUE("", 2);
-        else
-            REPLACE_RET_VALUE(utf8::utf16to8(std::u16string({ str[index] })), 2);
-        FREE_REGS(1);
-    }
+    REPLACE_RET_VALUE(READ_REG(0, 2)->utf16At(index), 2);
+    FREE_REGS(1);
     DISPATCH();
 }
 
 do_str_length:
-    REPLACE_RET_VALUE(static_cast<long>(READ_REG(0, 1)->toUtf16().size()), 1);
+    REPLACE_RET_VALUE(static_cast<long>(READ_REG(0, 1)->utf16Size()), 1);
     DISPATCH();
 
 do_str_contains:
-    REPLACE_RET_VALUE(READ_REG(0, 2)->toUtf16().find(READ_REG(1, 2)->toUtf16()) != std::u16string::npos, 2);
+    // Substrings of valid UTF-8 strings always start at character boundaries, so there's no need to convert the strings to UTF-16
+    REPLACE_RET_VALUE(READ_REG(0, 2)->toString().find(READ_REG(1, 2)->toString()) != std::string::npos, 2);
     FREE_REGS(1);
     DISPATCH();
 
@@ -690,10 +909,6 @@ do_exec : {
     }
     if (stop) {
         stop = false;
-        callTree.clear();
-        procedureArgTree.clear();
-        procedureArgs = nullptr;
-        nextProcedureArgs = nullptr;
         if (goBack) {
             goBack = false;
             pos -= instruction_arg_count[OP_EXEC] + 1;
@@ -702,7 +917,13 @@ do_exec : {
         } else
             FREE_REGS(ret);
 
-        if (!warp) // TODO: This should always return if there's a "warp timer" enabled
+        if (!warp) {
+            callTree.clear(); // procedure arguments are kept, inlined procedures read them when the script continues
+            return pos;
+        }
+
+        // Scripts without screen refresh only stop when the warp timer runs out (the call tree is kept, they continue in the next run)
+        if (warpTimeout())
             return pos;
 
         DISPATCH(); // this avoids freeing registers after "stopping" a warp script
@@ -712,26 +933,28 @@ do_exec : {
 }
 
 do_init_procedure:
-    procedureArgTree.push_back({});
-    if (procedureArgTree.size() >= 2)
-        procedureArgs = &procedureArgTree[procedureArgTree.size() - 2];
-    nextProcedureArgs = &procedureArgTree.back();
+    // The arguments of the called procedure are added on top of the arguments of the caller
+    nextProcedureArgBase = procedureArgCount;
     DISPATCH();
 
 do_call_procedure:
-    callTree.push_back(++pos);
-    procedureArgs = nextProcedureArgs;
-    nextProcedureArgs = nullptr;
+    callTree.push_back({ ++pos, procedureArgBase, *pos });
+    procedureArgBase = nextProcedureArgBase;
     pos = procedures[*pos];
     DISPATCH();
 
 do_add_arg:
-    nextProcedureArgs->push_back(*READ_LAST_REG());
+    if (procedureArgCount < procedureArgs.size())
+        procedureArgs[procedureArgCount] = *READ_LAST_REG();
+    else
+        procedureArgs.push_back(*READ_LAST_REG());
+
+    procedureArgCount++;
     FREE_REGS(1);
     DISPATCH();
 
 do_read_arg:
-    ADD_RET_VALUE(procedureArgs->operator[](*++pos));
+    ADD_RET_VALUE(procedureArgs[procedureArgBase + *++pos]);
     DISPATCH();
 
 do_break_frame:
@@ -741,4 +964,302 @@ do_break_frame:
 do_warp:
     warp = true;
     DISPATCH();
+
+do_change_var_const : {
+    Value *var = variables[*++pos];
+    var->add(GET_NEXT_ARG());
+    DISPATCH();
+}
+
+do_if_var_eq_const : {
+    const Value *var = variables[*++pos];
+    if (*var == GET_NEXT_ARG())
+        pos++;
+    else
+        JUMP();
+    DISPATCH();
+}
+
+do_list_get_var_index : {
+    List *list = lists[*++pos];
+    size_t index = getListIndex(variables[*++pos], list);
+    if (index == 0) {
+        ADD_RET_VALUE("");
+    } else {
+        ADD_RET_VALUE(list->operator[](index - 1));
+    }
+    DISPATCH();
+}
+
+do_read_inline_arg:
+    ADD_RET_VALUE(procedureArgs[procedureArgCount - *++pos]);
+    DISPATCH();
+
+do_free_inline_args:
+    procedureArgCount -= *++pos;
+    DISPATCH();
+
+do_tail_call: {
+    // Reuse the frame of the current procedure (the call tree doesn't grow)
+    size_t argCount = procedureArgCount - nextProcedureArgBase;
+
+    for (size_t i = 0; i < argCount; i++)
+        procedureArgs[procedureArgBase + i] = procedureArgs[nextProcedureArgBase + i];
+
+    procedureArgCount = procedureArgBase + argCount;
+    ++pos;
+
+    if (!callTree.empty())
+        callTree.back().procedure = *pos;
+
+    pos = procedures[*pos];
+    DISPATCH();
+}
+
+do_add_num:
+    addNumbers(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    DISPATCH();
+
+do_subtract_num:
+    subtractNumbers(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    DISPATCH();
+
+do_multiply_num:
+    multiplyNumbers(READ_REG(0, 2), READ_REG(1, 2));
+    FREE_REGS(1);
+    DISPATCH();
+
+do_greater_than_num:
+    REPLACE_RET_VALUE(numberGreaterThan(READ_REG(0, 2), READ_REG(1, 2)), 2);
+    FREE_REGS(1);
+    DISPATCH();
+
+do_less_than_num:
+    REPLACE_RET_VALUE(numberLessThan(READ_REG(0, 2), READ_REG(1, 2)), 2);
+    FREE_REGS(1);
+    DISPATCH();
+
+do_equals_num:
+    REPLACE_RET_VALUE(numbersEqual(READ_REG(0, 2), READ_REG(1, 2)), 2);
+    FREE_REGS(1);
+    DISPATCH();
+
+do_equals_var:
+    REPLACE_RET_VALUE(*READ_LAST_REG() == *variables[*++pos], 1);
+    DISPATCH();
+
+do_greater_than_var:
+    REPLACE_RET_VALUE(*READ_LAST_REG() > *variables[*++pos], 1);
+    DISPATCH();
+
+do_less_than_var:
+    REPLACE_RET_VALUE(*READ_LAST_REG() < *variables[*++pos], 1);
+    DISPATCH();
+
+do_str_concat_var:
+    REPLACE_RET_VALUE(READ_LAST_REG()->toString() + variables[*++pos]->toString(), 1);
+    DISPATCH();
+
+do_var_append_str:
+    variables[*++pos]->append(*READ_LAST_REG());
+    FREE_REGS(1);
+    DISPATCH();
+}
+
+size_t VirtualMachinePrivate::getListIndex(const Value *indexValue, List *list)
+{
+    size_t index;
+    if (indexValue->isString()) {
+        const std::string &str = indexValue->toString();
+        if (str == "last")
+            index = list->size();
+        else if (str == "random") {
+            size_t size = list->size();
+            index = size == 0 ? 0 : rng->randint(1, size);
+        } else
+            index = 0;
+    } else {
+        index = indexValue->toLong();
+        FIX_LIST_INDEX(index, list->size());
+    }
+    return index;
+}
+
+void VirtualMachinePrivate::randomNumber(Value *v1, const Value *v2)
+{
+    if ((v1->type() == Value::Type::Integer) && (v2->type() == Value::Type::Integer))
+        *v1 = rng->randint(v1->toInt(), v2->toInt());
+    else
+        *v1 = rng->randintDouble(v1->toDouble(), v2->toDouble());
+}
+
+void VirtualMachinePrivate::roundNumber(Value *v)
+{
+    if (!v->isInfinity() && !v->isNegativeInfinity()) {
+        if (v->toDouble() < 0)
+            *v = static_cast<long>(std::floor(v->toDouble() + 0.5));
+        else
+            *v = static_cast<long>(v->toDouble() + 0.5);
+    }
+}
+
+void VirtualMachinePrivate::absNumber(Value *v)
+{
+    if (v->isNegativeInfinity())
+        *v = Value(Value::SpecialValue::Infinity);
+    else if (!v->isInfinity())
+        *v = std::abs(v->toDouble());
+}
+
+void VirtualMachinePrivate::floorNumber(Value *v)
+{
+    if (!v->isInfinity() && !v->isNegativeInfinity())
+        *v = std::floor(v->toDouble());
+}
+
+void VirtualMachinePrivate::ceilNumber(Value *v)
+{
+    if (!v->isInfinity() && !v->isNegativeInfinity())
+        *v = std::ceil(v->toDouble());
+}
+
+void VirtualMachinePrivate::sqrtNumber(Value *v)
+{
+    if (*v < 0)
+        *v = Value(Value::SpecialValue::NaN);
+    else if (!v->isInfinity())
+        *v = std::sqrt(v->toDouble());
+}
+
+void VirtualMachinePrivate::sinNumber(Value *v)
+{
+    if (v->isInfinity() || v->isNegativeInfinity())
+        *v = Value(Value::SpecialValue::NaN);
+    else
+        *v = std::sin(v->toDouble() * pi / 180);
+}
+
+void VirtualMachinePrivate::cosNumber(Value *v)
+{
+    if (v->isInfinity() || v->isNegativeInfinity())
+        *v = Value(Value::SpecialValue::NaN);
+    else
+        *v = std::cos(v->toDouble() * pi / 180);
+}
+
+void VirtualMachinePrivate::tanNumber(Value *v)
+{
+    if (v->isInfinity() || v->isNegativeInfinity()) {
+        *v = Value(Value::SpecialValue::NaN);
+        return;
+    }
+
+    long mod;
+    if (v->toLong() < 0)
+        mod = (v->toLong() + 360) % 360;
+    else
+        mod = v->toLong() % 360;
+
+    if (mod == 90)
+        *v = Value(Value::SpecialValue::Infinity);
+    else if (mod == 270)
+        *v = Value(Value::SpecialValue::NegativeInfinity);
+    else
+        *v = std::tan(v->toDouble() * pi / 180);
+}
+
+void VirtualMachinePrivate::asinNumber(Value *v)
+{
+    if (*v < -1 || *v > 1)
+        *v = Value(Value::SpecialValue::NaN);
+    else
+        *v = std::asin(v->toDouble()) * 180 / pi;
+}
+
+void VirtualMachinePrivate::acosNumber(Value *v)
+{
+    if (*v < -1 || *v > 1)
+        *v = Value(Value::SpecialValue::NaN);
+    else
+        *v = std::acos(v->toDouble()) * 180 / pi;
+}
+
+void VirtualMachinePrivate::atanNumber(Value *v)
+{
+    if (v->isInfinity())
+        *v = 90;
+    else if (v->isNegativeInfinity())
+        *v = -90;
+    else
+        *v = std::atan(v->toDouble()) * 180 / pi;
+}
+
+void VirtualMachinePrivate::deleteListItem(List *list, const Value *indexValue)
+{
+    size_t index;
+    if (indexValue->isString()) {
+        const std::string &str = indexValue->toString();
+        if (str == "last") {
+            index = list->size();
+        } else if (str == "all") {
+            list->clear();
+            index = 0;
+        } else if (str == "random") {
+            size_t size = list->size();
+            index = size == 0 ? 0 : rng->randint(1, size);
+        } else
+            index = 0;
+    } else {
+        index = indexValue->toLong();
+        FIX_LIST_INDEX(index, list->size());
+    }
+    if (index != 0)
+        list->removeAt(index - 1);
+}
+
+void VirtualMachinePrivate::insertListItem(List *list, const Value *item, const Value *indexValue)
+{
+    size_t index;
+    if (indexValue->isString()) {
+        const std::string &str = indexValue->toString();
+        if (str == "last") {
+            list->push_back(*item);
+            index = 0;
+        } else if (str == "random") {
+            size_t size = list->size();
+            index = size == 0 ? 1 : rng->randint(1, size);
+        } else
+            index = 0;
+    } else {
+        index = indexValue->toLong();
+        FIX_LIST_INDEX(index, list->size());
+    }
+    if ((index != 0) || list->empty()) {
+        if (list->empty())
+            list->push_back(*item);
+        else
+            list->insert(index - 1, *item);
+    }
+}
+
+void VirtualMachinePrivate::replaceListItem(List *list, const Value *indexValue, const Value *item)
+{
+    size_t index;
+    if (indexValue->isString()) {
+        std::string str = indexValue->toString();
+        if (str == "last")
+            index = list->size();
+        else if (str == "random") {
+            size_t size = list->size();
+            index = size == 0 ? 0 : rng->randint(1, size);
+        } else
+            index = 0;
+    } else {
+        index = indexValue->toLong();
+        FIX_LIST_INDEX(index, list->size());
+    }
+    if (index != 0)
+        list->operator[](index - 1) = *item;
 }
@@ -3,8 +3,10 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include <cstddef>
-#include <scratchcpp/global.h>
+#include <chrono>
+#include <scratchcpp/value.h>
 
 namespace libscratchcpp
 {
@@ -13,9 +15,12 @@ class VirtualMachine;
 class Target;
 class IEngine;
 class Script;
-class Value;
+class Block;
 class List;
 class IRandomGenerator;
+class IClock;
+class ClosureCode;
+class Profiler;
 
 struct VirtualMachinePrivate
 {
@@ -23,9 +28,73 @@ struct VirtualMachinePrivate
         VirtualMachinePrivate(const VirtualMachinePrivate &) = delete;
         ~VirtualMachinePrivate();
 
-        unsigned int *run(unsigned int *pos, bool reset = true);
+        unsigned int *run(unsigned int *pos);
+        void clearPrecompiledCode();
+        void growRegisters();
 
+        static size_t getListIndex(const Value *indexValue, List *list);
+
+        // Instructions without jumps or other state of the virtual machine, which are shared with the precompiled and the exported code
+        static void randomNumber(Value *v1, const Value *v2);
+        static void roundNumber(Value *v);
+        static void absNumber(Value *v);
+        static void floorNumber(Value *v);
+        static void ceilNumber(Value *v);
+        static void sqrtNumber(Value *v);
+        static void sinNumber(Value *v);
+        static void cosNumber(Value *v);
+        static void tanNumber(Value *v);
+        static void asinNumber(Value *v);
+        static void acosNumber(Value *v);
+        static void atanNumber(Value *v);
+        static void deleteListItem(List *list, const Value *indexValue);
+        static void insertListItem(List *list, const Value *item, const Value *indexValue);
+        static void replaceListItem(List *list, const Value *indexValue, const Value *item);
+
+        // The clock is only read every warpCheckInterval checks (loop iterations or stopped functions)
+        bool warpTimeout() { return (warpTime > 0) && (++warpCounter % warpCheckInterval == 0) && checkWarpTimer(); }
+        bool checkWarpTimer();
+
+        void stopProfiling();
+        void takeSample(unsigned int *pos);
+
+        // Operators for registers which are known to contain numbers (integers or decimal numbers, see the OP_*_NUM instructions),
+        // the results are the same as the results of the Value operators
+        static bool bothIntegers(const Value *v1, const Value *v2) { return v1->type() == Value::Type::Integer && v2->type() == Value::Type::Integer; }
+
+        static void addNumbers(Value *v1, const Value *v2)
+        {
+            if (bothIntegers(v1, v2))
+                *v1 = v1->toLong() + v2->toLong();
+            else
+                *v1 = v1->toDouble() + v2->toDouble();
+        }
+
+        static void subtractNumbers(Value *v1, const Value *v2)
+        {
+            if (bothIntegers(v1, v2))
+                *v1 = v1->toLong() - v2->toLong();
+            else
+                *v1 = v1->toDouble() - v2->toDouble();
+        }
+
+        static void multiplyNumbers(Value *v1, const Value *v2)
+        {
+            if (bothIntegers(v1, v2))
+                *v1 = v1->toLong() * v2->toLong();
+            else
+                *v1 = v1->toDouble() * v2->toDouble();
+        }
+
+        static bool numberGreaterThan(const Value *v1, const Value *v2) { return bothIntegers(v1, v2) ? v1->toLong() > v2->toLong() : v1->toDouble() > v2->toDouble(); }
+        static bool numberLessThan(const Value *v1, const Value *v2) { return bothIntegers(v1, v2) ? v1->toLong() < v2->toLong() : v1->toDouble() < v2->toDouble(); }
+        static bool numbersEqual(const Value *v1, const Value *v2) { return bothIntegers(v1, v2) ? v1->toLong() == v2->toLong() : v1->toDouble() == v2->toDouble(); }
+
+        static const size_t instruction_count;
         static const unsigned int instruction_arg_count[];
+        static const unsigned int instruction_input_count[];
+        static const int instruction_reg_effect[];
+        static const char *instruction_names[];
 
         typedef struct
         {
@@ -34,6 +103,13 @@ struct VirtualMachinePrivate
                 size_t index, max;
         } Loop;
 
+        typedef struct
+        {
+                unsigned int *returnPos;
+                size_t argBase;         // start of the caller's arguments in procedureArgs
+                unsigned int procedure; // index of the called procedure (used to find its script when sampling)
+        } CallFrame;
+
         unsigned int *bytecode = nullptr;
         std::vector<unsigned int> bytecodeVector;
 
@@ -46,10 +122,11 @@ struct VirtualMachinePrivate
         bool running = false;
         bool atEnd = false;
         std::vector<Loop> loops;
-        std::vector<unsigned int *> callTree;
-        std::vector<std::vector<Value>> procedureArgTree;
-        std::vector<Value> *procedureArgs = nullptr;
-        std::vector<Value> *nextProcedureArgs = nullptr;
+        std::vector<CallFrame> callTree;
+        std::vector<Value> procedureArgs; // arguments of all procedures in the call tree (never shrinks, so the values are reused)
+        size_t procedureArgCount = 0;
+        size_t procedureArgBase = 0;
+        size_t nextProcedureArgBase = 0;
         bool noBreak = true;
         bool warp = false;
         bool stop = false;
@@ -57,6 +134,23 @@ struct VirtualMachinePrivate
         bool goBack = false;
         bool updatePos = false;
 
+        static const unsigned int warpCheckInterval = 32;
+        int warpTime = 0;
+        unsigned int warpCounter = 0;
+        bool warpTimerStarted = false;
+        std::chrono::steady_clock::time_point warpStart;
+        bool resumeWarp = false;
+
+        Profiler *profiler = nullptr;
+        bool profiling = false;      // instructions run through do_profile
+        bool profileOpcodes = false; // count the executions and the time of the instructions
+        bool sampling = false;       // sample the running blocks
+        unsigned int *profiledInstruction = nullptr; // the instruction which is running
+        std::chrono::steady_clock::time_point profileStart;
+        unsigned int sampleCountdown = 0;
+        std::chrono::steady_clock::time_point lastSample;
+        std::vector<Block *> sampleStack; // reused by all samples
+
         unsigned int **procedures = nullptr;
         BlockFunc *functions = nullptr;
         const Value *constValues = nullptr;
@@ -65,11 +159,19 @@ struct VirtualMachinePrivate
         List **lists = nullptr;
         std::vector<List *> listsVector;
 
-        Value **regs = nullptr;
-        std::vector<Value *> regsVector;
+        Value *regs = nullptr;
+        std::vector<Value> regsVector;
         size_t regCount = 0;
 
+        NativeScript nativeScript = nullptr;
+        std::unique_ptr<ClosureCode> closureCode;
+        unsigned int precompileThreshold = 10;
+        unsigned int runCount = 0;
+        unsigned int *closureExitPos = nullptr;
+        bool closureFallback = false;
+
         static IRandomGenerator *rng;
+        static IClock *clock;
 };
 
 } // namespace libscratchcpp
@@ -32,6 +32,7 @@ class IProjectReader
         virtual std::vector<std::shared_ptr<Target>> targets() = 0;
         virtual std::vector<std::shared_ptr<Broadcast>> broadcasts() = 0;
         virtual std::vector<std::string> extensions() = 0;
+        virtual std::string hash() = 0; // identifies the content of the project (used for the bytecode cache)
 
     protected:
         virtual void printErr(const std::string &errStr) final { std::cerr << "Failed to read project: " << errStr << std::endl; }
@@ -11,6 +11,8 @@
 #include <scratchcpp/sound.h>
 #include <scratchcpp/stage.h>
 #include <scratchcpp/sprite.h>
+#include <cstdio>
+#include <cstdint>
 
 #include "scratch3reader.h"
 #include "reader_common.h"
@@ -341,6 +343,7 @@ bool Scratch3Reader::isValid()
 void Scratch3Reader::clear()
 {
     m_json = "";
+    m_hash.clear();
     m_targets.clear();
     m_broadcasts.clear();
     m_extensions.clear();
@@ -361,6 +364,14 @@ std::vector<std::string> Scratch3Reader::extensions()
     return m_extensions;
 }
 
+std::string Scratch3Reader::hash()
+{
+    if (m_json == "")
+        read();
+
+    return m_hash;
+}
+
 void Scratch3Reader::read()
 {
     // Read project.json
@@ -368,7 +379,20 @@ void Scratch3Reader::read()
     if (m_zipReader->open()) {
         // Parse the JSON
         try {
-            m_json = json::parse(m_zipReader->readFileToString("project.json"));
+            std::string str = m_zipReader->readFileToString("project.json");
+            m_json = json::parse(str);
+
+            // 64-bit FNV-1a hash of project.json
+            uint64_t hash = 14695981039346656037ULL;
+
+            for (unsigned char c : str) {
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+
+            char buffer[17];
+            snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+            m_hash = buffer;
         } catch (std::exception &e) {
             printErr("invalid JSON file", e.what());
         }
@@ -19,11 +19,13 @@ class Scratch3Reader : public IProjectReader
         std::vector<std::shared_ptr<Target>> targets() override;
         std::vector<std::shared_ptr<Broadcast>> broadcasts() override;
         std::vector<std::string> extensions() override;
+        std::string hash() override;
 
     private:
         void read();
         std::unique_ptr<ZipReader> m_zipReader;
         nlohmann::json m_json = "";
+        std::string m_hash;
         std::vector<std::shared_ptr<Target>> m_targets;
         std::vector<std::shared_ptr<Broadcast>> m_broadcasts;
         std::vector<std::string> m_extensions;
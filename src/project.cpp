@@ -77,6 +77,23 @@ void Project::setFileName(const std::string &newFileName)
     impl->fileName = newFileName;
 }
 
+/*! Returns the file name of the bytecode cache. */
+const std::string &Project::cacheFileName() const
+{
+    return impl->cacheFileName;
+}
+
+/*!
+ * Sets the file name of the bytecode cache (the cache is disabled by default).\n
+ * load() writes the compiled scripts to this file. When the same project is loaded again
+ * (with the same version of the library), the scripts are loaded from the file instead of compiling them.
+ * \see IEngine::saveBytecodeCache()
+ */
+void Project::setCacheFileName(const std::string &fileName)
+{
+    impl->cacheFileName = fileName;
+}
+
 /*! Returns the version of Scratch used for the project. */
 ScratchVersion Project::scratchVersion() const
 {
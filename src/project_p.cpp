@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include <iostream>
+#include <fstream>
+#include <cstdio>
 
 #include "project_p.h"
 #include "internal/scratch3reader.h"
@@ -62,7 +64,32 @@ bool ProjectPrivate::load()
     engine->setTargets(reader->targets());
     engine->setBroadcasts(reader->broadcasts());
     engine->setExtensions(reader->extensions());
+
+    if (cacheFileName.empty()) {
+        engine->compile();
+        return true;
+    }
+
+    // Use the bytecode cache if it was written for this project, otherwise compile the scripts and write it
+    std::string hash = reader->hash();
+    std::ifstream cacheFile(cacheFileName, std::ios::binary);
+
+    if (cacheFile.is_open() && engine->loadBytecodeCache(cacheFile, hash))
+        return true;
+
+    cacheFile.close();
     engine->compile();
+    std::ofstream newCacheFile(cacheFileName, std::ios::binary);
+
+    if (!newCacheFile.is_open() || !engine->saveBytecodeCache(newCacheFile, hash)) {
+        std::cerr << "Could not write the bytecode cache to " << cacheFileName << std::endl;
+
+        if (newCacheFile.is_open()) {
+            newCacheFile.close();
+            std::remove(cacheFileName.c_str());
+        }
+    }
+
     return true;
 }
 
@@ -27,6 +27,7 @@ struct ProjectPrivate
 
         ScratchVersion scratchVersion = ScratchVersion::Invalid;
         std::string fileName;
+        std::string cacheFileName;
         std::shared_ptr<IEngine> engine = nullptr;
 };
 
@@ -248,7 +248,7 @@ TEST_F(ControlBlocksTest, Repeat)
 
     compiler.compile(block1);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_REPEAT_LOOP, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_REPEAT_LOOP, 4, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues().size(), 1);
     ASSERT_EQ(compiler.constValues()[0].toDouble(), 5);
     ASSERT_TRUE(compiler.variables().empty());
@@ -306,7 +306,7 @@ TEST_F(ControlBlocksTest, RepeatUntil)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 0, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 7, vm::OP_CONST, 0, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues().size(), 1);
     ASSERT_EQ(compiler.constValues()[0].toBool(), false);
     ASSERT_TRUE(compiler.variables().empty());
@@ -314,28 +314,28 @@ TEST_F(ControlBlocksTest, RepeatUntil)
 
     compiler.compile(block2);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 1, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 5, vm::OP_CONST, 1, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
 
     compiler.compile(block3);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 2, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 5, vm::OP_CONST, 2, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
 
     compiler.compile(block4);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 3, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 5, vm::OP_CONST, 3, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
 
     compiler.compile(block5);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_NULL, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 4, vm::OP_NULL, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -344,6 +344,7 @@ TEST_F(ControlBlocksTest, RepeatUntil)
 TEST_F(ControlBlocksTest, While)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // with substack
     auto block1 = createControlBlock("a", "control_while");
@@ -377,7 +378,7 @@ TEST_F(ControlBlocksTest, While)
     ASSERT_EQ(
         compiler.bytecode(),
         std::vector<unsigned int>(
-            { vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 0, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+            { vm::OP_START, vm::OP_UNTIL_LOOP, 8, vm::OP_CONST, 0, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues().size(), 1);
     ASSERT_EQ(compiler.constValues()[0].toBool(), false);
     ASSERT_TRUE(compiler.variables().empty());
@@ -387,7 +388,7 @@ TEST_F(ControlBlocksTest, While)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 1, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 6, vm::OP_CONST, 1, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -396,7 +397,7 @@ TEST_F(ControlBlocksTest, While)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 2, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 6, vm::OP_CONST, 2, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -405,14 +406,14 @@ TEST_F(ControlBlocksTest, While)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_CONST, 3, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 6, vm::OP_CONST, 3, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
 
     compiler.compile(block5);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, vm::OP_NULL, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_UNTIL_LOOP, 5, vm::OP_NULL, vm::OP_NOT, vm::OP_BEGIN_UNTIL_LOOP, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -449,7 +450,7 @@ TEST_F(ControlBlocksTest, ForEach)
     ASSERT_EQ(
         compiler.bytecode(),
         std::vector<unsigned int>(
-            { vm::OP_START, vm::OP_CONST, 0, vm::OP_REPEAT_LOOP, vm::OP_REPEAT_LOOP_INDEX1, vm::OP_SET_VAR, 0, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+            { vm::OP_START, vm::OP_CONST, 0, vm::OP_REPEAT_LOOP, 7, vm::OP_REPEAT_LOOP_INDEX1, vm::OP_SET_VAR, 0, vm::OP_NULL, vm::OP_PRINT, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues().size(), 1);
     ASSERT_EQ(compiler.constValues()[0].toDouble(), 5);
     ASSERT_EQ(compiler.variables().size(), 1);
@@ -510,7 +511,7 @@ TEST_F(ControlBlocksTest, If)
 
     compiler.compile(block1);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_IF, 3, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues().size(), 1);
     ASSERT_EQ(compiler.constValues()[0].toBool(), false);
     ASSERT_TRUE(compiler.variables().empty());
@@ -534,14 +535,14 @@ TEST_F(ControlBlocksTest, If)
 
     compiler.compile(block4);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 1, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 1, vm::OP_IF, 3, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
 
     compiler.compile(block5);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_NULL, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_NULL, vm::OP_IF, 3, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -550,6 +551,7 @@ TEST_F(ControlBlocksTest, If)
 TEST_F(ControlBlocksTest, IfElse)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // with both substacks
     auto block1 = createControlBlock("a", "control_if_else");
@@ -600,7 +602,7 @@ TEST_F(ControlBlocksTest, IfElse)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_IF, 4, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, 4, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues().size(), 1);
     ASSERT_EQ(compiler.constValues()[0].toBool(), false);
     ASSERT_TRUE(compiler.variables().empty());
@@ -608,14 +610,14 @@ TEST_F(ControlBlocksTest, IfElse)
 
     compiler.compile(block2);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 1, vm::OP_NOT, vm::OP_IF, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 1, vm::OP_NOT, vm::OP_IF, 4, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
 
     compiler.compile(block3);
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 2, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 2, vm::OP_IF, 3, vm::OP_NULL, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -631,7 +633,7 @@ TEST_F(ControlBlocksTest, IfElse)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 3, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 3, vm::OP_IF, 4, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, 4, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
@@ -640,7 +642,7 @@ TEST_F(ControlBlocksTest, IfElse)
 
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_NULL, vm::OP_IF, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_NULL, vm::OP_IF, 4, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, 4, vm::OP_NULL, vm::OP_NOT, vm::OP_PRINT, vm::OP_ENDIF, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ false, false, false, Value() }));
     ASSERT_TRUE(compiler.variables().empty());
     ASSERT_TRUE(compiler.lists().empty());
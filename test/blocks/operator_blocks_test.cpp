@@ -132,6 +132,7 @@ TEST_F(OperatorBlocksTest, RegisterBlocks)
 TEST_F(OperatorBlocksTest, Add)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 2 + 3
     auto block1 = createOperatorBlock("a", "operator_add");
@@ -159,6 +160,7 @@ TEST_F(OperatorBlocksTest, Add)
 TEST_F(OperatorBlocksTest, Subtract)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 5 - 2
     auto block1 = createOperatorBlock("a", "operator_subtract");
@@ -186,6 +188,7 @@ TEST_F(OperatorBlocksTest, Subtract)
 TEST_F(OperatorBlocksTest, Multiply)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 2 * 5
     auto block1 = createOperatorBlock("a", "operator_multiply");
@@ -213,6 +216,7 @@ TEST_F(OperatorBlocksTest, Multiply)
 TEST_F(OperatorBlocksTest, Divide)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 3 / 2
     auto block1 = createOperatorBlock("a", "operator_divide");
@@ -240,6 +244,7 @@ TEST_F(OperatorBlocksTest, Divide)
 TEST_F(OperatorBlocksTest, Random)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // pick random 1 to 10
     auto block1 = createOperatorBlock("a", "operator_random");
@@ -267,6 +272,7 @@ TEST_F(OperatorBlocksTest, Random)
 TEST_F(OperatorBlocksTest, Lt)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 2 < 4
     auto block1 = createOperatorBlock("a", "operator_lt");
@@ -294,6 +300,7 @@ TEST_F(OperatorBlocksTest, Lt)
 TEST_F(OperatorBlocksTest, Equals)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 2 = 4
     auto block1 = createOperatorBlock("a", "operator_equals");
@@ -321,6 +328,7 @@ TEST_F(OperatorBlocksTest, Equals)
 TEST_F(OperatorBlocksTest, Gt)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 2 > 4
     auto block1 = createOperatorBlock("a", "operator_gt");
@@ -350,6 +358,7 @@ TEST_F(OperatorBlocksTest, Gt)
 TEST_F(OperatorBlocksTest, And)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // <> and <> (without inputs)
     auto block1 = createOperatorBlock("a", "operator_and");
@@ -393,6 +402,7 @@ TEST_F(OperatorBlocksTest, And)
 TEST_F(OperatorBlocksTest, Or)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // <> or <> (without inputs)
     auto block1 = createOperatorBlock("a", "operator_or");
@@ -436,6 +446,7 @@ TEST_F(OperatorBlocksTest, Or)
 TEST_F(OperatorBlocksTest, Not)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // <> (without any input)
     auto block1 = createOperatorBlock("a", "operator_not");
@@ -472,6 +483,7 @@ TEST_F(OperatorBlocksTest, Not)
 TEST_F(OperatorBlocksTest, Join)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // join "hello " "world"
     auto block1 = createOperatorBlock("a", "operator_join");
@@ -499,6 +511,7 @@ TEST_F(OperatorBlocksTest, Join)
 TEST_F(OperatorBlocksTest, LetterOf)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // letter 5 of "test"
     auto block1 = createOperatorBlock("a", "operator_letter_of");
@@ -526,6 +539,7 @@ TEST_F(OperatorBlocksTest, LetterOf)
 TEST_F(OperatorBlocksTest, Length)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // length of "test"
     auto block1 = createOperatorBlock("a", "operator_length");
@@ -551,6 +565,7 @@ TEST_F(OperatorBlocksTest, Length)
 TEST_F(OperatorBlocksTest, Contains)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // "hello" contains "e"
     auto block1 = createOperatorBlock("a", "operator_contains");
@@ -580,6 +595,7 @@ TEST_F(OperatorBlocksTest, Contains)
 TEST_F(OperatorBlocksTest, Mod)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // 7 mod 5
     auto block1 = createOperatorBlock("a", "operator_mod");
@@ -607,6 +623,7 @@ TEST_F(OperatorBlocksTest, Mod)
 TEST_F(OperatorBlocksTest, Round)
 {
     Compiler compiler(&m_engine);
+    compiler.setOptimizationsEnabled(false);
 
     // round 6
     auto block1 = createOperatorBlock("a", "operator_round");
@@ -632,6 +649,7 @@ TEST_F(OperatorBlocksTest, Round)
 TEST_F(OperatorBlocksTest, MathOp)
 {
     Compiler compiler(&m_engineMock);
+    compiler.setOptimizationsEnabled(false);
     std::vector<std::shared_ptr<Block>> blocks;
     std::shared_ptr<Block> block;
 
@@ -116,7 +116,7 @@ TEST_F(VariableBlocksTest, ChangeVariableBy)
     VariableBlocks::compileChangeVariableBy(&compiler);
     compiler.end();
 
-    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_CHANGE_VAR, 0, vm::OP_CONST, 1, vm::OP_CHANGE_VAR, 1, vm::OP_HALT }));
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_CHANGE_VAR_CONST, 0, 0, vm::OP_CHANGE_VAR_CONST, 1, 1, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ 10, 3.25 }));
     ASSERT_EQ(
         compiler.variables(),
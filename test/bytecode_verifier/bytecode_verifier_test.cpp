@@ -0,0 +1,204 @@
+#include <scratchcpp/virtualmachine.h>
+#include <engine/internal/bytecodeverifier.h>
+
+#include "../common.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+TEST(BytecodeVerifierTest, ValidBytecode)
+{
+    std::vector<unsigned int> bytecode = { OP_START, OP_CONST, 0, OP_CONST, 1, OP_ADD, OP_SET_VAR, 0, OP_CONST, 2, OP_REPEAT_LOOP, 17, OP_READ_VAR, 0, OP_CONST, 1,
+                                           OP_EQUALS, OP_IF, 4, OP_NULL, OP_PRINT, OP_ELSE, 4, OP_EXEC, 0, OP_PRINT, OP_ENDIF, OP_BREAK_FRAME, OP_LOOP_END, OP_HALT };
+    BytecodeVerifier verifier(bytecode);
+    verifier.setConstValueCount(3);
+    verifier.setVariableCount(1);
+    verifier.setFunctionCount(1);
+    ASSERT_TRUE(verifier.verify());
+    ASSERT_TRUE(verifier.error().empty());
+    ASSERT_EQ(verifier.maxRegisterCount(), 2);
+}
+
+TEST(BytecodeVerifierTest, Procedures)
+{
+    std::vector<unsigned int> bytecode = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_NULL, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_READ_ARG, 0, OP_PRINT, OP_HALT };
+    BytecodeVerifier verifier(bytecode);
+    verifier.setConstValueCount(1);
+    verifier.setProcedureCount(1);
+    ASSERT_TRUE(verifier.verify());
+    ASSERT_EQ(verifier.maxRegisterCount(), 1);
+
+    verifier.setProcedureCount(0);
+    ASSERT_FALSE(verifier.verify());
+    ASSERT_EQ(verifier.errorPos(), 7);
+}
+
+TEST(BytecodeVerifierTest, Functions)
+{
+    // The function reads the input, so the registers are free before the if statement
+    std::vector<unsigned int> bytecode1 = { OP_START, OP_CONST, 0, OP_CONST, 0, OP_EXEC, 0, OP_EXEC, 1, OP_IF, 1, OP_ENDIF, OP_HALT };
+    BytecodeVerifier verifier1(bytecode1);
+    ASSERT_TRUE(verifier1.verify());
+    ASSERT_EQ(verifier1.maxRegisterCount(), 4);
+
+    // Functions can't read more registers than are used
+    std::vector<unsigned int> bytecode2 = { OP_START, OP_EXEC, 0, OP_ADD, OP_PRINT, OP_HALT };
+    BytecodeVerifier verifier2(bytecode2);
+    ASSERT_FALSE(verifier2.verify());
+    ASSERT_EQ(verifier2.errorPos(), 3);
+}
+
+TEST(BytecodeVerifierTest, StopScript)
+{
+    std::vector<unsigned int> bytecode = { OP_START, OP_FOREVER_LOOP, OP_HALT, OP_LOOP_END, OP_HALT };
+    BytecodeVerifier verifier(bytecode);
+    ASSERT_TRUE(verifier.verify());
+}
+
+TEST(BytecodeVerifierTest, InvalidStartAndEnd)
+{
+    std::vector<unsigned int> bytecode1;
+    BytecodeVerifier verifier1(bytecode1);
+    ASSERT_FALSE(verifier1.verify());
+    ASSERT_EQ(verifier1.errorPos(), 0);
+
+    std::vector<unsigned int> bytecode2 = { OP_NULL, OP_PRINT, OP_HALT };
+    BytecodeVerifier verifier2(bytecode2);
+    ASSERT_FALSE(verifier2.verify());
+    ASSERT_EQ(verifier2.errorPos(), 0);
+
+    std::vector<unsigned int> bytecode3 = { OP_START, OP_NULL, OP_PRINT };
+    BytecodeVerifier verifier3(bytecode3);
+    ASSERT_FALSE(verifier3.verify());
+    ASSERT_EQ(verifier3.errorPos(), 3);
+
+    // The argument of OP_CONST isn't OP_HALT
+    std::vector<unsigned int> bytecode4 = { OP_START, OP_CONST, OP_HALT };
+    BytecodeVerifier verifier4(bytecode4);
+    ASSERT_FALSE(verifier4.verify());
+    ASSERT_EQ(verifier4.errorPos(), 3);
+
+    std::vector<unsigned int> bytecode5 = { OP_START, OP_START, OP_HALT };
+    BytecodeVerifier verifier5(bytecode5);
+    ASSERT_FALSE(verifier5.verify());
+    ASSERT_EQ(verifier5.errorPos(), 1);
+
+    std::vector<unsigned int> bytecode6 = { OP_START, 1000, OP_HALT };
+    BytecodeVerifier verifier6(bytecode6);
+    ASSERT_FALSE(verifier6.verify());
+    ASSERT_EQ(verifier6.errorPos(), 1);
+    ASSERT_EQ(verifier6.error(), "invalid opcode 1000");
+
+    std::vector<unsigned int> bytecode7 = { OP_START, OP_REPEAT_LOOP };
+    BytecodeVerifier verifier7(bytecode7);
+    ASSERT_FALSE(verifier7.verify());
+    ASSERT_EQ(verifier7.errorPos(), 1);
+}
+
+TEST(BytecodeVerifierTest, InvalidArguments)
+{
+    std::vector<unsigned int> bytecode = { OP_START, OP_CONST, 1, OP_SET_VAR, 2, OP_LIST_LENGTH, 3, OP_LIST_GET_VAR_INDEX, 3, 2, OP_EXEC, 4, OP_HALT };
+    BytecodeVerifier verifier(bytecode);
+    verifier.setConstValueCount(2);
+    verifier.setVariableCount(3);
+    verifier.setListCount(4);
+    verifier.setFunctionCount(5);
+    ASSERT_TRUE(verifier.verify());
+
+    verifier.setFunctionCount(4);
+    ASSERT_FALSE(verifier.verify());
+    ASSERT_EQ(verifier.errorPos(), 10);
+    ASSERT_EQ(verifier.error(), "invalid function index 4");
+
+    verifier.setListCount(3);
+    ASSERT_FALSE(verifier.verify());
+    ASSERT_EQ(verifier.errorPos(), 5);
+
+    verifier.setVariableCount(2);
+    ASSERT_FALSE(verifier.verify());
+    ASSERT_EQ(verifier.errorPos(), 3);
+
+    verifier.setConstValueCount(1);
+    ASSERT_FALSE(verifier.verify());
+    ASSERT_EQ(verifier.errorPos(), 1);
+}
+
+TEST(BytecodeVerifierTest, RegisterUnderflow)
+{
+    std::vector<unsigned int> bytecode = { OP_START, OP_NULL, OP_LIST_INSERT, 0, OP_HALT };
+    BytecodeVerifier verifier(bytecode);
+    ASSERT_FALSE(verifier.verify());
+    ASSERT_EQ(verifier.errorPos(), 2);
+    ASSERT_EQ(verifier.error(), "the instruction reads 2 registers, but only 1 are used");
+}
+
+TEST(BytecodeVerifierTest, LeakedRegisters)
+{
+    std::vector<unsigned int> bytecode1 = { OP_START, OP_NULL, OP_NULL, OP_PRINT, OP_HALT };
+    BytecodeVerifier verifier1(bytecode1);
+    ASSERT_FALSE(verifier1.verify());
+    ASSERT_EQ(verifier1.errorPos(), 4);
+    ASSERT_EQ(verifier1.error(), "1 registers were leaked");
+
+    std::vector<unsigned int> bytecode2 = { OP_START, OP_FOREVER_LOOP, OP_NULL, OP_LOOP_END, OP_HALT };
+    BytecodeVerifier verifier2(bytecode2);
+    ASSERT_FALSE(verifier2.verify());
+    ASSERT_EQ(verifier2.errorPos(), 3);
+
+    std::vector<unsigned int> bytecode3 = { OP_START, OP_NULL, OP_NULL, OP_IF, 1, OP_ENDIF, OP_HALT };
+    BytecodeVerifier verifier3(bytecode3);
+    ASSERT_FALSE(verifier3.verify());
+    ASSERT_EQ(verifier3.errorPos(), 3);
+}
+
+TEST(BytecodeVerifierTest, InvalidStatements)
+{
+    std::vector<unsigned int> bytecode1 = { OP_START, OP_NULL, OP_IF, 0, OP_HALT };
+    BytecodeVerifier verifier1(bytecode1);
+    ASSERT_FALSE(verifier1.verify());
+    ASSERT_EQ(verifier1.errorPos(), 2);
+
+    std::vector<unsigned int> bytecode2 = { OP_START, OP_ELSE, 0, OP_ENDIF, OP_HALT };
+    BytecodeVerifier verifier2(bytecode2);
+    ASSERT_FALSE(verifier2.verify());
+    ASSERT_EQ(verifier2.errorPos(), 1);
+
+    std::vector<unsigned int> bytecode3 = { OP_START, OP_FOREVER_LOOP, OP_ENDIF, OP_HALT };
+    BytecodeVerifier verifier3(bytecode3);
+    ASSERT_FALSE(verifier3.verify());
+    ASSERT_EQ(verifier3.errorPos(), 2);
+
+    std::vector<unsigned int> bytecode4 = { OP_START, OP_UNTIL_LOOP, 1, OP_LOOP_END, OP_HALT };
+    BytecodeVerifier verifier4(bytecode4);
+    ASSERT_FALSE(verifier4.verify());
+    ASSERT_EQ(verifier4.errorPos(), 3);
+
+    std::vector<unsigned int> bytecode5 = { OP_START, OP_NULL, OP_BEGIN_UNTIL_LOOP, OP_HALT };
+    BytecodeVerifier verifier5(bytecode5);
+    ASSERT_FALSE(verifier5.verify());
+    ASSERT_EQ(verifier5.errorPos(), 2);
+}
+
+TEST(BytecodeVerifierTest, InvalidJumps)
+{
+    std::vector<unsigned int> bytecode1 = { OP_START, OP_NULL, OP_IF, 2, OP_ENDIF, OP_HALT };
+    BytecodeVerifier verifier1(bytecode1);
+    ASSERT_FALSE(verifier1.verify());
+    ASSERT_EQ(verifier1.errorPos(), 2);
+    ASSERT_EQ(verifier1.error(), "invalid jump offset 2");
+
+    std::vector<unsigned int> bytecode2 = { OP_START, OP_NULL, OP_IF, 2, OP_ELSE, 0, OP_ENDIF, OP_HALT };
+    BytecodeVerifier verifier2(bytecode2);
+    ASSERT_FALSE(verifier2.verify());
+    ASSERT_EQ(verifier2.errorPos(), 4);
+
+    std::vector<unsigned int> bytecode3 = { OP_START, OP_NULL, OP_REPEAT_LOOP, 0, OP_LOOP_END, OP_HALT };
+    BytecodeVerifier verifier3(bytecode3);
+    ASSERT_FALSE(verifier3.verify());
+    ASSERT_EQ(verifier3.errorPos(), 2);
+
+    std::vector<unsigned int> bytecode4 = { OP_START, OP_UNTIL_LOOP, 3, OP_NULL, OP_BEGIN_UNTIL_LOOP, OP_LOOP_END, OP_HALT };
+    BytecodeVerifier verifier4(bytecode4);
+    ASSERT_TRUE(verifier4.verify());
+    ASSERT_EQ(verifier4.maxRegisterCount(), 1);
+}
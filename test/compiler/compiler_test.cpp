@@ -105,6 +105,348 @@ TEST_F(CompilerTest, End)
     compiler.init();
 }
 
+TEST_F(CompilerTest, MaxRegisterCount)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+    ASSERT_EQ(compiler.maxRegisterCount(), 0);
+
+    compiler.init();
+    compiler.addInstruction(vm::OP_NULL);
+    compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+    compiler.addInstruction(vm::OP_LIST_LENGTH, { 0 });
+    compiler.addInstruction(vm::OP_LIST_INSERT, { 0 });
+    compiler.addInstruction(vm::OP_EXEC, { 0 });
+    compiler.addInstruction(vm::OP_PRINT);
+    compiler.addInstruction(vm::OP_PRINT);
+    compiler.addInstruction(vm::OP_CONST, { 0 });
+    compiler.addInstruction(vm::OP_IF);
+    compiler.addInstruction(vm::OP_ENDIF);
+    compiler.end();
+    ASSERT_EQ(compiler.maxRegisterCount(), 3);
+
+    compiler.init();
+    ASSERT_EQ(compiler.maxRegisterCount(), 0);
+    compiler.addInstruction(vm::OP_PRINT);
+    compiler.addInstruction(vm::OP_CONST, { 0 });
+    compiler.end();
+    ASSERT_EQ(compiler.maxRegisterCount(), 1);
+}
+
+TEST_F(CompilerTest, OptimizationsEnabled)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+    ASSERT_TRUE(compiler.optimizationsEnabled());
+
+    compiler.setOptimizationsEnabled(false);
+    ASSERT_FALSE(compiler.optimizationsEnabled());
+
+    compiler.setOptimizationsEnabled(true);
+    ASSERT_TRUE(compiler.optimizationsEnabled());
+}
+
+TEST_F(CompilerTest, Superinstructions)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+
+    auto addInstructions = [&compiler]() {
+        compiler.init();
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_CONST, { 1 });
+        compiler.addInstruction(vm::OP_ADD);
+        compiler.addInstruction(vm::OP_SET_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_CONST, { 1 });
+        compiler.addInstruction(vm::OP_ADD);
+        compiler.addInstruction(vm::OP_SET_VAR, { 1 });
+        compiler.addInstruction(vm::OP_CONST, { 2 });
+        compiler.addInstruction(vm::OP_CHANGE_VAR, { 1 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 1 });
+        compiler.addInstruction(vm::OP_LIST_GET_ITEM, { 0 });
+        compiler.addInstruction(vm::OP_PRINT);
+        compiler.addInstruction(vm::OP_READ_VAR, { 2 });
+        compiler.addInstruction(vm::OP_CONST, { 3 });
+        compiler.addInstruction(vm::OP_EQUALS);
+        compiler.addInstruction(vm::OP_IF);
+        compiler.addInstruction(vm::OP_NULL);
+        compiler.addInstruction(vm::OP_PRINT);
+        compiler.addInstruction(vm::OP_ELSE);
+        compiler.addInstruction(vm::OP_ENDIF);
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 1 });
+        compiler.addInstruction(vm::OP_EQUALS);
+        compiler.addInstruction(vm::OP_READ_VAR, { 2 });
+        compiler.addInstruction(vm::OP_CONST, { 3 });
+        compiler.addInstruction(vm::OP_EQUALS);
+        compiler.addInstruction(vm::OP_AND);
+        compiler.addInstruction(vm::OP_PRINT);
+        compiler.addInstruction(vm::OP_CONST, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 1 });
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_READ_VAR, { 2 });
+        compiler.addInstruction(vm::OP_GREATER_THAN);
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_LESS_THAN);
+        compiler.addInstruction(vm::OP_PRINT);
+        compiler.end();
+    };
+
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CHANGE_VAR_CONST, 0, 1, vm::OP_READ_VAR, 0, vm::OP_CONST, 1, vm::OP_ADD, vm::OP_SET_VAR, 1, vm::OP_CHANGE_VAR_CONST, 1, 2,
+                                    vm::OP_LIST_GET_VAR_INDEX, 0, 1, vm::OP_PRINT, vm::OP_IF_VAR_EQ_CONST, 2, 3, 4, vm::OP_NULL, vm::OP_PRINT, vm::OP_ELSE, 1, vm::OP_ENDIF,
+                                    vm::OP_READ_VAR, 0, vm::OP_EQUALS_VAR, 1, vm::OP_CONST, 3, vm::OP_EQUALS_VAR, 2, vm::OP_AND, vm::OP_PRINT, vm::OP_CONST, 0, vm::OP_STR_CONCAT_VAR, 1,
+                                    vm::OP_GREATER_THAN_VAR, 2, vm::OP_LESS_THAN_VAR, 0, vm::OP_PRINT, vm::OP_HALT }));
+
+    compiler.setOptimizationsEnabled(false);
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START,    vm::OP_READ_VAR, 0, vm::OP_CONST, 1, vm::OP_ADD, vm::OP_SET_VAR, 0, vm::OP_READ_VAR, 0, vm::OP_CONST, 1, vm::OP_ADD, vm::OP_SET_VAR, 1, vm::OP_CONST, 2,
+                                    vm::OP_CHANGE_VAR, 1, vm::OP_READ_VAR, 1, vm::OP_LIST_GET_ITEM, 0, vm::OP_PRINT, vm::OP_READ_VAR, 2, vm::OP_CONST, 3, vm::OP_EQUALS, vm::OP_IF, 4, vm::OP_NULL, vm::OP_PRINT,
+                                    vm::OP_ELSE, 1, vm::OP_ENDIF, vm::OP_READ_VAR, 0, vm::OP_READ_VAR, 1, vm::OP_EQUALS, vm::OP_READ_VAR, 2, vm::OP_CONST, 3, vm::OP_EQUALS, vm::OP_AND,
+                                    vm::OP_PRINT, vm::OP_CONST, 0, vm::OP_READ_VAR, 1, vm::OP_STR_CONCAT, vm::OP_READ_VAR, 2, vm::OP_GREATER_THAN, vm::OP_READ_VAR, 0, vm::OP_LESS_THAN, vm::OP_PRINT,
+                                    vm::OP_HALT }));
+}
+
+TEST_F(CompilerTest, StringAppend)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+
+    auto addInstructions = [&compiler]() {
+        compiler.init();
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_CONST, { 0 });
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_SET_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 2 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 1 });
+        compiler.addInstruction(vm::OP_STR_AT);
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_SET_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 1 });
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_SET_VAR, { 0 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_CONST, { 0 });
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_SET_VAR, { 1 });
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addInstruction(vm::OP_NULL);
+        compiler.addInstruction(vm::OP_EXEC, { 0 });
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_SET_VAR, { 0 });
+        compiler.end();
+    };
+
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_VAR_APPEND_STR, 0, vm::OP_READ_VAR, 2, vm::OP_READ_VAR, 1, vm::OP_STR_AT, vm::OP_VAR_APPEND_STR, 0, vm::OP_READ_VAR, 1,
+                                    vm::OP_VAR_APPEND_STR, 0, vm::OP_READ_VAR, 0, vm::OP_CONST, 0, vm::OP_STR_CONCAT, vm::OP_SET_VAR, 1, vm::OP_READ_VAR, 0, vm::OP_NULL, vm::OP_EXEC, 0,
+                                    vm::OP_STR_CONCAT, vm::OP_SET_VAR, 0, vm::OP_HALT }));
+
+    compiler.setOptimizationsEnabled(false);
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_READ_VAR, 0, vm::OP_CONST, 0, vm::OP_STR_CONCAT, vm::OP_SET_VAR, 0, vm::OP_READ_VAR, 0, vm::OP_READ_VAR, 2, vm::OP_READ_VAR, 1,
+                                    vm::OP_STR_AT, vm::OP_STR_CONCAT, vm::OP_SET_VAR, 0, vm::OP_READ_VAR, 0, vm::OP_READ_VAR, 1, vm::OP_STR_CONCAT, vm::OP_SET_VAR, 0, vm::OP_READ_VAR, 0,
+                                    vm::OP_CONST, 0, vm::OP_STR_CONCAT, vm::OP_SET_VAR, 1, vm::OP_READ_VAR, 0, vm::OP_NULL, vm::OP_EXEC, 0, vm::OP_STR_CONCAT, vm::OP_SET_VAR, 0, vm::OP_HALT }));
+}
+
+TEST_F(CompilerTest, TailCalls)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+    BlockPrototype prototype("test %s");
+
+    auto addInstructions = [&compiler, &prototype]() {
+        compiler.init();
+        compiler.setProcedurePrototype(&prototype);
+        unsigned int self = compiler.procedureIndex("test %s");
+        unsigned int other = compiler.procedureIndex("other");
+        compiler.addInstruction(vm::OP_NULL);
+        compiler.addInstruction(vm::OP_IF);
+        compiler.addInstruction(vm::OP_INIT_PROCEDURE);
+        compiler.addInstruction(vm::OP_READ_ARG, { 0 });
+        compiler.addInstruction(vm::OP_ADD_ARG);
+        compiler.addInstruction(vm::OP_CALL_PROCEDURE, { self });
+        compiler.addInstruction(vm::OP_ELSE);
+        compiler.addInstruction(vm::OP_INIT_PROCEDURE);
+        compiler.addInstruction(vm::OP_CALL_PROCEDURE, { other });
+        compiler.addInstruction(vm::OP_INIT_PROCEDURE);
+        compiler.addInstruction(vm::OP_CALL_PROCEDURE, { self });
+        compiler.addInstruction(vm::OP_ENDIF);
+        compiler.end();
+    };
+
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_NULL, vm::OP_IF, 8, vm::OP_INIT_PROCEDURE, vm::OP_READ_ARG, 0, vm::OP_ADD_ARG, vm::OP_TAIL_CALL, 0, vm::OP_ELSE, 7, vm::OP_INIT_PROCEDURE,
+                                    vm::OP_CALL_PROCEDURE, 1, vm::OP_INIT_PROCEDURE, vm::OP_TAIL_CALL, 0, vm::OP_ENDIF, vm::OP_HALT }));
+
+    // Calls in loops aren't tail calls
+    compiler.init();
+    compiler.setProcedurePrototype(&prototype);
+    compiler.addInstruction(vm::OP_FOREVER_LOOP);
+    compiler.addInstruction(vm::OP_INIT_PROCEDURE);
+    compiler.addInstruction(vm::OP_CALL_PROCEDURE, { 0 });
+    compiler.addInstruction(vm::OP_LOOP_END);
+    compiler.end();
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_FOREVER_LOOP, vm::OP_INIT_PROCEDURE, vm::OP_CALL_PROCEDURE, 0, vm::OP_LOOP_END, vm::OP_HALT }));
+
+    // Calls outside of procedures aren't tail calls
+    compiler.init();
+    compiler.addInstruction(vm::OP_INIT_PROCEDURE);
+    compiler.addInstruction(vm::OP_CALL_PROCEDURE, { 0 });
+    compiler.end();
+    ASSERT_EQ(compiler.bytecode(), std::vector<unsigned int>({ vm::OP_START, vm::OP_INIT_PROCEDURE, vm::OP_CALL_PROCEDURE, 0, vm::OP_HALT }));
+
+    compiler.setOptimizationsEnabled(false);
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_NULL, vm::OP_IF, 8, vm::OP_INIT_PROCEDURE, vm::OP_READ_ARG, 0, vm::OP_ADD_ARG, vm::OP_CALL_PROCEDURE, 0, vm::OP_ELSE, 7, vm::OP_INIT_PROCEDURE,
+                                    vm::OP_CALL_PROCEDURE, 1, vm::OP_INIT_PROCEDURE, vm::OP_CALL_PROCEDURE, 0, vm::OP_ENDIF, vm::OP_HALT }));
+}
+
+TEST_F(CompilerTest, ConstantFolding)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+
+    auto addInstructions = [&compiler]() {
+        compiler.init();
+        // (360 / 4) * (3.14 / 180)
+        compiler.addConstValue(360);
+        compiler.addConstValue(4);
+        compiler.addInstruction(vm::OP_DIVIDE);
+        compiler.addConstValue(3.14);
+        compiler.addConstValue(180);
+        compiler.addInstruction(vm::OP_DIVIDE);
+        compiler.addInstruction(vm::OP_MULTIPLY);
+        compiler.addInstruction(vm::OP_PRINT);
+        // 1 / 0
+        compiler.addConstValue(1);
+        compiler.addConstValue(0);
+        compiler.addInstruction(vm::OP_DIVIDE);
+        compiler.addInstruction(vm::OP_PRINT);
+        // join "a" "b"
+        compiler.addConstValue("a");
+        compiler.addConstValue("b");
+        compiler.addInstruction(vm::OP_STR_CONCAT);
+        compiler.addInstruction(vm::OP_PRINT);
+        // 2 * 2 (the result is already a constant value)
+        compiler.addConstValue(2);
+        compiler.addConstValue(2);
+        compiler.addInstruction(vm::OP_MULTIPLY);
+        compiler.addInstruction(vm::OP_PRINT);
+        // (var) + (1 + 2)
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addConstValue(1);
+        compiler.addConstValue(2);
+        compiler.addInstruction(vm::OP_ADD);
+        compiler.addInstruction(vm::OP_ADD);
+        compiler.addInstruction(vm::OP_PRINT);
+        // pick random 1 to 2
+        compiler.addConstValue(1);
+        compiler.addConstValue(2);
+        compiler.addInstruction(vm::OP_RANDOM);
+        compiler.addInstruction(vm::OP_PRINT);
+        compiler.end();
+    };
+
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 14, vm::OP_PRINT, vm::OP_CONST, 15, vm::OP_PRINT, vm::OP_CONST, 16, vm::OP_PRINT, vm::OP_CONST, 1, vm::OP_PRINT, vm::OP_READ_VAR, 0,
+                                    vm::OP_CONST, 17, vm::OP_ADD, vm::OP_PRINT, vm::OP_CONST, 12, vm::OP_CONST, 13, vm::OP_RANDOM, vm::OP_PRINT, vm::OP_HALT }));
+
+    auto constValues = compiler.constValues();
+    ASSERT_EQ(constValues.size(), 18);
+    ASSERT_EQ(std::round(constValues[14].toDouble() * 1000) / 1000, 1.57);
+    ASSERT_TRUE(constValues[15].isInfinity());
+    ASSERT_EQ(constValues[16].toString(), "ab");
+    ASSERT_EQ(constValues[17].toDouble(), 3);
+
+    compiler.setOptimizationsEnabled(false);
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 18, vm::OP_CONST, 19, vm::OP_DIVIDE, vm::OP_CONST, 20, vm::OP_CONST, 21, vm::OP_DIVIDE, vm::OP_MULTIPLY, vm::OP_PRINT, vm::OP_CONST, 22,
+                                    vm::OP_CONST, 23, vm::OP_DIVIDE, vm::OP_PRINT, vm::OP_CONST, 24, vm::OP_CONST, 25, vm::OP_STR_CONCAT, vm::OP_PRINT, vm::OP_CONST, 26, vm::OP_CONST, 27, vm::OP_MULTIPLY,
+                                    vm::OP_PRINT, vm::OP_READ_VAR, 0, vm::OP_CONST, 28, vm::OP_CONST, 29, vm::OP_ADD, vm::OP_ADD, vm::OP_PRINT, vm::OP_CONST, 30, vm::OP_CONST, 31, vm::OP_RANDOM, vm::OP_PRINT,
+                                    vm::OP_HALT }));
+}
+
+TEST_F(CompilerTest, TypeSpecialization)
+{
+    Engine engine;
+    Compiler compiler(&engine);
+
+    auto addInstructions = [&compiler]() {
+        compiler.init();
+        // ((index) + 1) * 2 < (length of [list])
+        compiler.addInstruction(vm::OP_REPEAT_LOOP_INDEX);
+        compiler.addConstValue(1);
+        compiler.addInstruction(vm::OP_ADD);
+        compiler.addConstValue(2);
+        compiler.addInstruction(vm::OP_MULTIPLY);
+        compiler.addInstruction(vm::OP_LIST_LENGTH, { 0 });
+        compiler.addInstruction(vm::OP_LESS_THAN);
+        compiler.addInstruction(vm::OP_PRINT);
+        // (var) + 1
+        compiler.addInstruction(vm::OP_READ_VAR, { 0 });
+        compiler.addConstValue(1);
+        compiler.addInstruction(vm::OP_ADD);
+        compiler.addInstruction(vm::OP_PRINT);
+        // (index) = "a"
+        compiler.addInstruction(vm::OP_REPEAT_LOOP_INDEX1);
+        compiler.addConstValue("a");
+        compiler.addInstruction(vm::OP_EQUALS);
+        compiler.addInstruction(vm::OP_PRINT);
+        // ((index) / 2) > 1 (dividing can result in a special value)
+        compiler.addInstruction(vm::OP_REPEAT_LOOP_INDEX);
+        compiler.addConstValue(2);
+        compiler.addInstruction(vm::OP_DIVIDE);
+        compiler.addConstValue(1);
+        compiler.addInstruction(vm::OP_GREATER_THAN);
+        compiler.addInstruction(vm::OP_PRINT);
+        // (index) - (function) (the function can read any number of registers)
+        compiler.addInstruction(vm::OP_REPEAT_LOOP_INDEX);
+        compiler.addInstruction(vm::OP_STR_LENGTH);
+        compiler.addInstruction(vm::OP_EXEC, { 0 });
+        compiler.addInstruction(vm::OP_SUBTRACT);
+        compiler.addInstruction(vm::OP_PRINT);
+        compiler.end();
+    };
+
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_REPEAT_LOOP_INDEX, vm::OP_CONST, 0, vm::OP_ADD_NUM, vm::OP_CONST, 1, vm::OP_MULTIPLY_NUM, vm::OP_LIST_LENGTH, 0, vm::OP_LESS_THAN_NUM, vm::OP_PRINT,
+                                    vm::OP_READ_VAR, 0, vm::OP_CONST, 2, vm::OP_ADD, vm::OP_PRINT, vm::OP_REPEAT_LOOP_INDEX1, vm::OP_CONST, 3, vm::OP_EQUALS, vm::OP_PRINT, vm::OP_REPEAT_LOOP_INDEX,
+                                    vm::OP_CONST, 4, vm::OP_DIVIDE, vm::OP_CONST, 5, vm::OP_GREATER_THAN, vm::OP_PRINT, vm::OP_REPEAT_LOOP_INDEX, vm::OP_STR_LENGTH, vm::OP_EXEC, 0, vm::OP_SUBTRACT,
+                                    vm::OP_PRINT, vm::OP_HALT }));
+
+    compiler.setOptimizationsEnabled(false);
+    addInstructions();
+    ASSERT_EQ(
+        compiler.bytecode(),
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_REPEAT_LOOP_INDEX, vm::OP_CONST, 6, vm::OP_ADD, vm::OP_CONST, 7, vm::OP_MULTIPLY, vm::OP_LIST_LENGTH, 0, vm::OP_LESS_THAN, vm::OP_PRINT,
+                                    vm::OP_READ_VAR, 0, vm::OP_CONST, 8, vm::OP_ADD, vm::OP_PRINT, vm::OP_REPEAT_LOOP_INDEX1, vm::OP_CONST, 9, vm::OP_EQUALS, vm::OP_PRINT, vm::OP_REPEAT_LOOP_INDEX,
+                                    vm::OP_CONST, 10, vm::OP_DIVIDE, vm::OP_CONST, 11, vm::OP_GREATER_THAN, vm::OP_PRINT, vm::OP_REPEAT_LOOP_INDEX, vm::OP_STR_LENGTH, vm::OP_EXEC, 0, vm::OP_SUBTRACT,
+                                    vm::OP_PRINT, vm::OP_HALT }));
+}
+
 TEST_F(CompilerTest, ConstValues)
 {
     InputValue v1;
@@ -494,13 +836,39 @@ TEST_F(CompilerTest, RepeatLoop)
     ASSERT_EQ(
         compiler.bytecode(),
         std::vector<unsigned int>(
-            { vm::OP_START, vm::OP_CONST, 0, vm::OP_SET_VAR, 0, vm::OP_CONST, 1, vm::OP_REPEAT_LOOP, vm::OP_CONST, 2, vm::OP_CHANGE_VAR, 0, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+            { vm::OP_START, vm::OP_CONST, 0, vm::OP_SET_VAR, 0, vm::OP_CONST, 1, vm::OP_REPEAT_LOOP, 5, vm::OP_CHANGE_VAR_CONST, 0, 2, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.variablePtrs().size(), 1);
     ASSERT_EQ(compiler.variablePtrs()[0]->toString(), "test");
     ASSERT_EQ(compiler.lists().size(), 0);
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ 0, 10, 1 }));
 }
 
+TEST_F(CompilerTest, BytecodeBlocks)
+{
+    LOAD_PROJECT("repeat10.sb3", engine);
+    engine.resolveIds();
+    Compiler compiler(&engine);
+    auto hat = engine.targetAt(0)->greenFlagBlocks().at(0);
+    compiler.compile(hat);
+
+    Block *setVar = hat->next().get();
+    Block *repeat = setVar->next().get();
+    Block *changeVar = repeat->inputAt(repeat->findInput("SUBSTACK"))->valueBlock().get();
+
+    // The superinstruction belongs to the block of the first instruction and the end of the loop belongs to the loop
+    ASSERT_EQ(compiler.bytecode().size(), compiler.bytecodeBlocks().size());
+    ASSERT_EQ(
+        compiler.bytecodeBlocks(),
+        std::vector<Block *>({ hat.get(), setVar, setVar, setVar, setVar, repeat, repeat, repeat, repeat, changeVar, changeVar, changeVar, repeat, repeat, nullptr }));
+
+    // Without optimizations
+    compiler.setOptimizationsEnabled(false);
+    compiler.compile(hat);
+    ASSERT_EQ(compiler.bytecode().size(), compiler.bytecodeBlocks().size());
+    ASSERT_EQ(compiler.bytecodeBlocks()[9], changeVar);
+    ASSERT_EQ(compiler.bytecodeBlocks()[11], changeVar);
+}
+
 TEST_F(CompilerTest, EmptyRepeatLoop)
 {
     LOAD_PROJECT("repeat_empty.sb3", engine);
@@ -523,7 +891,7 @@ TEST_F(CompilerTest, ForeverLoop)
     compiler.compile(engine.targetAt(0)->greenFlagBlocks().at(0));
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_SET_VAR, 0, vm::OP_FOREVER_LOOP, vm::OP_CONST, 1, vm::OP_CHANGE_VAR, 0, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_SET_VAR, 0, vm::OP_FOREVER_LOOP, vm::OP_CHANGE_VAR_CONST, 0, 1, vm::OP_BREAK_FRAME, vm::OP_LOOP_END, vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ 0, 1 }));
 }
 
@@ -542,13 +910,13 @@ TEST_F(CompilerTest, RepeatUntilLoop)
               vm::OP_SET_VAR,
               0,
               vm::OP_UNTIL_LOOP,
+              8,
               vm::OP_NULL,
               vm::OP_NOT,
               vm::OP_BEGIN_UNTIL_LOOP,
-              vm::OP_CONST,
-              1,
-              vm::OP_CHANGE_VAR,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              1,
               vm::OP_BREAK_FRAME,
               vm::OP_LOOP_END,
               vm::OP_HALT }));
@@ -570,14 +938,14 @@ TEST_F(CompilerTest, RepeatWhileLoop)
               vm::OP_SET_VAR,
               0,
               vm::OP_UNTIL_LOOP,
+              9,
               vm::OP_NULL,
               vm::OP_NOT,
               vm::OP_NOT,
               vm::OP_BEGIN_UNTIL_LOOP,
-              vm::OP_CONST,
-              1,
-              vm::OP_CHANGE_VAR,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              1,
               vm::OP_BREAK_FRAME,
               vm::OP_LOOP_END,
               vm::OP_HALT }));
@@ -601,13 +969,13 @@ TEST_F(CompilerTest, RepeatForEachLoop)
               vm::OP_CONST,
               1,
               vm::OP_REPEAT_LOOP,
+              8,
               vm::OP_REPEAT_LOOP_INDEX1,
               vm::OP_SET_VAR,
               1,
-              vm::OP_CONST,
-              2,
-              vm::OP_CHANGE_VAR,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              2,
               vm::OP_BREAK_FRAME,
               vm::OP_LOOP_END,
               vm::OP_HALT }));
@@ -632,7 +1000,7 @@ TEST_F(CompilerTest, IfStatement)
     compiler.compile(engine.targetAt(0)->greenFlagBlocks().at(0));
     ASSERT_EQ(
         compiler.bytecode(),
-        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_SET_VAR, 0, vm::OP_NULL, vm::OP_NOT, vm::OP_IF, vm::OP_CONST, 1, vm::OP_CHANGE_VAR, 0, vm::OP_ENDIF, vm::OP_HALT }));
+        std::vector<unsigned int>({ vm::OP_START, vm::OP_CONST, 0, vm::OP_SET_VAR, 0, vm::OP_NULL, vm::OP_NOT, vm::OP_IF, 4, vm::OP_CHANGE_VAR_CONST, 0, 1, vm::OP_ENDIF, vm::OP_HALT }));
 }
 
 TEST_F(CompilerTest, EmptyIfStatement)
@@ -661,15 +1029,15 @@ TEST_F(CompilerTest, IfElseStatement)
               vm::OP_NULL,
               vm::OP_NOT,
               vm::OP_IF,
-              vm::OP_CONST,
-              1,
-              vm::OP_CHANGE_VAR,
+              5,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              1,
               vm::OP_ELSE,
-              vm::OP_CONST,
-              2,
-              vm::OP_CHANGE_VAR,
+              4,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              2,
               vm::OP_ENDIF,
               vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ 0, 1, -1 }));
@@ -684,8 +1052,29 @@ TEST_F(CompilerTest, EmptyIfElseStatement)
     ASSERT_EQ(
         compiler.bytecode(),
         std::vector<unsigned int>(
-            { vm::OP_START, vm::OP_CONST, 0,         vm::OP_SET_VAR, 0, vm::OP_NULL,       vm::OP_NOT, vm::OP_NOT,   vm::OP_IF,  vm::OP_CONST, 1, vm::OP_CHANGE_VAR, 0, vm::OP_ENDIF,
-              vm::OP_NULL,  vm::OP_NOT,   vm::OP_IF, vm::OP_CONST,   2, vm::OP_CHANGE_VAR, 0,          vm::OP_ENDIF, vm::OP_HALT }));
+            { vm::OP_START,
+              vm::OP_CONST,
+              0,
+              vm::OP_SET_VAR,
+              0,
+              vm::OP_NULL,
+              vm::OP_NOT,
+              vm::OP_NOT,
+              vm::OP_IF,
+              4,
+              vm::OP_CHANGE_VAR_CONST,
+              0,
+              1,
+              vm::OP_ENDIF,
+              vm::OP_NULL,
+              vm::OP_NOT,
+              vm::OP_IF,
+              4,
+              vm::OP_CHANGE_VAR_CONST,
+              0,
+              2,
+              vm::OP_ENDIF,
+              vm::OP_HALT }));
     ASSERT_EQ(compiler.constValues(), std::vector<Value>({ 0, -1, 1 }));
 }
 
@@ -706,37 +1095,39 @@ TEST_F(CompilerTest, NestedStatements)
               vm::OP_NULL,
               vm::OP_NOT,
               vm::OP_IF,
-              vm::OP_CONST,
-              1,
-              vm::OP_CHANGE_VAR,
+              18,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              1,
               vm::OP_CONST,
               2,
               vm::OP_REPEAT_LOOP,
+              9,
               vm::OP_NULL,
               vm::OP_IF,
-              vm::OP_CONST,
-              3,
-              vm::OP_CHANGE_VAR,
+              4,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              3,
               vm::OP_ENDIF,
               vm::OP_BREAK_FRAME,
               vm::OP_LOOP_END,
               vm::OP_ELSE,
+              18,
               vm::OP_CONST,
               4,
               vm::OP_REPEAT_LOOP,
-              vm::OP_CONST,
-              5,
-              vm::OP_CHANGE_VAR,
+              13,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              5,
               vm::OP_NULL,
               vm::OP_NOT,
               vm::OP_IF,
-              vm::OP_CONST,
-              6,
-              vm::OP_CHANGE_VAR,
+              4,
+              vm::OP_CHANGE_VAR_CONST,
               0,
+              6,
               vm::OP_ENDIF,
               vm::OP_BREAK_FRAME,
               vm::OP_LOOP_END,
@@ -782,7 +1173,7 @@ TEST_F(CompilerTest, CustomBlocks)
     ASSERT_EQ(
         compiler.bytecode(),
         std::vector<unsigned int>(
-            { vm::OP_START, vm::OP_WARP, vm::OP_CONST, 1, vm::OP_REPEAT_LOOP, vm::OP_READ_ARG, 0, vm::OP_SET_VAR, 0, vm::OP_READ_ARG, 1, vm::OP_SET_VAR, 1, vm::OP_LOOP_END, vm::OP_HALT }));
+            { vm::OP_START, vm::OP_WARP, vm::OP_CONST, 1, vm::OP_REPEAT_LOOP, 9, vm::OP_READ_ARG, 0, vm::OP_SET_VAR, 0, vm::OP_READ_ARG, 1, vm::OP_SET_VAR, 1, vm::OP_LOOP_END, vm::OP_HALT }));
 
     definition = nullptr;
     for (auto block : stage->blocks()) {
@@ -802,7 +1193,7 @@ TEST_F(CompilerTest, MultipleTargets)
 
     auto sprite1 = engine.targetAt(engine.findTarget("Sprite1"));
     auto script = scripts.at(sprite1->greenFlagBlocks().at(0));
-    ASSERT_EQ(script->bytecodeVector().size(), 33);
+    ASSERT_EQ(script->bytecodeVector().size(), 32);
     auto vm = script->start();
     ASSERT_EQ(vm->target(), sprite1);
     ASSERT_EQ(vm->engine(), &engine);
@@ -0,0 +1,127 @@
+#include <scratchcpp/disassembler.h>
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/project.h>
+#include <scratchcpp/iengine.h>
+#include <scratchcpp/script.h>
+#include <scratchcpp/variable.h>
+#include <scratchcpp/list.h>
+
+#include "../common.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+static const std::vector<unsigned int> bytecode = { OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_READ_VAR, 0, OP_IF, 3, OP_CONST, 1, OP_LIST_APPEND, 0, OP_ENDIF, OP_HALT };
+
+TEST(DisassemblerTest, OpcodeName)
+{
+    ASSERT_EQ(Disassembler::opcodeName(OP_START), "OP_START");
+    ASSERT_EQ(Disassembler::opcodeName(OP_CONST), "OP_CONST");
+    ASSERT_EQ(Disassembler::opcodeName(OP_LIST_APPEND), "OP_LIST_APPEND");
+    ASSERT_EQ(Disassembler::opcodeName(OP_STR_CONCAT_VAR), "OP_STR_CONCAT_VAR");
+    ASSERT_EQ(Disassembler::opcodeName(OP_VAR_APPEND_STR), "OP_VAR_APPEND_STR");
+    ASSERT_EQ(Disassembler::opcodeName(OP_VAR_APPEND_STR + 1), "<invalid " + std::to_string(OP_VAR_APPEND_STR + 1) + ">");
+}
+
+TEST(DisassemblerTest, Instructions)
+{
+    Disassembler disassembler(bytecode);
+    ASSERT_EQ(disassembler.bytecode(), bytecode);
+    ASSERT_EQ(disassembler.opcodes(), std::vector<unsigned int>({ OP_START, OP_CONST, OP_SET_VAR, OP_READ_VAR, OP_IF, OP_CONST, OP_LIST_APPEND, OP_ENDIF, OP_HALT }));
+    ASSERT_EQ(disassembler.instructionCount(), 9);
+    ASSERT_EQ(disassembler.instructionCount(OP_CONST), 2);
+    ASSERT_EQ(disassembler.instructionCount(OP_IF), 1);
+    ASSERT_EQ(disassembler.instructionCount(OP_ELSE), 0);
+}
+
+TEST(DisassemblerTest, InvalidBytecode)
+{
+    // Invalid instructions end the list
+    Disassembler disassembler1({ OP_START, OP_NULL, 1000, OP_NULL, OP_HALT });
+    ASSERT_EQ(disassembler1.opcodes(), std::vector<unsigned int>({ OP_START, OP_NULL }));
+
+    // Missing arguments
+    Disassembler disassembler2({ OP_START, OP_NULL, OP_CONST });
+    ASSERT_EQ(disassembler2.opcodes(), std::vector<unsigned int>({ OP_START, OP_NULL }));
+    ASSERT_EQ(disassembler2.toString(), "0: OP_START\n1: OP_NULL\n");
+}
+
+TEST(DisassemblerTest, ToString)
+{
+    Disassembler disassembler(bytecode);
+    ASSERT_EQ(
+        disassembler.toString(),
+        "0: OP_START\n"
+        "1: OP_CONST 0\n"
+        "3: OP_SET_VAR 0\n"
+        "5: OP_READ_VAR 0\n"
+        "7: OP_IF 3 ; -> 12\n"
+        "9: OP_CONST 1\n"
+        "11: OP_LIST_APPEND 0\n"
+        "13: OP_ENDIF\n"
+        "14: OP_HALT\n");
+
+    Variable var("a", "var");
+    List list("b", "list");
+    disassembler.setConstValues({ "hello", 5.5 });
+    disassembler.setVariables({ &var });
+    disassembler.setLists({ &list });
+    ASSERT_EQ(
+        disassembler.toString(),
+        "0: OP_START\n"
+        "1: OP_CONST 0 ; \"hello\"\n"
+        "3: OP_SET_VAR 0 ; var\n"
+        "5: OP_READ_VAR 0 ; var\n"
+        "7: OP_IF 3 ; -> 12\n"
+        "9: OP_CONST 1 ; 5.5\n"
+        "11: OP_LIST_APPEND 0 ; list\n"
+        "13: OP_ENDIF\n"
+        "14: OP_HALT\n");
+}
+
+TEST(DisassemblerTest, MultipleArguments)
+{
+    Variable var1("a", "var1");
+    Variable var2("b", "var2");
+    List list("c", "list");
+    Disassembler disassembler({ OP_START, OP_CHANGE_VAR_CONST, 1, 0, OP_IF_VAR_EQ_CONST, 0, 0, 1, OP_LIST_GET_VAR_INDEX, 0, 1, OP_HALT });
+    disassembler.setConstValues({ 1 });
+    disassembler.setVariables({ &var1, &var2 });
+    disassembler.setLists({ &list });
+    ASSERT_EQ(
+        disassembler.toString(),
+        "0: OP_START\n"
+        "1: OP_CHANGE_VAR_CONST 1 0 ; var2, 1\n"
+        "4: OP_IF_VAR_EQ_CONST 0 0 1 ; var1, 1, -> 9\n"
+        "8: OP_LIST_GET_VAR_INDEX 0 1 ; list, var2\n"
+        "11: OP_HALT\n");
+}
+
+TEST(DisassemblerTest, Script)
+{
+    Variable var("a", "var");
+    Script script(nullptr, nullptr);
+    script.setBytecode({ OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_HALT });
+    script.setConstValues({ "test" });
+    script.setVariables({ &var });
+
+    Disassembler disassembler(&script);
+    ASSERT_EQ(disassembler.bytecode(), script.bytecodeVector());
+    ASSERT_EQ(disassembler.toString(), "0: OP_START\n1: OP_CONST 0 ; \"test\"\n3: OP_SET_VAR 0 ; var\n5: OP_HALT\n");
+}
+
+TEST(DisassemblerTest, BytecodeReport)
+{
+    Project p("repeat10.sb3");
+    ASSERT_TRUE(p.load());
+    std::string report = p.engine()->bytecodeReport();
+
+    ASSERT_NE(report.find("event_whenflagclicked"), std::string::npos);
+    ASSERT_NE(report.find("    words: "), std::string::npos);
+    ASSERT_NE(report.find("    instructions: "), std::string::npos);
+    ASSERT_NE(report.find("    procedure calls: 0\n"), std::string::npos);
+    ASSERT_NE(report.find("    OP_HALT: 1\n"), std::string::npos);
+
+    // The report doesn't depend on the order of the scripts
+    ASSERT_EQ(p.engine()->bytecodeReport(), report);
+}
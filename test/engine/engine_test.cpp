@@ -79,6 +79,22 @@ TEST(EngineTest, EventLoop)
     th.join(); // should return immediately
 }
 
+TEST(EngineTest, EventLoopAfterStop)
+{
+    Engine engine;
+
+    std::thread th1([&engine]() { engine.runEventLoop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    engine.stopEventLoop();
+    th1.join();
+
+    // The event loop can run and be stopped again
+    std::thread th2([&engine]() { engine.runEventLoop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    engine.stopEventLoop();
+    th2.join();
+}
+
 TEST(EngineTest, Fps)
 {
     Engine engine;
@@ -154,6 +170,30 @@ TEST(EngineTest, TurboModeEnabled)
     ASSERT_FALSE(engine.turboModeEnabled());
 }
 
+TEST(EngineTest, WarpTime)
+{
+    Engine engine;
+    ASSERT_EQ(engine.warpTime(), 500);
+
+    engine.setWarpTime(100);
+    ASSERT_EQ(engine.warpTime(), 100);
+
+    engine.setWarpTime(0);
+    ASSERT_EQ(engine.warpTime(), 0);
+}
+
+TEST(EngineTest, CompilerOptimizationsEnabled)
+{
+    Engine engine;
+    ASSERT_TRUE(engine.compilerOptimizationsEnabled());
+
+    engine.setCompilerOptimizationsEnabled(false);
+    ASSERT_FALSE(engine.compilerOptimizationsEnabled());
+
+    engine.setCompilerOptimizationsEnabled(true);
+    ASSERT_TRUE(engine.compilerOptimizationsEnabled());
+}
+
 TEST(EngineTest, ExecutionOrder)
 {
     Project p("execution_order.sb3");
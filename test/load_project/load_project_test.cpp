@@ -11,11 +11,41 @@
 #include <scratchcpp/sound.h>
 #include <scratchcpp/sprite.h>
 #include <scratchcpp/inputvalue.h>
+#include <scratchcpp/script.h>
+#include <map>
+#include <sstream>
 
 #include "../common.h"
 
 using namespace libscratchcpp;
 
+using Snapshot = std::map<std::string, std::string>;
+
+static Snapshot snapshot(IEngine *engine)
+{
+    Snapshot ret;
+
+    for (auto target : engine->targets()) {
+        for (auto var : target->variables())
+            ret[target->name() + "/var/" + var->name()] = var->value().toString();
+
+        for (auto list : target->lists())
+            ret[target->name() + "/list/" + list->name()] = list->toString();
+    }
+
+    return ret;
+}
+
+static std::map<std::string, std::vector<unsigned int>> scriptBytecode(IEngine *engine)
+{
+    std::map<std::string, std::vector<unsigned int>> ret;
+
+    for (const auto &[block, script] : engine->scripts())
+        ret[script->target()->name() + "/" + block->id()] = script->bytecodeVector();
+
+    return ret;
+}
+
 static const std::vector<ScratchVersion> scratchVersions = { ScratchVersion::Scratch3 };
 static const std::vector<std::string> fileExtensions = { ".sb3" };
 
@@ -332,3 +362,103 @@ TEST(LoadProjectTest, ProjectInvalidTest)
     ASSERT_EQ(p.scratchVersion(), ScratchVersion::Invalid);
     ASSERT_FALSE(p.load());
 }
+
+TEST(LoadProjectTest, BytecodeCache)
+{
+    static const std::vector<std::string> projects = { "repeat10", "execution_order", "broadcasts", "backdrop_broadcasts", "clones", "stop_other_scripts_in_sprite", "custom_blocks" };
+
+    for (const std::string &name : projects) {
+        std::string cacheFileName = (std::filesystem::temp_directory_path() / ("scratchcpp_cache_" + name + ".bin")).string();
+        std::filesystem::remove(cacheFileName);
+
+        // Compile the scripts and write the cache
+        Project p1(name + ".sb3");
+        p1.setCacheFileName(cacheFileName);
+        ASSERT_EQ(p1.cacheFileName(), cacheFileName);
+        ASSERT_TRUE(p1.load());
+        ASSERT_TRUE(std::filesystem::exists(cacheFileName)) << name;
+
+        // Load the scripts from the cache
+        Project p2(name + ".sb3");
+        p2.setCacheFileName(cacheFileName);
+        testing::internal::CaptureStdout();
+        ASSERT_TRUE(p2.load());
+        ASSERT_EQ(testing::internal::GetCapturedStdout().find("Compiling scripts"), std::string::npos) << name;
+        ASSERT_EQ(scriptBytecode(p2.engine().get()), scriptBytecode(p1.engine().get())) << name;
+
+        p1.run();
+        p2.run();
+        ASSERT_EQ(snapshot(p2.engine().get()), snapshot(p1.engine().get())) << name;
+
+        std::filesystem::remove(cacheFileName);
+    }
+}
+
+TEST(LoadProjectTest, BytecodeCacheAfterRecompiling)
+{
+    Project p("bubble_sort.sb3");
+    ASSERT_TRUE(p.load());
+    auto engine = p.engine();
+    std::stringstream stream1;
+    ASSERT_TRUE(engine->saveBytecodeCache(stream1, "key"));
+
+    // The scripts which add block functions are recorded again
+    engine->compile();
+    std::stringstream stream2;
+    ASSERT_TRUE(engine->saveBytecodeCache(stream2, "key"));
+    ASSERT_EQ(stream2.str(), stream1.str());
+}
+
+TEST(LoadProjectTest, InvalidBytecodeCache)
+{
+    Project p("broadcasts.sb3");
+    ASSERT_TRUE(p.load());
+    auto engine = p.engine();
+    std::stringstream stream;
+    ASSERT_TRUE(engine->saveBytecodeCache(stream, "key"));
+    std::string data = stream.str();
+
+    std::stringstream stream1(data);
+    ASSERT_TRUE(engine->loadBytecodeCache(stream1, "key"));
+
+    // Different project
+    std::stringstream stream2(data);
+    ASSERT_FALSE(engine->loadBytecodeCache(stream2, "other"));
+
+    // Different compiler optimizations
+    engine->setCompilerOptimizationsEnabled(false);
+    std::stringstream stream3(data);
+    ASSERT_FALSE(engine->loadBytecodeCache(stream3, "key"));
+    engine->setCompilerOptimizationsEnabled(true);
+
+    // Truncated or invalid data
+    for (size_t size : { (size_t)0, (size_t)10, data.size() / 2, data.size() - 1 }) {
+        std::stringstream stream4(data.substr(0, size));
+        ASSERT_FALSE(engine->loadBytecodeCache(stream4, "key")) << size;
+    }
+
+    std::stringstream stream5("not a cache");
+    ASSERT_FALSE(engine->loadBytecodeCache(stream5, "key"));
+
+    // Different block functions (the function count follows the magic, 3 integers, the key, the optimizations flag and the target counts)
+    std::stringstream stream6;
+    ASSERT_TRUE(engine->saveBytecodeCache(stream6, "key"));
+    ASSERT_EQ(stream6.str(), data);
+    size_t functionCountPos = sizeof("SCRATCHCPP-BYTECODE") + 3 * sizeof(uint32_t) + sizeof(uint32_t) + 3 + sizeof(uint32_t) + sizeof(uint32_t) + engine->targets().size() * 3 * sizeof(uint32_t);
+    std::string invalidData = data;
+    invalidData[functionCountPos]++;
+    std::stringstream stream7(invalidData);
+    ASSERT_FALSE(engine->loadBytecodeCache(stream7, "key"));
+
+    // A failed load doesn't change the engine
+    std::stringstream stream8;
+    ASSERT_TRUE(engine->saveBytecodeCache(stream8, "key"));
+    ASSERT_EQ(stream8.str(), data);
+
+    // The scripts loaded from the valid cache are kept
+    Project expected("broadcasts.sb3");
+    ASSERT_TRUE(expected.load());
+    expected.run();
+    p.run();
+    ASSERT_EQ(snapshot(engine.get()), snapshot(expected.engine().get()));
+}
@@ -13,6 +13,11 @@ class EngineMock : public IEngine
     public:
         MOCK_METHOD(void, clear, (), (override));
         MOCK_METHOD(void, compile, (), (override));
+        MOCK_METHOD(bool, saveBytecodeCache, (std::ostream &, const std::string &), (const, override));
+        MOCK_METHOD(bool, loadBytecodeCache, (std::istream &, const std::string &), (override));
+
+        MOCK_METHOD(bool, compilerOptimizationsEnabled, (), (const, override));
+        MOCK_METHOD(void, setCompilerOptimizationsEnabled, (bool), (override));
 
         MOCK_METHOD(void, start, (), (override));
         MOCK_METHOD(void, stop, (), (override));
@@ -38,6 +43,9 @@ class EngineMock : public IEngine
         MOCK_METHOD(bool, turboModeEnabled, (), (const, override));
         MOCK_METHOD(void, setTurboModeEnabled, (bool), (override));
 
+        MOCK_METHOD(int, warpTime, (), (const, override));
+        MOCK_METHOD(void, setWarpTime, (int), (override));
+
         MOCK_METHOD(bool, keyPressed, (const std::string &), (const, override));
         MOCK_METHOD(void, setKeyState, (const std::string &, bool), (override));
         MOCK_METHOD(void, setAnyKeyPressed, (bool), (override));
@@ -72,6 +80,10 @@ class EngineMock : public IEngine
 
         MOCK_METHOD(ITimer *, timer, (), (const, override));
 
+        MOCK_METHOD(Profiler *, profiler, (), (const, override));
+        MOCK_METHOD(Tracer *, tracer, (), (const, override));
+        MOCK_METHOD(std::string, bytecodeReport, (), (const, override));
+
         MOCK_METHOD(void, registerSection, (std::shared_ptr<IBlockSection>), (override));
         MOCK_METHOD(unsigned int, functionIndex, (BlockFunc), (override));
 
@@ -0,0 +1,133 @@
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/block.h>
+#include <engine/internal/procedureinliner.h>
+
+#include "../common.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+static const std::vector<unsigned int> procedure1 = { OP_START, OP_READ_ARG, 1, OP_PRINT, OP_READ_ARG, 0, OP_PRINT, OP_HALT };
+static const std::vector<unsigned int> procedure2 = { OP_START, OP_INIT_PROCEDURE, OP_READ_ARG, 0, OP_ADD_ARG, OP_READ_ARG, 0, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_HALT };
+static const std::vector<unsigned int> recursiveProcedure = { OP_START, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE, 2, OP_HALT };
+
+static std::string run(std::vector<unsigned int> bytecode)
+{
+    static Value constValues[] = { "hello", "world", "test" };
+    VirtualMachine vm;
+    vm.setBytecode(bytecode.data());
+    vm.setConstValues(constValues);
+    testing::internal::CaptureStdout();
+    vm.run();
+    EXPECT_TRUE(vm.atEnd());
+    EXPECT_EQ(vm.registerCount(), 0);
+    return testing::internal::GetCapturedStdout();
+}
+
+TEST(ProcedureInlinerTest, MaxProcedureSize)
+{
+    std::vector<const std::vector<unsigned int> *> procedures = { &procedure1 };
+    ProcedureInliner inliner(procedures);
+    ASSERT_EQ(inliner.maxProcedureSize(), 64);
+
+    inliner.setMaxProcedureSize(5);
+    ASSERT_EQ(inliner.maxProcedureSize(), 5);
+
+    std::vector<unsigned int> bytecode = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_HALT };
+    ASSERT_EQ(inliner.process(bytecode), bytecode);
+}
+
+TEST(ProcedureInlinerTest, InlineProcedure)
+{
+    std::vector<const std::vector<unsigned int> *> procedures = { &procedure1 };
+    ProcedureInliner inliner(procedures);
+
+    std::vector<unsigned int> bytecode = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_HALT };
+    std::vector<unsigned int> inlined = inliner.process(bytecode);
+    ASSERT_EQ(
+        inlined,
+        std::vector<unsigned int>(
+            { OP_START, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_READ_INLINE_ARG, 1, OP_PRINT, OP_READ_INLINE_ARG, 2, OP_PRINT, OP_FREE_INLINE_ARGS, 2, OP_HALT }));
+    ASSERT_EQ(run(inlined), "world\nhello\n");
+}
+
+TEST(ProcedureInlinerTest, Blocks)
+{
+    std::vector<const std::vector<unsigned int> *> procedures = { &procedure1 };
+    ProcedureInliner inliner(procedures);
+    Block b1("a", ""), b2("b", ""), b3("c", "");
+
+    // The inlined procedure belongs to the block which calls it
+    std::vector<unsigned int> bytecode = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_HALT };
+    std::vector<Block *> blocks = { &b1, &b3, &b2, &b2, &b2, &b2, &b2, &b2, &b3, &b3, nullptr };
+    std::vector<unsigned int> inlined = inliner.process(bytecode, &blocks);
+    ASSERT_EQ(inlined.size(), 16);
+    ASSERT_EQ(blocks, std::vector<Block *>({ &b1, &b2, &b2, &b2, &b2, &b2, &b2, &b3, &b3, &b3, &b3, &b3, &b3, &b3, &b3, nullptr }));
+
+    // Blocks which don't match the bytecode are ignored
+    blocks = { &b1 };
+    ASSERT_EQ(inliner.process(bytecode, &blocks), inlined);
+    ASSERT_EQ(blocks, std::vector<Block *>({ &b1 }));
+}
+
+TEST(ProcedureInlinerTest, NestedProcedures)
+{
+    // procedure2 calls procedure1, so both are inlined
+    std::vector<const std::vector<unsigned int> *> procedures = { &procedure1, &procedure2 };
+    ProcedureInliner inliner(procedures);
+
+    ASSERT_EQ(
+        inliner.process(procedure2),
+        std::vector<unsigned int>(
+            { OP_START, OP_READ_ARG, 0, OP_ADD_ARG, OP_READ_ARG, 0, OP_ADD_ARG, OP_READ_INLINE_ARG, 1, OP_PRINT, OP_READ_INLINE_ARG, 2, OP_PRINT, OP_FREE_INLINE_ARGS, 2, OP_HALT }));
+
+    std::vector<unsigned int> bytecode = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 2, OP_ADD_ARG, OP_CALL_PROCEDURE, 1, OP_HALT };
+    std::vector<unsigned int> inlined = inliner.process(bytecode);
+    ASSERT_EQ(
+        inlined,
+        std::vector<unsigned int>({ OP_START, OP_CONST, 2, OP_ADD_ARG, OP_READ_INLINE_ARG, 1, OP_ADD_ARG, OP_READ_INLINE_ARG, 2, OP_ADD_ARG, OP_READ_INLINE_ARG, 1, OP_PRINT,
+                                    OP_READ_INLINE_ARG, 2, OP_PRINT, OP_FREE_INLINE_ARGS, 2, OP_FREE_INLINE_ARGS, 1, OP_HALT }));
+    ASSERT_EQ(run(inlined), "test\ntest\n");
+}
+
+TEST(ProcedureInlinerTest, Jumps)
+{
+    std::vector<const std::vector<unsigned int> *> procedures = { &procedure1 };
+    ProcedureInliner inliner(procedures);
+
+    std::vector<unsigned int> bytecode = { OP_START, OP_NULL, OP_NOT, OP_IF, 10, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_ENDIF, OP_HALT };
+    std::vector<unsigned int> inlined = inliner.process(bytecode);
+    ASSERT_EQ(inlined,
+              std::vector<unsigned int>({ OP_START, OP_NULL, OP_NOT, OP_IF, 15, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_READ_INLINE_ARG, 1, OP_PRINT, OP_READ_INLINE_ARG, 2,
+                                          OP_PRINT, OP_FREE_INLINE_ARGS, 2, OP_ENDIF, OP_HALT }));
+    ASSERT_EQ(run(inlined), "world\nhello\n");
+}
+
+TEST(ProcedureInlinerTest, NotInlinable)
+{
+    std::vector<unsigned int> warpProcedure = { OP_START, OP_WARP, OP_NULL, OP_PRINT, OP_HALT };
+    std::vector<unsigned int> stopProcedure = { OP_START, OP_NULL, OP_IF, 1, OP_HALT, OP_ENDIF, OP_HALT };
+    std::vector<const std::vector<unsigned int> *> procedures = { &procedure1, nullptr, &recursiveProcedure, &warpProcedure, &stopProcedure };
+    ProcedureInliner inliner(procedures);
+
+    // Missing procedure
+    std::vector<unsigned int> bytecode1 = { OP_START, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE, 1, OP_HALT };
+    ASSERT_EQ(inliner.process(bytecode1), bytecode1);
+
+    // Recursive procedure
+    std::vector<unsigned int> bytecode2 = { OP_START, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE, 2, OP_HALT };
+    ASSERT_EQ(inliner.process(bytecode2), bytecode2);
+    ASSERT_EQ(inliner.process(recursiveProcedure), recursiveProcedure);
+
+    // Warp mode and "stop this script" depend on the call tree
+    std::vector<unsigned int> bytecode3 = { OP_START, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE, 3, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE, 4, OP_HALT };
+    ASSERT_EQ(inliner.process(bytecode3), bytecode3);
+
+    // The procedure reads more arguments than are added
+    std::vector<unsigned int> bytecode4 = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_HALT };
+    ASSERT_EQ(inliner.process(bytecode4), bytecode4);
+
+    // Invalid bytecode
+    std::vector<unsigned int> bytecode5 = { OP_START, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE };
+    ASSERT_EQ(inliner.process(bytecode5), bytecode5);
+}
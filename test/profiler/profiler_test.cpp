@@ -0,0 +1,196 @@
+#include <scratchcpp/profiler.h>
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/project.h>
+#include <scratchcpp/iengine.h>
+#include <scratchcpp/script.h>
+#include <scratchcpp/block.h>
+#include <scratchcpp/stage.h>
+#include <scratchcpp/sprite.h>
+
+#include "../common.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+static unsigned int function1(VirtualMachine *)
+{
+    return 0;
+}
+
+static unsigned int function2(VirtualMachine *)
+{
+    return 1;
+}
+
+TEST(ProfilerTest, Enabled)
+{
+    Profiler profiler;
+    ASSERT_FALSE(profiler.enabled());
+
+    profiler.setEnabled(true);
+    ASSERT_TRUE(profiler.enabled());
+
+    profiler.setEnabled(false);
+    ASSERT_FALSE(profiler.enabled());
+}
+
+TEST(ProfilerTest, Sampling)
+{
+    Profiler profiler;
+    ASSERT_FALSE(profiler.samplingEnabled());
+    ASSERT_EQ(profiler.sampleInterval(), 1000);
+
+    profiler.setSamplingEnabled(true);
+    ASSERT_TRUE(profiler.samplingEnabled());
+
+    profiler.setSampleInterval(50);
+    ASSERT_EQ(profiler.sampleInterval(), 50);
+
+    profiler.setSampleInterval(0);
+    ASSERT_EQ(profiler.sampleInterval(), 1);
+
+    Stage stage;
+    stage.setName("Stage");
+    Sprite sprite;
+    sprite.setName("Sprite1");
+    Block b1("b", "a"), b2("d", "c"), b3("f", "e");
+    b1.setTarget(&stage);
+    b2.setTarget(&sprite);
+    b3.setTarget(&sprite);
+
+    ASSERT_TRUE(profiler.foldedStacks().empty());
+    profiler.addSample({ &b1 }, std::chrono::nanoseconds(10));
+    profiler.addSample({ &b2, &b3 }, std::chrono::nanoseconds(4));
+    profiler.addSample({ &b1 }, std::chrono::nanoseconds(5));
+    ASSERT_EQ(profiler.foldedStacks(), "Sprite1;c [d];e [f] 4\nStage;a [b] 15\n");
+
+    profiler.reset();
+    ASSERT_TRUE(profiler.foldedStacks().empty());
+}
+
+TEST(ProfilerTest, Record)
+{
+    Profiler profiler;
+    ASSERT_EQ(profiler.opcodeCount(OP_ADD), 0);
+    ASSERT_EQ(profiler.opcodeTime(OP_ADD), std::chrono::nanoseconds::zero());
+    ASSERT_TRUE(profiler.functions().empty());
+    ASSERT_EQ(profiler.totalTime(), std::chrono::nanoseconds::zero());
+
+    profiler.addOpcode(OP_ADD, std::chrono::nanoseconds(5));
+    profiler.addOpcode(OP_ADD, std::chrono::nanoseconds(3));
+    profiler.addOpcode(OP_EXEC, std::chrono::nanoseconds(20));
+    profiler.addFunction(&function2, std::chrono::nanoseconds(15));
+    profiler.addFunction(&function1, std::chrono::nanoseconds(4));
+    profiler.addFunction(&function2, std::chrono::nanoseconds(1));
+
+    ASSERT_EQ(profiler.opcodeCount(OP_ADD), 2);
+    ASSERT_EQ(profiler.opcodeTime(OP_ADD), std::chrono::nanoseconds(8));
+    ASSERT_EQ(profiler.opcodeCount(OP_EXEC), 1);
+    ASSERT_EQ(profiler.opcodeTime(OP_EXEC), std::chrono::nanoseconds(20));
+    ASSERT_EQ(profiler.opcodeCount(OP_SUBTRACT), 0);
+    ASSERT_EQ(profiler.totalTime(), std::chrono::nanoseconds(28));
+
+    ASSERT_EQ(profiler.functions(), std::vector<BlockFunc>({ &function2, &function1 }));
+    ASSERT_EQ(profiler.functionCount(&function1), 1);
+    ASSERT_EQ(profiler.functionTime(&function1), std::chrono::nanoseconds(4));
+    ASSERT_EQ(profiler.functionCount(&function2), 2);
+    ASSERT_EQ(profiler.functionTime(&function2), std::chrono::nanoseconds(16));
+
+    profiler.reset();
+    ASSERT_EQ(profiler.opcodeCount(OP_ADD), 0);
+    ASSERT_TRUE(profiler.functions().empty());
+    ASSERT_EQ(profiler.functionCount(&function2), 0);
+    ASSERT_EQ(profiler.totalTime(), std::chrono::nanoseconds::zero());
+}
+
+TEST(ProfilerTest, VirtualMachine)
+{
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, 6, OP_EXEC, 0, OP_NULL, OP_EXEC, 1, OP_LOOP_END, OP_HALT };
+    static BlockFunc functions[] = { &function1, &function2 };
+    static Value constValues[] = { 3 };
+
+    Profiler profiler;
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setFunctions(functions);
+    vm.setConstValues(constValues);
+    vm.setProfiler(&profiler);
+    ASSERT_EQ(vm.profiler(), &profiler);
+
+    // Nothing is recorded while the profiler is disabled
+    vm.run();
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(profiler.opcodeCount(OP_HALT), 0);
+
+    profiler.setEnabled(true);
+    vm.reset();
+    vm.run();
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(vm.registerCount(), 0);
+    ASSERT_EQ(profiler.opcodeCount(OP_CONST), 1);
+    ASSERT_EQ(profiler.opcodeCount(OP_REPEAT_LOOP), 1);
+    ASSERT_EQ(profiler.opcodeCount(OP_EXEC), 6);
+    ASSERT_EQ(profiler.opcodeCount(OP_NULL), 3);
+    ASSERT_EQ(profiler.opcodeCount(OP_LOOP_END), 3);
+    ASSERT_EQ(profiler.opcodeCount(OP_HALT), 1);
+    ASSERT_EQ(profiler.functions(), std::vector<BlockFunc>({ &function1, &function2 }));
+    ASSERT_EQ(profiler.functionCount(&function1), 3);
+    ASSERT_EQ(profiler.functionCount(&function2), 3);
+}
+
+TEST(ProfilerTest, Engine)
+{
+    Project p("repeat10.sb3");
+    ASSERT_TRUE(p.load());
+
+    auto engine = p.engine();
+    Profiler *profiler = engine->profiler();
+    ASSERT_TRUE(profiler);
+    ASSERT_FALSE(profiler->enabled());
+
+    profiler->setEnabled(true);
+    p.run();
+    ASSERT_GT(profiler->opcodeCount(OP_HALT), 0);
+    ASSERT_GT(profiler->opcodeCount(OP_LOOP_END), 0);
+}
+
+TEST(ProfilerTest, SampleBlocks)
+{
+    Block b1("a", "event_whenflagclicked"), b2("b;c", "looks_say"), b3("d", "motion_movesteps");
+    Script script(nullptr, nullptr);
+    script.setBytecode({ OP_START, OP_NULL, OP_EXEC, 1, OP_HALT });
+    script.setBytecodeBlocks({ &b1, &b2, &b3, &b3, nullptr });
+    static BlockFunc functions[] = { &function1, &function2 };
+
+    Profiler profiler;
+    profiler.setSamplingEnabled(true);
+    profiler.setSampleInterval(1);
+    VirtualMachine vm(nullptr, nullptr, &script);
+    vm.setBytecode(script.bytecode());
+    vm.setFunctions(functions);
+    vm.setProfiler(&profiler);
+    vm.run();
+    ASSERT_TRUE(vm.atEnd());
+
+    // Semicolons in the IDs are replaced
+    std::string stacks = profiler.foldedStacks();
+    ASSERT_NE(stacks.find("\nevent_whenflagclicked [a];looks_say [b_c] "), std::string::npos);
+    ASSERT_NE(stacks.find("\nevent_whenflagclicked [a];motion_movesteps [d] "), std::string::npos);
+    ASSERT_EQ(profiler.opcodeCount(OP_EXEC), 0);
+}
+
+TEST(ProfilerTest, SampleCustomBlocks)
+{
+    Project p("custom_blocks.sb3");
+    ASSERT_TRUE(p.load());
+
+    auto engine = p.engine();
+    engine->profiler()->setSamplingEnabled(true);
+    engine->profiler()->setSampleInterval(1);
+    p.run();
+
+    // Custom blocks which run without screen refresh aren't inlined, so they're in the call chain
+    std::string stacks = engine->profiler()->foldedStacks();
+    ASSERT_NE(stacks.find("Stage;event_whenflagclicked [h];test %s %b [a];define test %s %b [d];"), std::string::npos);
+    ASSERT_NE(stacks.find("Stage;event_whenflagclicked [h];no warp test [k] "), std::string::npos);
+}
@@ -6,6 +6,8 @@
 
 using namespace libscratchcpp;
 
+using ::testing::Return;
+
 class ProjectTest : public testing::Test
 {
     public:
@@ -112,6 +114,70 @@ TEST_F(ProjectTest, Load)
     testing::Mock::AllowLeak(m_engine.get());
 }
 
+TEST_F(ProjectTest, LoadWithCache)
+{
+    std::string cacheFileName = (std::filesystem::temp_directory_path() / "scratchcpp_project_test_cache.bin").string();
+    std::filesystem::remove(cacheFileName);
+
+    // The cache doesn't exist
+    ProjectPrivate p1("default_project.sb3");
+    p1.engine = m_engine;
+    p1.cacheFileName = cacheFileName;
+    EXPECT_CALL(*m_engine, clear);
+    EXPECT_CALL(*m_engine, setTargets);
+    EXPECT_CALL(*m_engine, setBroadcasts);
+    EXPECT_CALL(*m_engine, setExtensions);
+    EXPECT_CALL(*m_engine, loadBytecodeCache).Times(0);
+    EXPECT_CALL(*m_engine, compile);
+    EXPECT_CALL(*m_engine, saveBytecodeCache).WillOnce(Return(true));
+    ASSERT_TRUE(p1.load());
+    ASSERT_TRUE(std::filesystem::exists(cacheFileName));
+
+    // The cache exists and is valid
+    ProjectPrivate p2("default_project.sb3");
+    p2.engine = m_engine;
+    p2.cacheFileName = cacheFileName;
+    EXPECT_CALL(*m_engine, clear);
+    EXPECT_CALL(*m_engine, setTargets);
+    EXPECT_CALL(*m_engine, setBroadcasts);
+    EXPECT_CALL(*m_engine, setExtensions);
+    EXPECT_CALL(*m_engine, loadBytecodeCache).WillOnce(Return(true));
+    EXPECT_CALL(*m_engine, compile).Times(0);
+    EXPECT_CALL(*m_engine, saveBytecodeCache).Times(0);
+    ASSERT_TRUE(p2.load());
+
+    // The cache is invalid
+    ProjectPrivate p3("default_project.sb3");
+    p3.engine = m_engine;
+    p3.cacheFileName = cacheFileName;
+    EXPECT_CALL(*m_engine, clear);
+    EXPECT_CALL(*m_engine, setTargets);
+    EXPECT_CALL(*m_engine, setBroadcasts);
+    EXPECT_CALL(*m_engine, setExtensions);
+    EXPECT_CALL(*m_engine, loadBytecodeCache).WillOnce(Return(false));
+    EXPECT_CALL(*m_engine, compile);
+    EXPECT_CALL(*m_engine, saveBytecodeCache).WillOnce(Return(true));
+    ASSERT_TRUE(p3.load());
+    ASSERT_TRUE(std::filesystem::exists(cacheFileName));
+
+    // The scripts can't be saved
+    ProjectPrivate p4("default_project.sb3");
+    p4.engine = m_engine;
+    p4.cacheFileName = cacheFileName;
+    EXPECT_CALL(*m_engine, clear);
+    EXPECT_CALL(*m_engine, setTargets);
+    EXPECT_CALL(*m_engine, setBroadcasts);
+    EXPECT_CALL(*m_engine, setExtensions);
+    EXPECT_CALL(*m_engine, loadBytecodeCache).WillOnce(Return(false));
+    EXPECT_CALL(*m_engine, compile);
+    EXPECT_CALL(*m_engine, saveBytecodeCache).WillOnce(Return(false));
+    ASSERT_TRUE(p4.load());
+    ASSERT_FALSE(std::filesystem::exists(cacheFileName));
+
+    std::filesystem::remove(cacheFileName);
+    testing::Mock::AllowLeak(m_engine.get());
+}
+
 TEST_F(ProjectTest, Start)
 {
     ProjectPrivate p("default_project.sb3");
@@ -137,6 +203,14 @@ TEST_F(ProjectTest, FileName)
     ASSERT_EQ(p.fileName(), "test.sb3");
 }
 
+TEST_F(ProjectTest, CacheFileName)
+{
+    Project p;
+    ASSERT_TRUE(p.cacheFileName().empty());
+    p.setCacheFileName("cache.bin");
+    ASSERT_EQ(p.cacheFileName(), "cache.bin");
+}
+
 TEST_F(ProjectTest, ScratchVersion)
 {
     Project p;
@@ -852,6 +852,19 @@ TEST(ValueTest, ToDouble)
     v = "-9432.4e+6";
     ASSERT_EQ(v.toDouble(), -9.4324e+9);
 
+    v = "+255.625";
+    ASSERT_EQ(v.toDouble(), 255.625);
+    v = "+-255.625";
+    ASSERT_EQ(v.toDouble(), 0.0);
+    v = "  255.625 ";
+    ASSERT_EQ(v.toDouble(), 255.625);
+    v = "+15";
+    ASSERT_EQ(v.toDouble(), 15.0);
+    v = "+-15";
+    ASSERT_EQ(v.toDouble(), 0.0);
+    v = "1e400";
+    ASSERT_EQ(v.toDouble(), 0.0);
+
     v = "false";
     ASSERT_EQ(v.toDouble(), 0.0);
     v = "true";
@@ -868,6 +881,50 @@ TEST(ValueTest, ToDouble)
     ASSERT_EQ(v.toDouble(), 0.0);
 }
 
+TEST(ValueTest, StringNumberCache)
+{
+    // Strings which aren't converted to numbers when they're assigned
+    Value v = " 42";
+    ASSERT_TRUE(v.isString());
+    ASSERT_EQ(v.toDouble(), 42);
+    ASSERT_EQ(v.toDouble(), 42);
+    ASSERT_EQ(v.toLong(), 0);
+    ASSERT_FALSE(v == 42);
+    ASSERT_TRUE(v > 41);
+
+    // The cache is invalidated when a string is assigned
+    v = " 7";
+    ASSERT_TRUE(v.isString());
+    ASSERT_EQ(v.toDouble(), 7);
+
+    v = std::string("abc");
+    ASSERT_EQ(v.toDouble(), 0);
+    ASSERT_EQ(v.toLong(), 0);
+    ASSERT_FALSE(v == 0);
+
+    v = "99999999999999999999";
+    ASSERT_TRUE(v.isString());
+    ASSERT_EQ(v.toDouble(), 1e20);
+    ASSERT_FALSE(v == 1e20);
+
+    // The cache is copied
+    Value v1 = " 3";
+    ASSERT_EQ(v1.toDouble(), 3);
+    Value v2 = v1;
+    ASSERT_EQ(v2.toDouble(), 3);
+    v = v1;
+    ASSERT_EQ(v.toDouble(), 3);
+    v1 = "test";
+    ASSERT_EQ(v1.toDouble(), 0);
+    ASSERT_EQ(v2.toDouble(), 3);
+
+    // The cache isn't used after assigning a number
+    v = 5.5;
+    ASSERT_EQ(v.toDouble(), 5.5);
+    v = " 8";
+    ASSERT_EQ(v.toDouble(), 8);
+}
+
 TEST(ValueTest, ToBool)
 {
     Value v = 2147483647;
@@ -995,6 +1052,16 @@ TEST(ValueTest, ToString)
     ASSERT_EQ(v.toString(), "-9.4324e+9");
     ASSERT_EQ(utf8::utf16to8(v.toUtf16()), v.toString());
 
+    v = 1e+100;
+    ASSERT_EQ(v.toString(), "1e+100");
+    ASSERT_EQ(utf8::utf16to8(v.toUtf16()), v.toString());
+    v = 1.5e-7;
+    ASSERT_EQ(v.toString(), "1.5e-7");
+    ASSERT_EQ(utf8::utf16to8(v.toUtf16()), v.toString());
+    v = 123456789.0;
+    ASSERT_EQ(v.toString(), "1.23457e+8");
+    ASSERT_EQ(utf8::utf16to8(v.toUtf16()), v.toString());
+
     v = "false";
     ASSERT_EQ(v.toString(), "false");
     ASSERT_EQ(utf8::utf16to8(v.toUtf16()), v.toString());
@@ -1020,6 +1087,129 @@ TEST(ValueTest, ToString)
     ASSERT_EQ(utf8::utf16to8(v.toUtf16()), v.toString());
 }
 
+TEST(ValueTest, Utf16Characters)
+{
+    // ASCII strings
+    Value v = "Hello, world!";
+    ASSERT_EQ(v.utf16Size(), 13);
+    ASSERT_EQ(v.utf16At(0), "H");
+    ASSERT_EQ(v.utf16At(12), "!");
+    ASSERT_EQ(v.utf16At(13), "");
+    ASSERT_EQ(v.utf16At(-1), "");
+
+    v = "";
+    ASSERT_EQ(v.utf16Size(), 0);
+    ASSERT_EQ(v.utf16At(0), "");
+
+    // Other types
+    v = -2.5;
+    ASSERT_EQ(v.utf16Size(), 4);
+    ASSERT_EQ(v.utf16At(0), "-");
+    ASSERT_EQ(v.utf16At(3), "5");
+    ASSERT_EQ(v.utf16At(4), "");
+
+    v = true;
+    ASSERT_EQ(v.utf16Size(), 4);
+    ASSERT_EQ(v.utf16At(1), "r");
+
+    v = Value(Value::SpecialValue::NegativeInfinity);
+    ASSERT_EQ(v.utf16Size(), 9);
+    ASSERT_EQ(v.utf16At(8), "y");
+
+    // Non-ASCII strings (the emoji is a surrogate pair in UTF-16)
+    v = "Příliš žluťoučký kůň 😀!";
+    std::u16string str = v.toUtf16();
+    ASSERT_EQ(v.utf16Size(), str.size());
+
+    for (size_t i = 0; i < str.size(); i++) {
+        if (i == 21 || i == 22)
+            ASSERT_EQ(v.utf16At(i), "");
+        else
+            ASSERT_EQ(v.utf16At(i), utf8::utf16to8(std::u16string({ str[i] })));
+    }
+
+    ASSERT_EQ(v.utf16At(1), "ř");
+    ASSERT_EQ(v.utf16At(23), "!");
+    ASSERT_EQ(v.utf16At(24), "");
+
+    // The ASCII flag is copied with the string
+    Value v2 = v;
+    ASSERT_EQ(v2.utf16Size(), 24);
+    ASSERT_EQ(v2.utf16At(1), "ř");
+
+    v2 = "abc";
+    ASSERT_EQ(v2.utf16At(1), "b");
+    v2 = v;
+    ASSERT_EQ(v2.utf16At(1), "ř");
+    v = std::string("ščř");
+    v2 = v;
+    ASSERT_EQ(v2.utf16Size(), 3);
+    ASSERT_EQ(v2.utf16At(2), "ř");
+}
+
+TEST(ValueTest, Append)
+{
+    Value v = "hello";
+    v.append(" world");
+    ASSERT_TRUE(v.isString());
+    ASSERT_EQ(v.toString(), "hello world");
+
+    v.append(5.25);
+    ASSERT_EQ(v.toString(), "hello world5.25");
+    v.append(true);
+    ASSERT_EQ(v.toString(), "hello world5.25true");
+    v.append(Value(Value::SpecialValue::Infinity));
+    ASSERT_EQ(v.toString(), "hello world5.25trueInfinity");
+    v.append(v);
+    ASSERT_EQ(v.toString(), "hello world5.25trueInfinityhello world5.25trueInfinity");
+    ASSERT_EQ(v.utf16Size(), 54);
+
+    // The result is converted to a number like an assigned string
+    v = "";
+    v.append("12");
+    ASSERT_EQ(v.type(), Value::Type::Integer);
+    ASSERT_EQ(v.toLong(), 12);
+
+    v.append("3.5");
+    ASSERT_EQ(v.type(), Value::Type::Double);
+    ASSERT_EQ(v.toDouble(), 123.5);
+
+    v = "-";
+    ASSERT_TRUE(v.isString());
+    v.append(4.5);
+    ASSERT_EQ(v.type(), Value::Type::Double);
+    ASSERT_EQ(v.toDouble(), -4.5);
+
+    v = "000000000000000000000";
+    v.append("1");
+    ASSERT_EQ(v.type(), Value::Type::Integer);
+    ASSERT_EQ(v.toLong(), 1);
+
+    v = "-Infinit";
+    v.append("y");
+    ASSERT_TRUE(v.isNegativeInfinity());
+
+    v = "Na";
+    v.append("N");
+    ASSERT_TRUE(v.isNaN());
+
+    v = "a long string";
+    v.append(" 5");
+    ASSERT_TRUE(v.isString());
+    ASSERT_EQ(v.toString(), "a long string 5");
+    ASSERT_EQ(v.toDouble(), 0);
+
+    // Non-ASCII strings
+    v = "abc";
+    v.append("ř");
+    ASSERT_EQ(v.toString(), "abcř");
+    ASSERT_EQ(v.utf16Size(), 4);
+    ASSERT_EQ(v.utf16At(3), "ř");
+    v.append("d");
+    ASSERT_EQ(v.utf16Size(), 5);
+    ASSERT_EQ(v.utf16At(4), "d");
+}
+
 TEST(ValueTest, AddFunction)
 {
     Value v = 50;
@@ -1744,6 +1934,23 @@ TEST(ValueTest, EqualityOperators)
         ASSERT_TRUE(v3 != v4);
     }
 
+    {
+        // Strings longer than 8 bytes and non-ASCII characters (only ASCII letters are case-insensitive)
+        Value v1 = "The Quick Brown Fox @[`{";
+        Value v2 = "tHE qUICK bROWN fOX @[`{";
+        Value v3 = "The Quick Brown Fox @[`[";
+        Value v4 = "Příliš žluťoučký kůň ÚPĚL";
+        Value v5 = "PŘÍLIŠ ŽLUŤOUČKÝ KŮŇ úpěl";
+        Value v6 = "příliš žluťoučký kůň ÚPĚL";
+
+        ASSERT_TRUE(v1 == v2);
+        ASSERT_FALSE(v1 == v3);
+        ASSERT_FALSE(v2 == v3);
+        ASSERT_FALSE(v4 == v5);
+        ASSERT_TRUE(v4 == v6);
+        ASSERT_FALSE(Value("ab") == Value("abc"));
+    }
+
     {
         Value v1(Value::SpecialValue::Infinity);
         Value v2(Value::SpecialValue::Infinity);
@@ -38,6 +38,25 @@ TEST_F(ScriptTest, Bytecode)
     ASSERT_EQ(script.bytecodeVector(), std::vector<unsigned int>({ vm::OP_START, vm::OP_HALT }));
 }
 
+TEST_F(ScriptTest, MaxRegisterCount)
+{
+    Script script(nullptr, nullptr);
+    ASSERT_EQ(script.maxRegisterCount(), 1024);
+
+    script.setMaxRegisterCount(5);
+    ASSERT_EQ(script.maxRegisterCount(), 5);
+}
+
+TEST_F(ScriptTest, ProcedureScripts)
+{
+    Script script(nullptr, nullptr);
+    ASSERT_TRUE(script.procedureScripts().empty());
+
+    Script procedure1(nullptr, nullptr), procedure2(nullptr, nullptr);
+    script.setProcedureScripts({ &procedure1, nullptr, &procedure2 });
+    ASSERT_EQ(script.procedureScripts(), std::vector<Script *>({ &procedure1, nullptr, &procedure2 }));
+}
+
 unsigned int testFunction(VirtualMachine *)
 {
     return 0;
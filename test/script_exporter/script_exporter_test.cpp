@@ -0,0 +1,280 @@
+#include <scratchcpp/scriptexporter.h>
+#include <scratchcpp/nativescriptapi.h>
+#include <scratchcpp/virtualmachine.h>
+#include <scratchcpp/project.h>
+#include <scratchcpp/iengine.h>
+#include <scratchcpp/script.h>
+#include <scratchcpp/target.h>
+#include <scratchcpp/variable.h>
+#include <scratchcpp/list.h>
+#include <dlfcn.h>
+#include <map>
+#include <algorithm>
+
+#include "../common.h"
+#include "engine/internal/engine.h"
+#include "engine/internal/timer.h"
+#include "engine/internal/clock.h"
+#include "engine/internal/randomgenerator.h"
+#include "engine/virtualmachine_p.h"
+#include "engine/scriptexporter_p.h"
+#include "blocks/controlblocks.h"
+#include "blocks/motionblocks.h"
+#include "blocks/looksblocks.h"
+#include "blocks/sensingblocks.h"
+
+using namespace libscratchcpp;
+using namespace vm;
+
+using Snapshot = std::map<std::string, std::string>;
+
+// Projects with forever loops are stopped after this number of frames
+static const size_t maxFrames = 100;
+
+// A clock which moves forward by the given step whenever it's read (sleeping doesn't take any time)
+class StepClock : public IClock
+{
+    public:
+        StepClock(std::chrono::milliseconds step) :
+            m_step(step)
+        {
+        }
+
+        std::chrono::steady_clock::time_point currentSteadyTime() const override
+        {
+            m_time += m_step;
+            return std::chrono::steady_clock::time_point(m_time);
+        }
+
+        std::chrono::system_clock::time_point currentSystemTime() const override { return std::chrono::system_clock::time_point(currentSteadyTime().time_since_epoch()); }
+
+        void sleep(const std::chrono::milliseconds &) const override { }
+
+    private:
+        std::chrono::milliseconds m_step;
+        mutable std::chrono::milliseconds m_time = std::chrono::milliseconds::zero();
+};
+
+// A linear congruential generator, which returns the same numbers in every run
+class SequenceGenerator : public IRandomGenerator
+{
+    public:
+        long randint(long start, long end) const override
+        {
+            if (start > end)
+                std::swap(start, end);
+
+            return start + static_cast<long>(next() % static_cast<unsigned long long>(end - start + 1));
+        }
+
+        double randintDouble(double start, double end) const override
+        {
+            if (start > end)
+                std::swap(start, end);
+
+            return start + (end - start) * (next() % 1000000) / 1000000.0;
+        }
+
+    private:
+        unsigned long long next() const
+        {
+            m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return m_state >> 33;
+        }
+
+        mutable unsigned long long m_state = 0;
+};
+
+static Snapshot snapshot(IEngine *engine)
+{
+    Snapshot ret;
+
+    for (auto target : engine->targets()) {
+        for (auto var : target->variables())
+            ret[target->name() + "/var/" + var->name()] = var->value().toString();
+
+        for (auto list : target->lists())
+            ret[target->name() + "/list/" + list->name()] = list->toString();
+    }
+
+    return ret;
+}
+
+// Exports the scripts, compiles them into a shared library and registers them
+static void *loadExportedScripts(IEngine *engine, const std::string &name)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+    std::string source = (dir / ("scratchcpp_exported_" + name + ".cpp")).string();
+    std::string library = (dir / ("scratchcpp_exported_" + name + ".so")).string();
+
+    ScriptExporter exporter(engine);
+    std::ofstream file(source);
+    file << exporter.generate();
+    file.close();
+
+    std::string command = std::string(COMPILE_COMMAND) + " -o " + library + " " + source;
+    EXPECT_EQ(system(command.c_str()), 0);
+
+    void *handle = dlopen(library.c_str(), RTLD_NOW);
+    EXPECT_TRUE(handle) << dlerror();
+
+    if (!handle)
+        return nullptr;
+
+    auto registerScripts = reinterpret_cast<void (*)(IEngine *)>(dlsym(handle, ScriptExporter::registerFunctionName.c_str()));
+    EXPECT_TRUE(registerScripts);
+
+    if (registerScripts)
+        registerScripts(engine);
+
+    return handle;
+}
+
+// Runs the project and returns the state after every frame and at the end (the frames, the timer and the random numbers are reproducible)
+static std::vector<Snapshot> runFrames(Project &project)
+{
+    StepClock clock(std::chrono::milliseconds(1));
+    StepClock vmClock(std::chrono::milliseconds(0)); // the warp timer doesn't stop scripts which run without screen refresh
+    SequenceGenerator rng;
+    Timer timer(&clock);
+    ITimer *defaultTimer = project.engine()->timer();
+
+    Engine *engine = dynamic_cast<Engine *>(project.engine().get());
+    EXPECT_TRUE(engine);
+
+    if (!engine)
+        return {};
+
+    engine->m_clock = &clock;
+    engine->setTimer(&timer);
+    VirtualMachinePrivate::clock = &vmClock;
+    VirtualMachinePrivate::rng = &rng;
+    ControlBlocks::clock = &clock;
+    MotionBlocks::clock = &clock;
+    MotionBlocks::rng = &rng;
+    LooksBlocks::rng = &rng;
+    SensingBlocks::clock = &clock;
+
+    std::vector<Snapshot> frames;
+
+    engine->setRedrawHandler([engine, &frames]() {
+        frames.push_back(snapshot(engine));
+
+        if (frames.size() == maxFrames)
+            engine->stopEventLoop();
+    });
+
+    project.run();
+    frames.push_back(snapshot(engine));
+
+    engine->setRedrawHandler(nullptr);
+    engine->setTimer(defaultTimer);
+    engine->m_clock = Clock::instance().get();
+    VirtualMachinePrivate::clock = Clock::instance().get();
+    VirtualMachinePrivate::rng = RandomGenerator::instance().get();
+    ControlBlocks::clock = Clock::instance().get();
+    MotionBlocks::clock = Clock::instance().get();
+    MotionBlocks::rng = RandomGenerator::instance().get();
+    LooksBlocks::rng = RandomGenerator::instance().get();
+    SensingBlocks::clock = Clock::instance().get();
+
+    return frames;
+}
+
+TEST(ScriptExporterTest, Constructors)
+{
+    Project p("repeat10.sb3");
+    ASSERT_TRUE(p.load());
+    ScriptExporter exporter(p.engine().get());
+    ASSERT_EQ(exporter.engine(), p.engine().get());
+}
+
+TEST(ScriptExporterTest, Generate)
+{
+    Project p("repeat10.sb3");
+    ASSERT_TRUE(p.load());
+    ScriptExporter exporter(p.engine().get());
+    std::string code = exporter.generate();
+
+    ASSERT_NE(code.find("#include <scratchcpp/nativescriptapi.h>"), std::string::npos);
+    ASSERT_EQ(code.find("_p.h>"), std::string::npos);
+    ASSERT_NE(code.find("static bool script0(VirtualMachine *vm, unsigned int **pos)"), std::string::npos);
+    ASSERT_NE(code.find("NativeScriptApi::isCompatible(" + std::to_string(NativeScriptApi::version) + ", sizeof(Value), sizeof(List))"), std::string::npos);
+    ASSERT_NE(code.find("extern \"C\" void " + ScriptExporter::registerFunctionName + "(IEngine *engine)"), std::string::npos);
+
+    // The generated code doesn't depend on the order of the scripts
+    ASSERT_EQ(exporter.generate(), code);
+}
+
+TEST(ScriptExporterTest, GenerateScript)
+{
+    // Only procedure calls leave the exported code
+    std::vector<unsigned int> bytecode = { OP_START, OP_CONST, 0, OP_SQRT, OP_CONST, 1, OP_LIST_INSERT, 0, OP_CONST, 2, OP_STR_LENGTH, OP_LIST_DEL, 0, OP_INIT_PROCEDURE, OP_CALL_PROCEDURE, 0, OP_HALT };
+    std::string code = ScriptExporterPrivate::generateScript(bytecode, "script0");
+
+    ASSERT_NE(code.find("NativeScriptApi::sqrtNumber(LAST_REG());"), std::string::npos);
+    ASSERT_NE(code.find("NativeScriptApi::insertListItem(lists[0], REG(0, 2), REG(1, 2));"), std::string::npos);
+    ASSERT_NE(code.find("*LAST_REG() = static_cast<long>(LAST_REG()->utf16Size());"), std::string::npos);
+    ASSERT_NE(code.find("NativeScriptApi::deleteListItem(lists[0], LAST_REG());"), std::string::npos);
+    ASSERT_NE(code.find("*pos = bytecode + 13;\n        return false;"), std::string::npos);
+
+    size_t leaveCount = 0;
+
+    for (size_t i = code.find("return false;"); i != std::string::npos; i = code.find("return false;", i + 1))
+        leaveCount++;
+
+    ASSERT_EQ(leaveCount, 2); // the procedure call and invalid positions
+}
+
+TEST(ScriptExporterTest, Compatibility)
+{
+    ASSERT_TRUE(NativeScriptApi::isCompatible(NativeScriptApi::version, sizeof(Value), sizeof(List)));
+    ASSERT_FALSE(NativeScriptApi::isCompatible(NativeScriptApi::version + 1, sizeof(Value), sizeof(List)));
+    ASSERT_FALSE(NativeScriptApi::isCompatible(NativeScriptApi::version, sizeof(Value) + 8, sizeof(List)));
+    ASSERT_FALSE(NativeScriptApi::isCompatible(NativeScriptApi::version, sizeof(Value), sizeof(List) + 8));
+}
+
+TEST(ScriptExporterTest, ExportedProjects)
+{
+    std::vector<std::string> projects;
+
+    for (const auto &entry : std::filesystem::directory_iterator("."))
+        if (entry.path().extension() == ".sb3")
+            projects.push_back(entry.path().stem().string());
+
+    std::sort(projects.begin(), projects.end());
+    ASSERT_FALSE(projects.empty());
+
+    for (const std::string &name : projects) {
+        // Run the project in the bytecode interpreter
+        Project p1(name + ".sb3");
+        ASSERT_TRUE(p1.load()) << name;
+        std::vector<Snapshot> expected = runFrames(p1);
+
+        // Run the exported scripts (the project must be destroyed before the functions are unloaded)
+        void *handle = nullptr;
+
+        {
+            Project p2(name + ".sb3");
+            ASSERT_TRUE(p2.load()) << name;
+            handle = loadExportedScripts(p2.engine().get(), name);
+            ASSERT_TRUE(handle) << name;
+
+            bool exported = false;
+
+            for (const auto &[block, script] : p2.engine()->scripts()) {
+                if (script->nativeScript())
+                    exported = true;
+            }
+
+            ASSERT_EQ(exported, !p2.engine()->scripts().empty()) << name;
+            std::vector<Snapshot> frames = runFrames(p2);
+            ASSERT_EQ(frames.size(), expected.size()) << name;
+
+            for (size_t i = 0; i < frames.size(); i++)
+                ASSERT_EQ(frames[i], expected[i]) << name << " (frame " << i << ")";
+        }
+
+        dlclose(handle);
+    }
+}
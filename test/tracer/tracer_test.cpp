@@ -0,0 +1,112 @@
+#include <scratchcpp/tracer.h>
+#include <scratchcpp/project.h>
+#include <scratchcpp/iengine.h>
+#include <nlohmann/json.hpp>
+#include <set>
+
+#include "../common.h"
+
+using namespace libscratchcpp;
+
+static std::set<std::string> eventNames(const nlohmann::json &json)
+{
+    std::set<std::string> ret;
+
+    for (const auto &event : json["traceEvents"])
+        ret.insert(event["name"].get<std::string>());
+
+    return ret;
+}
+
+TEST(TracerTest, Enabled)
+{
+    Tracer tracer;
+    ASSERT_FALSE(tracer.enabled());
+
+    tracer.setEnabled(true);
+    ASSERT_TRUE(tracer.enabled());
+
+    tracer.setEnabled(false);
+    ASSERT_FALSE(tracer.enabled());
+}
+
+TEST(TracerTest, Capacity)
+{
+    Tracer tracer;
+    ASSERT_EQ(tracer.capacity(), 10000);
+
+    tracer.setCapacity(2);
+    ASSERT_EQ(tracer.capacity(), 2);
+
+    tracer.setCapacity(0);
+    ASSERT_EQ(tracer.capacity(), 1);
+}
+
+TEST(TracerTest, Events)
+{
+    Tracer tracer;
+    std::chrono::steady_clock::time_point start(std::chrono::microseconds(1000));
+
+    // Events aren't recorded before the buffer is allocated
+    tracer.addEvent("frame", "", start, start + std::chrono::microseconds(5));
+    ASSERT_EQ(tracer.eventCount(), 0);
+
+    tracer.setCapacity(2);
+    tracer.setEnabled(true);
+    tracer.addEvent("frame", "", start, start + std::chrono::microseconds(5));
+    tracer.addEvent("target", "Sprite \"1\"", start + std::chrono::microseconds(1), start + std::chrono::microseconds(3));
+    ASSERT_EQ(tracer.eventCount(), 2);
+
+    nlohmann::json json = nlohmann::json::parse(tracer.toJson());
+    ASSERT_EQ(json["traceEvents"].size(), 2);
+    const auto &event = json["traceEvents"][1];
+    ASSERT_EQ(event["name"], "target");
+    ASSERT_EQ(event["ph"], "X");
+    ASSERT_EQ(event["ts"], 1001);
+    ASSERT_EQ(event["dur"], 2);
+    ASSERT_EQ(event["args"]["name"], "Sprite \"1\"");
+    ASSERT_FALSE(json["traceEvents"][0].contains("args"));
+
+    // The oldest event is overwritten
+    tracer.addEvent("sleep", "", start + std::chrono::microseconds(6), start + std::chrono::microseconds(10));
+    ASSERT_EQ(tracer.eventCount(), 2);
+    json = nlohmann::json::parse(tracer.toJson());
+    ASSERT_EQ(json["traceEvents"][0]["name"], "target");
+    ASSERT_EQ(json["traceEvents"][1]["name"], "sleep");
+
+    tracer.clear();
+    ASSERT_EQ(tracer.eventCount(), 0);
+    ASSERT_TRUE(nlohmann::json::parse(tracer.toJson())["traceEvents"].empty());
+}
+
+TEST(TracerTest, Engine)
+{
+    Project p("broadcasts.sb3");
+    ASSERT_TRUE(p.load());
+
+    Tracer *tracer = p.engine()->tracer();
+    ASSERT_TRUE(tracer);
+    ASSERT_FALSE(tracer->enabled());
+
+    p.run();
+    ASSERT_EQ(tracer->eventCount(), 0);
+
+    tracer->setEnabled(true);
+    p.run();
+    std::set<std::string> names = eventNames(nlohmann::json::parse(tracer->toJson()));
+    ASSERT_TRUE(names.count("frame"));
+    ASSERT_TRUE(names.count("new scripts"));
+    ASSERT_TRUE(names.count("running scripts"));
+    ASSERT_TRUE(names.count("target"));
+    ASSERT_TRUE(names.count("broadcast"));
+}
+
+TEST(TracerTest, Clones)
+{
+    Project p("clones.sb3");
+    ASSERT_TRUE(p.load());
+
+    p.engine()->tracer()->setEnabled(true);
+    p.run();
+    ASSERT_TRUE(eventNames(nlohmann::json::parse(p.engine()->tracer()->toJson())).count("clone"));
+}
@@ -3,10 +3,12 @@
 #include <scratchcpp/script.h>
 #include <enginemock.h>
 #include <randomgeneratormock.h>
+#include <clockmock.h>
 
 #include "engine/virtualmachine_p.h"
 #include "engine/internal/engine.h"
 #include "engine/internal/randomgenerator.h"
+#include "engine/internal/clock.h"
 #include "../common.h"
 
 using namespace libscratchcpp;
@@ -146,7 +148,10 @@ TEST(VirtualMachineTest, RegCountLimit)
 
     static Value constValues[] = { 1 };
 
-    VirtualMachine vm;
+    Script script(nullptr, nullptr);
+    script.setMaxRegisterCount(10240);
+
+    VirtualMachine vm(nullptr, nullptr, &script);
     vm.setBytecode(bytecode);
     vm.setConstValues(constValues);
     vm.run();
@@ -162,6 +167,35 @@ TEST(VirtualMachineTest, RegCountLimit)
     ASSERT_EQ(vm.getInput(0, 1)->toInt(), 10240);
 }
 
+static unsigned int addThreeValues(VirtualMachine *vm)
+{
+    vm->addReturnValue(1);
+    vm->addReturnValue(2);
+    vm->addReturnValue(3);
+    return 0;
+}
+
+TEST(VirtualMachineTest, RegCountOverflow)
+{
+    // Functions may add more values than the compiler expects
+    static unsigned int bytecode[] = { OP_START, OP_EXEC, 0, OP_EXEC, 0, OP_CONST, 0, OP_HALT };
+    static BlockFunc functions[] = { &addThreeValues };
+    static Value constValues[] = { "test" };
+
+    Script script(nullptr, nullptr);
+    script.setMaxRegisterCount(1);
+
+    VirtualMachine vm(nullptr, nullptr, &script);
+    vm.setBytecode(bytecode);
+    vm.setFunctions(functions);
+    vm.setConstValues(constValues);
+    vm.run();
+    ASSERT_EQ(vm.registerCount(), 7);
+    ASSERT_EQ(vm.getInput(0, 7)->toInt(), 1);
+    ASSERT_EQ(vm.getInput(5, 7)->toInt(), 3);
+    ASSERT_EQ(vm.getInput(6, 7)->toString(), "test");
+}
+
 TEST(VirtualMachineTest, OP_CONST)
 {
     static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_HALT };
@@ -207,7 +241,7 @@ TEST(VirtualMachineTest, OP_CHECKPOINT)
 
 TEST(VirtualMachineTest, If)
 {
-    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_IF, OP_CONST, 1, OP_PRINT, OP_ENDIF, OP_CONST, 2, OP_IF, OP_CONST, 3, OP_PRINT, OP_ENDIF, OP_HALT };
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_IF, 4, OP_CONST, 1, OP_PRINT, OP_ENDIF, OP_CONST, 2, OP_IF, 4, OP_CONST, 3, OP_PRINT, OP_ENDIF, OP_HALT };
     static Value constValues[] = { true, "true!", false, "false!" };
 
     VirtualMachine vm;
@@ -222,7 +256,7 @@ TEST(VirtualMachineTest, If)
 TEST(VirtualMachineTest, IfElse)
 {
     static unsigned int bytecode[] = {
-        OP_START, OP_CONST, 0, OP_IF, OP_CONST, 1, OP_PRINT, OP_ELSE, OP_CONST, 3, OP_PRINT, OP_ENDIF, OP_CONST, 2, OP_IF, OP_CONST, 1, OP_PRINT, OP_ELSE, OP_CONST, 3, OP_PRINT, OP_ENDIF, OP_HALT
+        OP_START, OP_CONST, 0, OP_IF, 5, OP_CONST, 1, OP_PRINT, OP_ELSE, 4, OP_CONST, 3, OP_PRINT, OP_ENDIF, OP_CONST, 2, OP_IF, 5, OP_CONST, 1, OP_PRINT, OP_ELSE, 4, OP_CONST, 3, OP_PRINT, OP_ENDIF, OP_HALT
     };
     static Value constValues[] = { true, "true!", false, "false!" };
 
@@ -253,22 +287,29 @@ TEST(VirtualMachineTest, OP_FOREVER_LOOP)
 
 TEST(VirtualMachineTest, OP_REPEAT_LOOP)
 {
-    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, OP_CONST, 1, OP_PRINT, OP_LOOP_END, OP_HALT };
-    static Value constValues[] = { 3, "test" };
+    static unsigned int bytecode1[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, 4, OP_CONST, 1, OP_PRINT, OP_LOOP_END, OP_HALT };
+    static unsigned int bytecode2[] = { OP_START, OP_CONST, 2, OP_REPEAT_LOOP, 4, OP_CONST, 1, OP_PRINT, OP_LOOP_END, OP_CONST, 3, OP_PRINT, OP_HALT };
+    static Value constValues[] = { 3, "test", 0, "end" };
 
     EngineMock engineMock;
     VirtualMachine vm(nullptr, &engineMock, nullptr);
-    vm.setBytecode(bytecode);
+    vm.setBytecode(bytecode1);
     vm.setConstValues(constValues);
     testing::internal::CaptureStdout();
     vm.run();
     ASSERT_EQ(testing::internal::GetCapturedStdout(), "test\ntest\ntest\n");
     ASSERT_EQ(vm.registerCount(), 0);
+
+    vm.setBytecode(bytecode2);
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "end\n");
+    ASSERT_EQ(vm.registerCount(), 0);
 }
 
 TEST(VirtualMachineTest, OP_REPEAT_LOOP_INDEX)
 {
-    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, OP_REPEAT_LOOP_INDEX, OP_PRINT, OP_LOOP_END, OP_HALT };
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, 3, OP_REPEAT_LOOP_INDEX, OP_PRINT, OP_LOOP_END, OP_HALT };
     static Value constValues[] = { 3 };
 
     VirtualMachine vm;
@@ -282,7 +323,7 @@ TEST(VirtualMachineTest, OP_REPEAT_LOOP_INDEX)
 
 TEST(VirtualMachineTest, OP_REPEAT_LOOP_INDEX1)
 {
-    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, OP_REPEAT_LOOP_INDEX1, OP_PRINT, OP_LOOP_END, OP_HALT };
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_REPEAT_LOOP, 3, OP_REPEAT_LOOP_INDEX1, OP_PRINT, OP_LOOP_END, OP_HALT };
     static Value constValues[] = { 3 };
 
     VirtualMachine vm;
@@ -296,22 +337,40 @@ TEST(VirtualMachineTest, OP_REPEAT_LOOP_INDEX1)
 
 TEST(VirtualMachineTest, OP_UNTIL_LOOP)
 {
-    static unsigned int bytecode[] = {
-        OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, OP_READ_VAR, 0, OP_CONST, 1, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_READ_VAR, 0, OP_PRINT, OP_LOOP_END, OP_HALT
+    static unsigned int bytecode1[] = {
+        OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, 14, OP_READ_VAR, 0, OP_CONST, 1, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_READ_VAR, 0, OP_PRINT, OP_LOOP_END, OP_HALT
     };
-    static Value constValues[] = { 0, 3, 1 };
-    Value var;
-    Value *variables[] = { &var };
+    static unsigned int bytecode2[] = { OP_START, OP_UNTIL_LOOP, 7, OP_CONST, 3, OP_BEGIN_UNTIL_LOOP, OP_CONST, 2, OP_PRINT, OP_LOOP_END, OP_CONST, 1, OP_PRINT, OP_HALT };
+    static unsigned int bytecode3[] = { OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, 31, OP_READ_VAR, 0, OP_CONST, 4, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_CONST, 0, OP_SET_VAR, 1,
+                                        OP_UNTIL_LOOP, 14, OP_READ_VAR, 1, OP_CONST, 4, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_CONST, 2, OP_CHANGE_VAR, 1, OP_READ_VAR, 1, OP_PRINT, OP_LOOP_END,
+                                        OP_CONST, 2, OP_CHANGE_VAR, 0, OP_LOOP_END, OP_HALT };
+    static Value constValues[] = { 0, 3, 1, true, 2 };
+    Value var, var2;
+    Value *variables[] = { &var, &var2 };
 
     EngineMock engineMock;
     VirtualMachine vm(nullptr, &engineMock, nullptr);
-    vm.setBytecode(bytecode);
+    vm.setBytecode(bytecode1);
     vm.setConstValues(constValues);
     vm.setVariables(variables);
     testing::internal::CaptureStdout();
     vm.run();
     ASSERT_EQ(testing::internal::GetCapturedStdout(), "1\n2\n3\n");
     ASSERT_EQ(vm.registerCount(), 0);
+
+    vm.setBytecode(bytecode2);
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "3\n");
+    ASSERT_EQ(vm.registerCount(), 0);
+
+    // Nested loops
+    vm.setBytecode(bytecode3);
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "1\n2\n1\n2\n");
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(vm.registerCount(), 0);
 }
 
 TEST(VirtualMachineTest, OP_ADD)
@@ -410,7 +469,7 @@ TEST(VirtualMachineTest, OP_RANDOM)
     vm.run(vm.pos);
 
     ASSERT_EQ(vm.regCount, 1);
-    ASSERT_EQ(vm.regs[vm.regCount - 1]->toDouble(), -18);
+    ASSERT_EQ(vm.regs[vm.regCount - 1].toDouble(), -18);
 
     EXPECT_CALL(rng, randintDouble(12, 6.05)).WillOnce(Return(3.486789));
     vm.bytecode = bytecode2;
@@ -419,7 +478,7 @@ TEST(VirtualMachineTest, OP_RANDOM)
     vm.run(vm.pos);
 
     ASSERT_EQ(vm.regCount, 1);
-    ASSERT_EQ(vm.regs[vm.regCount - 1]->toDouble(), 3.486789);
+    ASSERT_EQ(vm.regs[vm.regCount - 1].toDouble(), 3.486789);
 
     EXPECT_CALL(rng, randintDouble(-78.686, -45)).WillOnce(Return(-59.468873));
     vm.bytecode = bytecode3;
@@ -428,7 +487,7 @@ TEST(VirtualMachineTest, OP_RANDOM)
     vm.run(vm.pos);
 
     ASSERT_EQ(vm.regCount, 1);
-    ASSERT_EQ(vm.regs[vm.regCount - 1]->toDouble(), -59.468873);
+    ASSERT_EQ(vm.regs[vm.regCount - 1].toDouble(), -59.468873);
 
     EXPECT_CALL(rng, randintDouble(6.05, -78.686)).WillOnce(Return(-28.648764));
     vm.bytecode = bytecode4;
@@ -437,7 +496,7 @@ TEST(VirtualMachineTest, OP_RANDOM)
     vm.run(vm.pos);
 
     ASSERT_EQ(vm.regCount, 1);
-    ASSERT_EQ(vm.regs[vm.regCount - 1]->toDouble(), -28.648764);
+    ASSERT_EQ(vm.regs[vm.regCount - 1].toDouble(), -28.648764);
 }
 
 TEST(VirtualMachineTest, OP_ROUND)
@@ -1449,12 +1508,38 @@ TEST(VirtualMachineTest, RunProcedures)
     ASSERT_EQ(vm.registerCount(), 0);
 }
 
+TEST(VirtualMachineTest, RecursiveProcedures)
+{
+    // procedure 0 (n, s): if n > 0 then procedure 0 (n - 1, s + n); print n; print s
+    static unsigned int bytecode[] = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 3, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_HALT };
+    static unsigned int procedure[] = {
+        OP_START, OP_READ_ARG, 0, OP_CONST, 1, OP_GREATER_THAN, OP_IF, 16, OP_INIT_PROCEDURE, OP_READ_ARG, 0, OP_CONST, 2, OP_SUBTRACT, OP_ADD_ARG, OP_READ_ARG, 1, OP_READ_ARG, 0, OP_STR_CONCAT,
+        OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_ENDIF, OP_READ_ARG, 0, OP_PRINT, OP_READ_ARG, 1, OP_PRINT, OP_HALT
+    };
+    static unsigned int *procedures[] = { procedure };
+    static Value constValues[] = { 3, 0, 1, "x" };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setProcedures(procedures);
+    vm.setConstValues(constValues);
+
+    for (int i = 0; i < 2; i++) {
+        testing::internal::CaptureStdout();
+        vm.run();
+        ASSERT_EQ(testing::internal::GetCapturedStdout(), "0\nx321\n1\nx32\n2\nx3\n3\nx\n");
+        ASSERT_TRUE(vm.atEnd());
+        ASSERT_EQ(vm.registerCount(), 0);
+        vm.reset();
+    }
+}
+
 TEST(VirtualMachineTest, OP_BREAK_FRAME)
 {
     static unsigned int bytecode1[] = { OP_START, OP_FOREVER_LOOP, OP_BREAK_FRAME, OP_LOOP_END, OP_HALT };
-    static unsigned int bytecode2[] = { OP_START, OP_CONST, 1, OP_REPEAT_LOOP, OP_BREAK_FRAME, OP_LOOP_END, OP_HALT };
+    static unsigned int bytecode2[] = { OP_START, OP_CONST, 1, OP_REPEAT_LOOP, 2, OP_BREAK_FRAME, OP_LOOP_END, OP_HALT };
     static unsigned int bytecode3[] = {
-        OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, OP_READ_VAR, 0, OP_CONST, 1, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_BREAK_FRAME, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_LOOP_END, OP_HALT
+        OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, 12, OP_READ_VAR, 0, OP_CONST, 1, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_BREAK_FRAME, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_LOOP_END, OP_HALT
     };
     static unsigned int bytecode4[] = { OP_START, OP_BREAK_FRAME, OP_NULL, OP_EXEC, 0, OP_HALT };
     static BlockFunc functions[] = { &testFunction3 };
@@ -1512,9 +1597,9 @@ TEST(VirtualMachineTest, OP_BREAK_FRAME)
 
 TEST(VirtualMachineTest, OP_WARP)
 {
-    static unsigned int bytecode1[] = { OP_START, OP_WARP, OP_CONST, 1, OP_REPEAT_LOOP, OP_BREAK_FRAME, OP_LOOP_END, OP_HALT };
+    static unsigned int bytecode1[] = { OP_START, OP_WARP, OP_CONST, 1, OP_REPEAT_LOOP, 2, OP_BREAK_FRAME, OP_LOOP_END, OP_HALT };
     static unsigned int bytecode2[] = {
-        OP_START, OP_WARP, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, OP_READ_VAR, 0, OP_CONST, 1, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_BREAK_FRAME, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_LOOP_END, OP_HALT
+        OP_START, OP_WARP, OP_CONST, 0, OP_SET_VAR, 0, OP_UNTIL_LOOP, 12, OP_READ_VAR, 0, OP_CONST, 1, OP_EQUALS, OP_BEGIN_UNTIL_LOOP, OP_BREAK_FRAME, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_LOOP_END, OP_HALT
     };
     static unsigned int bytecode3[] = { OP_START, OP_WARP, OP_BREAK_FRAME, OP_NULL, OP_EXEC, 0, OP_HALT };
     static BlockFunc functions[] = { &testFunction3 };
@@ -1545,6 +1630,210 @@ TEST(VirtualMachineTest, OP_WARP)
     ASSERT_EQ(vm.registerCount(), 0);
 }
 
+TEST(VirtualMachineTest, OP_CHANGE_VAR_CONST)
+{
+    static unsigned int bytecode[] = { OP_START, OP_CHANGE_VAR_CONST, 0, 0, OP_CHANGE_VAR_CONST, 1, 1, OP_HALT };
+    static Value constValues[] = { 3.52, -1 };
+    Value var1 = 1.234;
+    Value var2 = 2;
+    Value *variables[] = { &var1, &var2 };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+    vm.run();
+    ASSERT_EQ(var1.toDouble(), 4.754);
+    ASSERT_EQ(var2.toDouble(), 1);
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
+TEST(VirtualMachineTest, OP_IF_VAR_EQ_CONST)
+{
+    static unsigned int bytecode[] = {
+        OP_START, OP_IF_VAR_EQ_CONST, 0, 0, 5, OP_CONST, 1, OP_SET_VAR, 1, OP_ENDIF, OP_IF_VAR_EQ_CONST, 0, 2, 6, OP_CONST, 2, OP_SET_VAR, 1, OP_ELSE, 5, OP_CONST, 3, OP_SET_VAR, 2, OP_ENDIF, OP_HALT
+    };
+    static Value constValues[] = { "test", "a", "b", "c" };
+    Value var1 = "TEST";
+    Value var2, var3;
+    Value *variables[] = { &var1, &var2, &var3 };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+    vm.run();
+    ASSERT_EQ(var2.toString(), "a");
+    ASSERT_EQ(var3.toString(), "c");
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
+TEST(VirtualMachineTest, OP_LIST_GET_VAR_INDEX)
+{
+    static unsigned int bytecode[] = { OP_START, OP_LIST_GET_VAR_INDEX, 0, 0, OP_LIST_GET_VAR_INDEX, 0, 1, OP_LIST_GET_VAR_INDEX, 0, 2, OP_LIST_GET_VAR_INDEX, 0, 3, OP_HALT };
+    List list1("", "list1");
+    list1.push_back("a");
+    list1.push_back("b");
+    list1.push_back("c");
+    List *lists[] = { &list1 };
+    Value var1 = 2;
+    Value var2 = 0;
+    Value var3 = "last";
+    Value var4 = "random";
+    Value *variables[] = { &var1, &var2, &var3, &var4 };
+
+    RandomGeneratorMock rng;
+    VirtualMachinePrivate::rng = &rng;
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setLists(lists);
+    vm.setVariables(variables);
+
+    EXPECT_CALL(rng, randint(1, 3)).WillOnce(Return(1));
+    vm.run();
+
+    VirtualMachinePrivate::rng = RandomGenerator::instance().get();
+
+    ASSERT_EQ(vm.registerCount(), 4);
+    ASSERT_EQ(vm.getInput(0, 4)->toString(), "b");
+    ASSERT_EQ(vm.getInput(1, 4)->toString(), "");
+    ASSERT_EQ(vm.getInput(2, 4)->toString(), "c");
+    ASSERT_EQ(vm.getInput(3, 4)->toString(), "a");
+}
+
+TEST(VirtualMachineTest, OP_TAIL_CALL)
+{
+    // procedure 0 (n): change [var] by 1; if n > 0 then procedure 0 (n - 1)
+    static unsigned int bytecode[] = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 2, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_READ_VAR, 0, OP_PRINT, OP_HALT };
+    static unsigned int procedure[] = { OP_START, OP_CONST, 1, OP_CHANGE_VAR, 0, OP_READ_ARG, 0, OP_CONST, 0, OP_GREATER_THAN, OP_IF, 10, OP_INIT_PROCEDURE, OP_READ_ARG, 0, OP_CONST, 1,
+                                        OP_SUBTRACT, OP_ADD_ARG, OP_TAIL_CALL, 0, OP_ENDIF, OP_HALT };
+    static unsigned int *procedures[] = { procedure };
+    static Value constValues[] = { 0, 1, 100000 };
+    Value var = 0;
+    Value *variables[] = { &var };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setProcedures(procedures);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "100001\n");
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
+unsigned int yieldFunction(VirtualMachine *vm)
+{
+    vm->stop(true, true, false);
+    return 0;
+}
+
+TEST(VirtualMachineTest, InlineArgs)
+{
+    // The arguments of inlined procedures stay on the argument stack when the script yields
+    static unsigned int bytecode[] = {
+        OP_START, OP_CONST, 0, OP_ADD_ARG, OP_CONST, 1, OP_ADD_ARG, OP_READ_INLINE_ARG, 2, OP_PRINT, OP_EXEC, 0, OP_READ_INLINE_ARG, 1, OP_PRINT, OP_CONST, 2, OP_ADD_ARG, OP_READ_INLINE_ARG, 2,
+        OP_PRINT, OP_FREE_INLINE_ARGS, 1, OP_READ_INLINE_ARG, 1, OP_PRINT, OP_FREE_INLINE_ARGS, 2, OP_HALT
+    };
+    static BlockFunc functions[] = { &yieldFunction };
+    static Value constValues[] = { "a", "b", "c" };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setFunctions(functions);
+    vm.setConstValues(constValues);
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "a\n");
+    ASSERT_FALSE(vm.atEnd());
+
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "b\nb\nb\n");
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
+TEST(VirtualMachineTest, NumberOperators)
+{
+    // The results must be the same as the results of the generic operators
+    static const std::vector<Value> numbers = { 0, 1, -5, 2.5, -0.75, 1e300, 3.0, std::numeric_limits<long>::max() };
+    static const std::vector<std::pair<unsigned int, unsigned int>> operators = { { OP_ADD, OP_ADD_NUM },
+                                                                                 { OP_SUBTRACT, OP_SUBTRACT_NUM },
+                                                                                 { OP_MULTIPLY, OP_MULTIPLY_NUM },
+                                                                                 { OP_GREATER_THAN, OP_GREATER_THAN_NUM },
+                                                                                 { OP_LESS_THAN, OP_LESS_THAN_NUM },
+                                                                                 { OP_EQUALS, OP_EQUALS_NUM } };
+
+    for (const auto &[genericOp, numberOp] : operators) {
+        for (const Value &v1 : numbers) {
+            for (const Value &v2 : numbers) {
+                unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_CONST, 1, genericOp, OP_SET_VAR, 0, OP_CONST, 0, OP_CONST, 1, numberOp, OP_SET_VAR, 1, OP_HALT };
+                Value constValues[] = { v1, v2 };
+                Value result1, result2;
+                Value *variables[] = { &result1, &result2 };
+
+                VirtualMachine vm;
+                vm.setBytecode(bytecode);
+                vm.setConstValues(constValues);
+                vm.setVariables(variables);
+                vm.run();
+                ASSERT_EQ(result2.type(), result1.type());
+                ASSERT_EQ(result2.toString(), result1.toString());
+                ASSERT_EQ(vm.registerCount(), 0);
+            }
+        }
+    }
+}
+
+TEST(VirtualMachineTest, VariableOperators)
+{
+    static unsigned int bytecode[] = {
+        OP_START, OP_CONST, 0, OP_EQUALS_VAR, 0, OP_SET_VAR, 2, OP_CONST, 1, OP_GREATER_THAN_VAR, 1, OP_SET_VAR, 3, OP_CONST, 1, OP_LESS_THAN_VAR, 1, OP_SET_VAR, 4, OP_CONST, 0, OP_STR_CONCAT_VAR, 1,
+        OP_SET_VAR, 5, OP_HALT
+    };
+    static Value constValues[] = { "hello", 5 };
+    Value var1 = "HELLO";
+    Value var2 = 4.5;
+    Value var3, var4, var5, var6;
+    Value *variables[] = { &var1, &var2, &var3, &var4, &var5, &var6 };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+    vm.run();
+    ASSERT_EQ(var3, true);
+    ASSERT_EQ(var4, true);
+    ASSERT_EQ(var5, false);
+    ASSERT_EQ(var6.toString(), "hello4.5");
+    ASSERT_EQ(var1.toString(), "HELLO");
+    ASSERT_EQ(var2.toDouble(), 4.5);
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
+TEST(VirtualMachineTest, OP_VAR_APPEND_STR)
+{
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_VAR_APPEND_STR, 0, OP_CONST, 1, OP_VAR_APPEND_STR, 0, OP_CONST, 1, OP_VAR_APPEND_STR, 1, OP_CONST, 2, OP_VAR_APPEND_STR, 1, OP_HALT };
+    static Value constValues[] = { " world", 5, "e3" };
+    Value var1 = "hello";
+    Value var2 = 1;
+    Value *variables[] = { &var1, &var2 };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+    vm.run();
+    ASSERT_EQ(var1.toString(), "hello world5");
+    ASSERT_TRUE(var2.isNumber());
+    ASSERT_EQ(var2.toDouble(), 15000);
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
 TEST(VirtualMachineTest, Reset)
 {
     static unsigned int bytecode1[] = { OP_START, OP_NULL, OP_EXEC, 0, OP_HALT };
@@ -1585,3 +1874,222 @@ TEST(VirtualMachineTest, Reset)
     vm.reset();
     ASSERT_FALSE(vm.atEnd());
 }
+
+TEST(VirtualMachineTest, Precompile)
+{
+    // The output of precompiled code must match the bytecode interpreter
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_SET_VAR, 0, OP_CONST, 1, OP_REPEAT_LOOP, 23, OP_CONST, 2, OP_CHANGE_VAR, 0, OP_READ_VAR, 0, OP_CONST, 3, OP_EQUALS, OP_IF, 5,
+                                       OP_CONST, 4, OP_PRINT, OP_ELSE, 4, OP_READ_VAR, 0, OP_PRINT, OP_ENDIF, OP_EXEC, 0, OP_LOOP_END, OP_UNTIL_LOOP, 16, OP_READ_VAR, 0, OP_CONST, 5,
+                                       OP_GREATER_THAN, OP_BEGIN_UNTIL_LOOP, OP_CHANGE_VAR_CONST, 0, 3, OP_READ_VAR, 0, OP_SQRT, OP_ROUND, OP_LIST_APPEND, 0, OP_LOOP_END, OP_READ_LIST, 0,
+                                       OP_PRINT, OP_HALT };
+    static BlockFunc functions[] = { &yieldFunction };
+    static Value constValues[] = { 0, 3, 1, 2, "two", 5 };
+
+    for (bool precompile : { false, true }) {
+        Value var;
+        Value *variables[] = { &var };
+        List list("", "");
+        List *lists[] = { &list };
+
+        VirtualMachine vm;
+        vm.setPrecompileThreshold(0);
+        vm.setBytecode(bytecode);
+        vm.setFunctions(functions);
+        vm.setConstValues(constValues);
+        vm.setVariables(variables);
+        vm.setLists(lists);
+
+        if (precompile)
+            vm.precompile();
+
+        ASSERT_EQ(vm.isPrecompiled(), precompile);
+
+        for (const std::string &output : { "1\n", "two\n", "3\n" }) {
+            testing::internal::CaptureStdout();
+            vm.run();
+            ASSERT_EQ(testing::internal::GetCapturedStdout(), output);
+            ASSERT_FALSE(vm.atEnd());
+        }
+
+        testing::internal::CaptureStdout();
+        vm.run();
+        ASSERT_EQ(testing::internal::GetCapturedStdout(), "23\n");
+        ASSERT_TRUE(vm.atEnd());
+        ASSERT_EQ(vm.registerCount(), 0);
+    }
+}
+
+TEST(VirtualMachineTest, PrecompiledOperators)
+{
+    static unsigned int bytecode[] = { OP_START, OP_CONST, 0, OP_CONST, 1, OP_STR_AT, OP_PRINT, OP_CONST, 0, OP_STR_LENGTH, OP_PRINT, OP_CONST, 0, OP_CONST, 2, OP_STR_CONTAINS, OP_PRINT,
+                                       OP_CONST, 3, OP_ROUND, OP_PRINT, OP_CONST, 4, OP_ABS, OP_SQRT, OP_PRINT, OP_CONST, 1, OP_CONST, 1, OP_RANDOM, OP_PRINT, OP_CONST, 0, OP_CONST, 1,
+                                       OP_LIST_INSERT, 0, OP_CONST, 5, OP_CONST, 1, OP_LIST_REPLACE, 0, OP_CONST, 0, OP_LIST_APPEND, 0, OP_CONST, 6, OP_LIST_DEL, 0, OP_READ_LIST, 0,
+                                       OP_PRINT, OP_HALT };
+    static Value constValues[] = { "hello", 2, "ll", 2.5, -16, "last", 1 };
+
+    for (bool precompile : { false, true }) {
+        List list("", "");
+        List *lists[] = { &list };
+
+        VirtualMachine vm;
+        vm.setBytecode(bytecode);
+        vm.setConstValues(constValues);
+        vm.setLists(lists);
+
+        if (precompile)
+            vm.precompile();
+
+        testing::internal::CaptureStdout();
+        vm.run();
+        ASSERT_EQ(testing::internal::GetCapturedStdout(), "e\n5\ntrue\n3\n4\n2\nhello\n");
+        ASSERT_TRUE(vm.atEnd());
+        ASSERT_EQ(vm.registerCount(), 0);
+    }
+}
+
+TEST(VirtualMachineTest, PrecompiledGoBack)
+{
+    static unsigned int bytecode[] = { OP_START, OP_EXEC, 0, OP_HALT };
+    static BlockFunc functions[] = { &testFunction5 };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setFunctions(functions);
+    vm.precompile();
+
+    for (int i = 0; i < 2; i++) {
+        testing::internal::CaptureStdout();
+        vm.run();
+        ASSERT_EQ(testing::internal::GetCapturedStdout(), "function 5\n");
+        ASSERT_FALSE(vm.atEnd());
+    }
+}
+
+TEST(VirtualMachineTest, PrecompiledProcedures)
+{
+    // Procedures run in the bytecode interpreter
+    static unsigned int bytecode[] = { OP_START, OP_INIT_PROCEDURE, OP_CONST, 2, OP_ADD_ARG, OP_CALL_PROCEDURE, 0, OP_READ_VAR, 0, OP_PRINT, OP_HALT };
+    static unsigned int procedure[] = { OP_START, OP_CONST, 1, OP_CHANGE_VAR, 0, OP_READ_ARG, 0, OP_CONST, 0, OP_GREATER_THAN, OP_IF, 10, OP_INIT_PROCEDURE, OP_READ_ARG, 0, OP_CONST, 1,
+                                        OP_SUBTRACT, OP_ADD_ARG, OP_TAIL_CALL, 0, OP_ENDIF, OP_HALT };
+    static unsigned int *procedures[] = { procedure };
+    static Value constValues[] = { 0, 1, 10 };
+    Value var = 0;
+    Value *variables[] = { &var };
+
+    VirtualMachine vm;
+    vm.setBytecode(bytecode);
+    vm.setProcedures(procedures);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+    vm.precompile();
+    testing::internal::CaptureStdout();
+    vm.run();
+    ASSERT_EQ(testing::internal::GetCapturedStdout(), "11\n");
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(vm.registerCount(), 0);
+}
+
+TEST(VirtualMachineTest, PrecompileThreshold)
+{
+    static unsigned int bytecode[] = { OP_START, OP_FOREVER_LOOP, OP_EXEC, 0, OP_LOOP_END, OP_HALT };
+    static BlockFunc functions[] = { &yieldFunction };
+
+    VirtualMachine vm;
+    ASSERT_EQ(vm.precompileThreshold(), 10);
+    vm.setPrecompileThreshold(5);
+    ASSERT_EQ(vm.precompileThreshold(), 5);
+    vm.setBytecode(bytecode);
+    vm.setFunctions(functions);
+
+    for (int i = 0; i < 4; i++)
+        vm.run();
+
+    ASSERT_FALSE(vm.isPrecompiled());
+    vm.run();
+    ASSERT_TRUE(vm.isPrecompiled());
+    vm.run();
+    ASSERT_FALSE(vm.atEnd());
+
+    // Changing the bytecode or the operands removes the precompiled code
+    vm.setFunctions(functions);
+    ASSERT_FALSE(vm.isPrecompiled());
+
+    vm.setPrecompileThreshold(0);
+
+    for (int i = 0; i < 10; i++)
+        vm.run();
+
+    ASSERT_FALSE(vm.isPrecompiled());
+}
+
+static int waitCount = 0;
+static int waitLimit = 0;
+
+unsigned int waitFunction(VirtualMachine *vm)
+{
+    if (++waitCount != waitLimit)
+        vm->stop(true, true, true);
+
+    return 0;
+}
+
+TEST(VirtualMachineTest, WarpTimer)
+{
+    static unsigned int bytecode1[] = { OP_START, OP_WARP, OP_FOREVER_LOOP, OP_CONST, 0, OP_CHANGE_VAR, 0, OP_LOOP_END, OP_HALT };
+    static unsigned int bytecode2[] = { OP_START, OP_WARP, OP_EXEC, 0, OP_HALT };
+    static BlockFunc functions[] = { &waitFunction };
+    static Value constValues[] = { 1 };
+    Value var = 0;
+    Value *variables[] = { &var };
+
+    ClockMock clock;
+    VirtualMachinePrivate::clock = &clock;
+    std::chrono::steady_clock::time_point start(std::chrono::milliseconds(1000));
+
+    VirtualMachine vm;
+    ASSERT_EQ(vm.warpTime(), 0);
+    vm.setWarpTime(500);
+    ASSERT_EQ(vm.warpTime(), 500);
+    vm.setBytecode(bytecode1);
+    vm.setFunctions(functions);
+    vm.setConstValues(constValues);
+    vm.setVariables(variables);
+
+    // The clock is read every 32 iterations, the first read starts the timer
+    EXPECT_CALL(clock, currentSteadyTime())
+        .WillOnce(Return(start))
+        .WillOnce(Return(start + std::chrono::milliseconds(499)))
+        .WillOnce(Return(start + std::chrono::milliseconds(500)));
+    vm.run();
+    ASSERT_FALSE(vm.atEnd());
+    ASSERT_EQ(var.toInt(), 96);
+
+    // The script continues without screen refresh
+    EXPECT_CALL(clock, currentSteadyTime()).WillOnce(Return(start)).WillOnce(Return(start + std::chrono::milliseconds(600)));
+    vm.run();
+    ASSERT_FALSE(vm.atEnd());
+    ASSERT_EQ(var.toInt(), 160);
+
+    // Functions which stop the script
+    vm.setBytecode(bytecode2);
+    vm.setWarpTime(100);
+    waitCount = 0;
+    EXPECT_CALL(clock, currentSteadyTime()).WillOnce(Return(start)).WillOnce(Return(start + std::chrono::milliseconds(100)));
+    vm.run();
+    ASSERT_FALSE(vm.atEnd());
+    ASSERT_EQ(waitCount, 64);
+    ASSERT_EQ(vm.registerCount(), 0);
+
+    // Disabled warp timer
+    vm.setBytecode(bytecode2);
+    vm.setWarpTime(0);
+    waitCount = 0;
+    waitLimit = 1000;
+    EXPECT_CALL(clock, currentSteadyTime()).Times(0);
+    vm.run();
+    ASSERT_TRUE(vm.atEnd());
+    ASSERT_EQ(waitCount, 1000);
+    waitLimit = 0;
+
+    VirtualMachinePrivate::clock = Clock::instance().get();
+}